@@ -0,0 +1,244 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <math.h>
+#include <quickjs/quickjs.h>
+
+#include <limits>
+
+#include "gi/number.hh"
+
+/*
+ * Interface between the main module and the optional companion module of
+ * ahead-of-time generated stubs (see src/aot/generator.cc). Generated sources
+ * register one AotNamespace each when the companion module is loaded; the
+ * main module looks them up with qjs_gir_aot_find() and only uses a namespace
+ * whose version and typelib checksum match what is loaded at runtime.
+ */
+
+struct AotFunction {
+  const char *container;   // NULL for namespace level functions
+  const char *name;
+  JSCFunction *stub;
+  int          length;
+  void **      address;     // filled in by the main module before the stub is used
+};
+
+struct AotNamespace {
+  const char *       ns;
+  const char *       version;
+  const char *       checksum;
+  const AotFunction *functions;
+  int                n_functions;
+};
+
+#define QJS_GIR_AOT_FIND_SYMBOL    "qjs_gir_aot_find"
+
+typedef const AotNamespace *(*AotFindFunc)(const char *ns);
+
+extern "C" {
+void qjs_gir_aot_register(const AotNamespace *ns);
+const AotNamespace *qjs_gir_aot_find(const char *ns);
+}
+
+/**
+ * SHA-256 of a typelib file, free with g_free(); NULL if it can't be read
+ */
+static inline char *aot_typelib_checksum(const char *path) {
+  GMappedFile *file = path ? g_mapped_file_new(path, FALSE, NULL) : NULL;
+
+  if (file == NULL) {
+    return NULL;
+  }
+
+  char *checksum = g_compute_checksum_for_data(G_CHECKSUM_SHA256,
+                                               (const guchar *)g_mapped_file_get_contents(file),
+                                               g_mapped_file_get_length(file));
+  g_mapped_file_unref(file);
+  return checksum;
+}
+
+/*
+ * Conversion helpers used by the generated stubs, inlined into them
+ */
+
+static inline bool aot_is_number(JSValueConst value) {
+  int tag = JS_VALUE_GET_TAG(value);
+  return tag == JS_TAG_INT || tag == JS_TAG_FLOAT64 || tag == JS_TAG_BOOL || tag == JS_TAG_BIG_INT;
+}
+
+static inline bool aot_invalid_type(JSContext *ctx, const char *expected, const char *param) {
+  JS_ThrowTypeError(ctx, "Expected argument of type %s for parameter %s", expected, param);
+  return false;
+}
+
+static inline bool aot_out_of_range(JSContext *ctx, const char *param) {
+  JS_ThrowRangeError(ctx, "Value out of range for parameter %s", param);
+  return false;
+}
+
+/**
+ * BigInts are range checked through their decimal form, since JS_ToBigInt64
+ * wraps modulo 2^64 and would hide both negative and too large values
+ */
+template<typename T>
+static inline bool aot_bigint_to_integer(JSContext *ctx, JSValueConst value, T *out, const char *param) {
+  const char *str = JS_ToCString(ctx, value);
+
+  if (str == NULL) {
+    return false;
+  }
+
+  bool success;
+
+  if (std::numeric_limits<T>::is_signed) {
+    gint64 v;
+    success = g_ascii_string_to_signed(str, 10, std::numeric_limits<T>::min(), std::numeric_limits<T>::max(), &v, NULL);
+    *out = (T)v;
+  } else {
+    guint64 v;
+    success = g_ascii_string_to_unsigned(str, 10, 0, std::numeric_limits<T>::max(), &v, NULL);
+    *out = (T)v;
+  }
+
+  JS_FreeCString(ctx, str);
+  return success || aot_out_of_range(ctx, param);
+}
+
+/**
+ * Integers are truncated towards zero like the generic path does, but a value
+ * outside the range of the C type throws a RangeError instead of wrapping
+ */
+template<typename T>
+static inline bool aot_to_integer(JSContext *ctx, JSValueConst value, T *out, const char *param) {
+  typedef std::numeric_limits<T> limits;
+
+  if (JS_VALUE_GET_TAG(value) == JS_TAG_INT) {
+    int32_t v = JS_VALUE_GET_INT(value);
+
+    if ((v < 0 && (!limits::is_signed || v < (gint64)limits::min())) || (v > 0 && (guint64)v > (guint64)limits::max())) {
+      return aot_out_of_range(ctx, param);
+    }
+
+    *out = (T)v;
+    return true;
+  }
+
+  if (!aot_is_number(value)) {
+    return aot_invalid_type(ctx, "number", param);
+  }
+
+  if (JS_VALUE_GET_TAG(value) == JS_TAG_BIG_INT) {
+    return aot_bigint_to_integer<T>(ctx, value, out, param);
+  }
+
+  double v;
+
+  if (JS_ToFloat64(ctx, &v, value) < 0) {
+    return false;
+  }
+
+  // max() + 1 is a power of two, exact as a double even where max() isn't
+  v = trunc(v);
+
+  if (!(v >= (double)limits::min() && v < (double)limits::max() + 1.0)) {
+    return aot_out_of_range(ctx, param);
+  }
+
+  *out = (T)v;
+  return true;
+}
+
+template<typename T>
+static inline bool aot_to_float(JSContext *ctx, JSValueConst value, T *out, const char *param) {
+  double v;
+
+  if (JS_VALUE_GET_TAG(value) == JS_TAG_FLOAT64) {
+    *out = (T)JS_VALUE_GET_FLOAT64(value);
+    return true;
+  }
+
+  if (!aot_is_number(value)) {
+    return aot_invalid_type(ctx, "number", param);
+  }
+
+  if (JS_ToFloat64(ctx, &v, value) < 0) {
+    return false;
+  }
+
+  *out = (T)v;
+  return true;
+}
+
+static inline bool aot_to_boolean(JSContext *ctx, JSValueConst value, gboolean *out, const char *param) {
+  int v = JS_ToBool(ctx, value);
+
+  if (v < 0) {
+    return false;
+  }
+
+  *out = v;
+  return true;
+}
+
+static inline bool aot_to_string(JSContext *ctx, JSValueConst value, const char **out, bool may_be_null, const char *param) {
+  if (may_be_null && (JS_IsNull(value) || JS_IsUndefined(value))) {
+    *out = NULL;
+    return true;
+  }
+
+  if (!JS_IsString(value)) {
+    return aot_invalid_type(ctx, "string", param);
+  }
+
+  *out = JS_ToCString(ctx, value);
+  return *out != NULL;
+}
+
+static inline JSValue aot_from_int64(JSContext *ctx, gint64 value) {
+  if (value >= -MAX_SAFE_INTEGER && value <= MAX_SAFE_INTEGER) {
+    return JS_NewInt64(ctx, value);
+  }
+
+  return JS_NewBigInt64(ctx, value);
+}
+
+static inline JSValue aot_from_uint64(JSContext *ctx, guint64 value) {
+  if (value <= (guint64)MAX_SAFE_INTEGER) {
+    return JS_NewInt64(ctx, (gint64)value);
+  }
+
+  return JS_NewBigUint64(ctx, value);
+}
+
+static inline JSValue aot_from_string(JSContext *ctx, const char *value, bool owned) {
+  if (value == NULL) {
+    return JS_NULL;
+  }
+
+  JSValue result = JS_NewString(ctx, value);
+
+  if (owned) {
+    g_free((void *)value);
+  }
+
+  return result;
+}
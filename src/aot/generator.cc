@@ -0,0 +1,482 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-aot-generator NAMESPACE-VERSION OUTPUT
+ *
+ * Reads a typelib and writes C++ stubs for the functions of the namespace
+ * whose signatures it can marshal statically: numbers, booleans, enums and
+ * strings in, the same plus scalar out-arguments out. Everything else is left
+ * to FunctionInfo at runtime. Each stub converts its arguments inline and
+ * calls the C symbol through a typed function pointer.
+ */
+
+#include <girepository.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aot/aot.hh"
+
+enum ArgKind {
+  ARG_BOOLEAN, ARG_INTEGER, ARG_FLOAT, ARG_STRING
+};
+
+struct ArgPlan {
+  ArgKind     kind;
+  const char *ctype;
+  GITypeTag   tag;
+  bool        out;
+  bool        may_be_null;
+  bool        owned;
+  const char *name;
+};
+
+static const char *get_c_type(GITypeTag tag) {
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN:  return "gboolean";
+  case GI_TYPE_TAG_INT8:     return "gint8";
+  case GI_TYPE_TAG_UINT8:    return "guint8";
+  case GI_TYPE_TAG_INT16:    return "gint16";
+  case GI_TYPE_TAG_UINT16:   return "guint16";
+  case GI_TYPE_TAG_INT32:    return "gint32";
+  case GI_TYPE_TAG_UINT32:   return "guint32";
+  case GI_TYPE_TAG_INT64:    return "gint64";
+  case GI_TYPE_TAG_UINT64:   return "guint64";
+  case GI_TYPE_TAG_FLOAT:    return "gfloat";
+  case GI_TYPE_TAG_DOUBLE:   return "gdouble";
+  case GI_TYPE_TAG_UTF8:
+  case GI_TYPE_TAG_FILENAME: return "const char *";
+  default:                   return NULL;
+  }
+}
+
+/**
+ * @returns false if the type can't be handled by a generated stub
+ */
+static bool plan_type(GITypeInfo *type_info, ArgPlan *plan) {
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  if (tag == GI_TYPE_TAG_INTERFACE) {
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    GIInfoType  interface_type = g_base_info_get_type(interface_info);
+
+    tag = interface_type == GI_INFO_TYPE_ENUM || interface_type == GI_INFO_TYPE_FLAGS
+      ? g_enum_info_get_storage_type(interface_info)
+      : GI_TYPE_TAG_VOID;
+
+    g_base_info_unref(interface_info);
+
+    if (tag == GI_TYPE_TAG_VOID || g_type_info_is_pointer(type_info)) {
+      return false;
+    }
+  }
+
+  plan->tag   = tag;
+  plan->ctype = get_c_type(tag);
+
+  if (plan->ctype == NULL) {
+    return false;
+  }
+
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN:
+    plan->kind = ARG_BOOLEAN;
+    break;
+
+  case GI_TYPE_TAG_FLOAT:
+  case GI_TYPE_TAG_DOUBLE:
+    plan->kind = ARG_FLOAT;
+    break;
+
+  case GI_TYPE_TAG_UTF8:
+  case GI_TYPE_TAG_FILENAME:
+    plan->kind = ARG_STRING;
+    break;
+
+  default:
+    plan->kind = ARG_INTEGER;
+    break;
+  }
+
+  // Only strings are pointers
+  return g_type_info_is_pointer(type_info) == (plan->kind == ARG_STRING);
+}
+
+static const char *get_from_c(ArgPlan *plan) {
+  switch (plan->tag) {
+  case GI_TYPE_TAG_BOOLEAN: return "JS_NewBool(ctx, %s)";
+  case GI_TYPE_TAG_UINT32:  return "JS_NewUint32(ctx, %s)";
+  case GI_TYPE_TAG_INT64:   return "aot_from_int64(ctx, %s)";
+  case GI_TYPE_TAG_UINT64:  return "aot_from_uint64(ctx, %s)";
+  case GI_TYPE_TAG_FLOAT:
+  case GI_TYPE_TAG_DOUBLE:  return "JS_NewFloat64(ctx, %s)";
+  case GI_TYPE_TAG_UTF8:
+  case GI_TYPE_TAG_FILENAME:
+    return plan->owned ? "aot_from_string(ctx, %s, true)" : "aot_from_string(ctx, %s, false)";
+  default:                  return "JS_NewInt32(ctx, %s)";
+  }
+}
+
+static void emit_result(GString *out, ArgPlan *plan, const char *var) {
+  g_string_append_printf(out, get_from_c(plan), var);
+}
+
+/**
+ * Writes the stub of one function
+ * @returns false (writing nothing) if the function isn't supported
+ */
+static bool emit_function(GString *out, GIFunctionInfo *info, int index, int *length) {
+  GIFunctionInfoFlags flags = g_function_info_get_flags(info);
+
+  if ((flags & GI_FUNCTION_IS_METHOD) || g_callable_info_can_throw_gerror(info)) {
+    return false;
+  }
+
+  int      n_args = g_callable_info_get_n_args(info);
+  ArgPlan *args   = g_newa(ArgPlan, n_args + 1);
+  int      n_in   = 0;
+  int      n_outs = 0;
+  bool     ok     = true;
+
+  for (int i = 0; i < n_args && ok; i++) {
+    GIArgInfo   arg_info;
+    GITypeInfo  type_info;
+    g_callable_info_load_arg(info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    GIDirection direction = g_arg_info_get_direction(&arg_info);
+
+    ok = direction != GI_DIRECTION_INOUT && plan_type(&type_info, &args[i]);
+
+    args[i].out         = direction == GI_DIRECTION_OUT;
+    args[i].may_be_null = g_arg_info_may_be_null(&arg_info);
+    args[i].owned       = g_arg_info_get_ownership_transfer(&arg_info) != GI_TRANSFER_NOTHING;
+    args[i].name        = g_base_info_get_name(&arg_info);
+
+    // Strings going in must be borrowed, out ones are not supported
+    if (ok && args[i].kind == ARG_STRING && (args[i].out || args[i].owned)) {
+      ok = false;
+    }
+
+    if (ok && args[i].out && g_arg_info_is_caller_allocates(&arg_info)) {
+      ok = false;
+    }
+
+    n_in   += !args[i].out;
+    n_outs += args[i].out;
+  }
+
+  GITypeInfo return_type;
+  ArgPlan    ret    = {};
+  bool       is_void;
+
+  g_callable_info_load_return_type(info, &return_type);
+  is_void = g_type_info_get_tag(&return_type) == GI_TYPE_TAG_VOID;
+
+  if (!is_void && ok) {
+    ok        = plan_type(&return_type, &ret);
+    ret.owned = g_callable_info_get_caller_owns(info) != GI_TRANSFER_NOTHING;
+  }
+
+  if (!ok) {
+    return false;
+  }
+
+  bool skip_return = is_void || g_callable_info_skip_return(info);
+  int  n_results   = n_outs + (skip_return ? 0 : 1);
+  int  n_required  = 0;
+
+  for (int i = 0, in = 0; i < n_args; i++) {
+    if (!args[i].out) {
+      in++;
+      if (!args[i].may_be_null) {
+        n_required = in;
+      }
+    }
+  }
+
+  *length = n_in;
+
+  g_string_append_printf(out,
+    "\n// %s\n"
+    "static JSValue aot_stub_%d(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {\n"
+    "  if (argc < %d) {\n"
+    "    return JS_ThrowTypeError(ctx, \"Not enough arguments; expected %%i, have %%i\", %d, argc);\n"
+    "  }\n\n"
+    "  bool ok = true;\n",
+    g_function_info_get_symbol(info), index, n_required, n_required);
+
+  for (int i = 0, in = 0; i < n_args; i++) {
+    ArgPlan *arg = &args[i];
+
+    if (arg->out) {
+      g_string_append_printf(out, "  %s a%d = 0;\n", arg->ctype, i);
+      continue;
+    }
+
+    const char *value = "argc > %d ? argv[%d] : JS_UNDEFINED";
+    char *      js    = g_strdup_printf(value, in, in);
+
+    switch (arg->kind) {
+    case ARG_BOOLEAN:
+      g_string_append_printf(out, "  gboolean a%d = FALSE;\n  ok = ok && aot_to_boolean(ctx, %s, &a%d, \"%s\");\n",
+                             i, js, i, arg->name);
+      break;
+
+    case ARG_INTEGER:
+      g_string_append_printf(out, "  %s a%d = 0;\n  ok = ok && aot_to_integer<%s>(ctx, %s, &a%d, \"%s\");\n",
+                             arg->ctype, i, arg->ctype, js, i, arg->name);
+      break;
+
+    case ARG_FLOAT:
+      g_string_append_printf(out, "  %s a%d = 0;\n  ok = ok && aot_to_float<%s>(ctx, %s, &a%d, \"%s\");\n",
+                             arg->ctype, i, arg->ctype, js, i, arg->name);
+      break;
+
+    case ARG_STRING:
+      g_string_append_printf(out, "  const char *a%d = NULL;\n  ok = ok && aot_to_string(ctx, %s, &a%d, %s, \"%s\");\n",
+                             i, js, i, arg->may_be_null ? "true" : "false", arg->name);
+      break;
+    }
+
+    g_free(js);
+    in++;
+  }
+
+  // Borrowed strings are released on every path
+  GString *cleanup = g_string_new(NULL);
+
+  g_string_append(out, "\n  if (!ok) {\n");
+
+  for (int i = 0; i < n_args; i++) {
+    if (args[i].kind == ARG_STRING && !args[i].out) {
+      g_string_append_printf(out, "    JS_FreeCString(ctx, a%d);\n", i);
+      g_string_append_printf(cleanup, "  JS_FreeCString(ctx, a%d);\n", i);
+    }
+  }
+
+  g_string_append(out, "    return JS_EXCEPTION;\n  }\n\n");
+
+  // The call, through a pointer typed after the C signature
+  GString *signature = g_string_new(NULL);
+  GString *call_args = g_string_new(NULL);
+
+  for (int i = 0; i < n_args; i++) {
+    g_string_append_printf(signature, "%s%s%s", i ? ", " : "", args[i].ctype, args[i].out ? " *" : "");
+    g_string_append_printf(call_args, "%s%sa%d", i ? ", " : "", args[i].out ? "&" : "", i);
+  }
+
+  if (is_void) {
+    g_string_append_printf(out, "  ((void (*)(%s))symbols[%d])(%s);\n",
+                           n_args ? signature->str : "void", index, call_args->str);
+  } else {
+    g_string_append_printf(out, "  %s ret = ((%s (*)(%s))symbols[%d])(%s);\n",
+                           ret.ctype, ret.ctype, n_args ? signature->str : "void", index, call_args->str);
+  }
+
+  g_string_append(out, cleanup->str);
+
+  if (skip_return && !is_void && ret.kind == ARG_STRING && ret.owned) {
+    g_string_append(out, "  g_free((void *)ret);\n");
+  }
+
+  // Results, packed like FunctionInfo::GetReturnValue does
+  if (n_results == 0) {
+    g_string_append(out, "  return JS_UNDEFINED;\n");
+  } else if (n_results == 1) {
+    g_string_append(out, "  return ");
+
+    if (!skip_return) {
+      emit_result(out, &ret, "ret");
+    } else {
+      for (int i = 0; i < n_args; i++) {
+        if (args[i].out) {
+          char *var = g_strdup_printf("a%d", i);
+          emit_result(out, &args[i], var);
+          g_free(var);
+        }
+      }
+    }
+
+    g_string_append(out, ";\n");
+  } else {
+    int index_in_result = 0;
+
+    g_string_append(out, "  JSValue result = JS_NewArray(ctx);\n");
+
+    if (!skip_return) {
+      g_string_append_printf(out, "  JS_DefinePropertyValueUint32(ctx, result, %d, ", index_in_result++);
+      emit_result(out, &ret, "ret");
+      g_string_append(out, ", JS_PROP_C_W_E);\n");
+    }
+
+    for (int i = 0; i < n_args; i++) {
+      if (args[i].out) {
+        char *var = g_strdup_printf("a%d", i);
+        g_string_append_printf(out, "  JS_DefinePropertyValueUint32(ctx, result, %d, ", index_in_result++);
+        emit_result(out, &args[i], var);
+        g_string_append(out, ", JS_PROP_C_W_E);\n");
+        g_free(var);
+      }
+    }
+
+    g_string_append(out, "  return result;\n");
+  }
+
+  g_string_append(out, "}\n");
+
+  g_string_free(cleanup, TRUE);
+  g_string_free(signature, TRUE);
+  g_string_free(call_args, TRUE);
+  return true;
+}
+
+static void add_function(GString *stubs, GString *table, GIFunctionInfo *info, const char *container, int *n_functions) {
+  int length;
+
+  if (!emit_function(stubs, info, *n_functions, &length)) {
+    return;
+  }
+
+  if (container != NULL) {
+    g_string_append_printf(table, "  { \"%s\", \"%s\", aot_stub_%d, %d, &symbols[%d] },\n",
+                           container, g_base_info_get_name(info), *n_functions, length, *n_functions);
+  } else {
+    g_string_append_printf(table, "  { NULL, \"%s\", aot_stub_%d, %d, &symbols[%d] },\n",
+                           g_base_info_get_name(info), *n_functions, length, *n_functions);
+  }
+
+  (*n_functions)++;
+}
+
+/**
+ * Visits the same functions BootstrapGI defines
+ */
+static void add_info(GString *stubs, GString *table, GIBaseInfo *info, int *n_functions) {
+  const char *name = g_base_info_get_name(info);
+
+  switch (g_base_info_get_type(info)) {
+  case GI_INFO_TYPE_FUNCTION:
+    add_function(stubs, table, info, NULL, n_functions);
+    break;
+
+  case GI_INFO_TYPE_OBJECT:
+    for (int i = 0; i < g_object_info_get_n_methods(info); i++) {
+      GIFunctionInfo *method = g_object_info_get_method(info, i);
+      add_function(stubs, table, method, name, n_functions);
+      g_base_info_unref(method);
+    }
+    break;
+
+  case GI_INFO_TYPE_BOXED:
+  case GI_INFO_TYPE_STRUCT:
+    for (int i = 0; i < g_struct_info_get_n_methods(info); i++) {
+      GIFunctionInfo *method = g_struct_info_get_method(info, i);
+      add_function(stubs, table, method, name, n_functions);
+      g_base_info_unref(method);
+    }
+    break;
+
+  case GI_INFO_TYPE_UNION:
+    for (int i = 0; i < g_union_info_get_n_methods(info); i++) {
+      GIFunctionInfo *method = g_union_info_get_method(info, i);
+      add_function(stubs, table, method, name, n_functions);
+      g_base_info_unref(method);
+    }
+    break;
+
+  default:
+    break;
+  }
+}
+
+int main(int argc, char **argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s NAMESPACE-VERSION OUTPUT\n", argv[0]);
+    return 1;
+  }
+
+  char *       ns      = g_strdup(argv[1]);
+  char *       version = strrchr(ns, '-');
+  GIRepository *repo   = g_irepository_get_default();
+  GError *     error   = NULL;
+
+  if (version == NULL) {
+    fprintf(stderr, "Expected NAMESPACE-VERSION, got %s\n", argv[1]);
+    return 1;
+  }
+
+  *version++ = '\0';
+
+  if (!g_irepository_require(repo, ns, version, (GIRepositoryLoadFlags)0, &error)) {
+    fprintf(stderr, "%s\n", error->message);
+    return 1;
+  }
+
+  char *checksum = aot_typelib_checksum(g_irepository_get_typelib_path(repo, ns));
+
+  if (checksum == NULL) {
+    fprintf(stderr, "Cannot read the typelib of %s-%s\n", ns, version);
+    return 1;
+  }
+
+  GString *stubs       = g_string_new(NULL);
+  GString *table       = g_string_new(NULL);
+  int      n_functions = 0;
+
+  for (int i = 0; i < g_irepository_get_n_infos(repo, ns); i++) {
+    GIBaseInfo *info = g_irepository_get_info(repo, ns, i);
+    add_info(stubs, table, info, &n_functions);
+    g_base_info_unref(info);
+  }
+
+  FILE *output = fopen(argv[2], "w");
+
+  if (output == NULL) {
+    perror(argv[2]);
+    return 1;
+  }
+
+  fprintf(output,
+    "// Generated by quickjs-gobject-aot-generator from %s-%s, do not edit\n\n"
+    "#include <glib.h>\n"
+    "#include <quickjs/quickjs.h>\n\n"
+    "#include \"aot/aot.hh\"\n\n"
+    "static void *symbols[%d];\n"
+    "%s\n"
+    "static const AotFunction functions[] = {\n"
+    "%s"
+    "  { NULL, NULL, NULL, 0, NULL },\n"
+    "};\n\n"
+    "static const AotNamespace aot_namespace = {\n"
+    "  \"%s\", \"%s\", \"%s\", functions, %d\n"
+    "};\n\n"
+    "__attribute__((constructor))\n"
+    "static void register_namespace() {\n"
+    "  qjs_gir_aot_register(&aot_namespace);\n"
+    "}\n",
+    ns, version, MAX(n_functions, 1), stubs->str, table->str, ns, version, checksum, n_functions);
+
+  fclose(output);
+
+  g_string_free(stubs, TRUE);
+  g_string_free(table, TRUE);
+  g_free(checksum);
+  g_free(ns);
+  return 0;
+}
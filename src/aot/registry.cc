@@ -0,0 +1,46 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib.h>
+#include <string.h>
+
+#include "aot/aot.hh"
+
+/*
+ * Registry of the companion module. Generated sources register their
+ * namespace from a static constructor, i.e. while the module is being loaded.
+ */
+
+static GHashTable *aot_namespaces = NULL;
+
+extern "C" {
+
+void qjs_gir_aot_register(const AotNamespace *ns) {
+  if (aot_namespaces == NULL) {
+    aot_namespaces = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+
+  g_hash_table_insert(aot_namespaces, (gpointer)ns->ns, (gpointer)ns);
+}
+
+__attribute__((visibility("default")))
+const AotNamespace *qjs_gir_aot_find(const char *ns) {
+  return aot_namespaces ? (const AotNamespace *)g_hash_table_lookup(aot_namespaces, ns) : NULL;
+}
+
+}
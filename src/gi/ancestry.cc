@@ -0,0 +1,106 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib-object.h>
+
+#include "gi/ancestry.hh"
+
+namespace QJSGir {
+
+G_LOCK_DEFINE_STATIC(ancestry);
+
+static GQuark ancestry_quark() {
+  static GQuark quark = 0;
+
+  if (quark == 0) {
+    quark = g_quark_from_static_string("quickjs-gobject-ancestry");
+  }
+
+  return quark;
+}
+
+static gint compare_gtypes(gconstpointer a, gconstpointer b) {
+  GType type_a = *(const GType *)a;
+  GType type_b = *(const GType *)b;
+
+  return type_a < type_b ? -1 : type_a > type_b;
+}
+
+static TypeAncestry *compute_ancestry(GType gtype) {
+  TypeAncestry *ancestry   = g_new0(TypeAncestry, 1);
+  guint         depth      = g_type_depth(gtype);
+  GType *       ancestors  = g_new(GType, depth);
+  GArray *      interfaces = g_array_new(FALSE, FALSE, sizeof(GType));
+
+  for (GType type = gtype; type != G_TYPE_INVALID; type = g_type_parent(type)) {
+    guint  n_type_interfaces;
+    GType *type_interfaces = g_type_interfaces(type, &n_type_interfaces);
+
+    ancestors[g_type_depth(type) - 1] = type;
+    g_array_append_vals(interfaces, type_interfaces, n_type_interfaces);
+    g_free(type_interfaces);
+  }
+
+  // Interfaces of the parents are usually listed again by the subclass
+  g_array_sort(interfaces, compare_gtypes);
+
+  guint n_unique = 0;
+
+  for (guint i = 0; i < interfaces->len; i++) {
+    GType iface = g_array_index(interfaces, GType, i);
+
+    if (n_unique == 0 || g_array_index(interfaces, GType, n_unique - 1) != iface) {
+      g_array_index(interfaces, GType, n_unique++) = iface;
+    }
+  }
+
+  ancestry->gtype        = gtype;
+  ancestry->depth        = depth;
+  ancestry->ancestors    = ancestors;
+  ancestry->n_interfaces = n_unique;
+  ancestry->interfaces   = (GType *)g_array_free(interfaces, FALSE);
+
+  return ancestry;
+}
+
+const TypeAncestry *GetTypeAncestry(GType gtype) {
+  GQuark        quark    = ancestry_quark();
+  TypeAncestry *ancestry = (TypeAncestry *)g_type_get_qdata(gtype, quark);
+
+  if (ancestry != NULL) {
+    return ancestry;
+  }
+
+  G_LOCK(ancestry);
+
+  ancestry = (TypeAncestry *)g_type_get_qdata(gtype, quark);
+
+  if (ancestry == NULL) {
+    ancestry = compute_ancestry(gtype);
+    g_type_set_qdata(gtype, quark, ancestry);
+  }
+
+  G_UNLOCK(ancestry);
+  return ancestry;
+}
+
+guint GetTargetDepth(GType target) {
+  return G_TYPE_IS_INTERFACE(target) ? 0 : g_type_depth(target);
+}
+
+}
@@ -0,0 +1,72 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib-object.h>
+
+namespace QJSGir {
+
+/**
+ * Everything an instance of a class type is-a: its ancestors indexed by
+ * depth, and the interfaces it implements, sorted. Computed once per GType
+ * and never freed, like the type itself.
+ */
+struct TypeAncestry {
+  GType        gtype;
+  guint        depth;
+  const GType *ancestors;   // ancestors[depth - 1] is the ancestor of that depth
+  guint        n_interfaces;
+  const GType *interfaces;
+};
+
+const TypeAncestry *GetTypeAncestry(GType gtype);
+
+/**
+ * What TypeAncestryIsA needs to know about the target type: its depth, or 0 if
+ * it is an interface. Call plans compute it once per parameter.
+ */
+guint GetTargetDepth(GType target);
+
+static inline bool TypeAncestryIsA(const TypeAncestry *ancestry, GType target, guint target_depth) {
+  if (target_depth != 0) {
+    return target_depth <= ancestry->depth && ancestry->ancestors[target_depth - 1] == target;
+  }
+
+  // Classes implement a handful of interfaces, a binary search is a few compares
+  guint low  = 0;
+  guint high = ancestry->n_interfaces;
+
+  while (low < high) {
+    guint middle = (low + high) / 2;
+
+    if (ancestry->interfaces[middle] == target) {
+      return true;
+    }
+
+    if (ancestry->interfaces[middle] < target) {
+      low = middle + 1;
+    } else {
+      high = middle;
+    }
+  }
+
+  return false;
+}
+
+}
@@ -0,0 +1,600 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <string.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "gi/array_kernels.hh"
+
+namespace QJSGir {
+
+// Elements converted per round, sized to keep the scratch buffers on the stack
+#define CHUNK_SIZE    256
+
+/**
+ * Narrowing kernels take exclusive bounds, so that doubles which truncate
+ * into [min, max] pass, and return how many leading elements did. NaN fails
+ * both comparisons and stops the run like any other out of range element.
+ */
+struct ArrayKernels {
+  void  (*widen_int8)(const gint8 *src, gint32 *dst, gsize n);
+  void  (*widen_uint8)(const guint8 *src, gint32 *dst, gsize n);
+  void  (*widen_int16)(const gint16 *src, gint32 *dst, gsize n);
+  void  (*widen_uint16)(const guint16 *src, gint32 *dst, gsize n);
+  void  (*widen_float)(const gfloat *src, gdouble *dst, gsize n);
+  gsize (*narrow_int32)(const gdouble *src, gint32 *dst, gsize n, gdouble lower, gdouble upper);
+  void  (*narrow_float)(const gdouble *src, gfloat *dst, gsize n);
+};
+
+/*
+ * Scalar
+ */
+
+template<typename T>
+static void widen_scalar(const T *src, gint32 *dst, gsize n) {
+  for (gsize i = 0; i < n; i++) {
+    dst[i] = src[i];
+  }
+}
+
+static void widen_float_scalar(const gfloat *src, gdouble *dst, gsize n) {
+  for (gsize i = 0; i < n; i++) {
+    dst[i] = src[i];
+  }
+}
+
+static gsize narrow_int32_scalar(const gdouble *src, gint32 *dst, gsize n, gdouble lower, gdouble upper) {
+  for (gsize i = 0; i < n; i++) {
+    if (!(src[i] > lower && src[i] < upper)) {
+      return i;
+    }
+
+    dst[i] = (gint32)src[i];
+  }
+
+  return n;
+}
+
+static void narrow_float_scalar(const gdouble *src, gfloat *dst, gsize n) {
+  for (gsize i = 0; i < n; i++) {
+    dst[i] = (gfloat)src[i];
+  }
+}
+
+static const ArrayKernels scalar_kernels = {
+  widen_scalar<gint8>,
+  widen_scalar<guint8>,
+  widen_scalar<gint16>,
+  widen_scalar<guint16>,
+  widen_float_scalar,
+  narrow_int32_scalar,
+  narrow_float_scalar,
+};
+
+#if defined(__x86_64__)
+
+/*
+ * SSE2, always there on x86-64
+ */
+
+static void widen_int8_sse2(const gint8 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i v  = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i lo = _mm_srai_epi16(_mm_unpacklo_epi8(v, v), 8);
+    __m128i hi = _mm_srai_epi16(_mm_unpackhi_epi8(v, v), 8);
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_srai_epi32(_mm_unpacklo_epi16(lo, lo), 16));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(lo, lo), 16));
+    _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_srai_epi32(_mm_unpacklo_epi16(hi, hi), 16));
+    _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_srai_epi32(_mm_unpackhi_epi16(hi, hi), 16));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+static void widen_uint8_sse2(const guint8 *src, gint32 *dst, gsize n) {
+  const __m128i zero = _mm_setzero_si128();
+  gsize         i    = 0;
+
+  for (; i + 16 <= n; i += 16) {
+    __m128i v  = _mm_loadu_si128((const __m128i *)(src + i));
+    __m128i lo = _mm_unpacklo_epi8(v, zero);
+    __m128i hi = _mm_unpackhi_epi8(v, zero);
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(lo, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 8), _mm_unpacklo_epi16(hi, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 12), _mm_unpackhi_epi16(hi, zero));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+static void widen_int16_sse2(const gint16 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_srai_epi32(_mm_unpacklo_epi16(v, v), 16));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_srai_epi32(_mm_unpackhi_epi16(v, v), 16));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+static void widen_uint16_sse2(const guint16 *src, gint32 *dst, gsize n) {
+  const __m128i zero = _mm_setzero_si128();
+  gsize         i    = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi16(v, zero));
+    _mm_storeu_si128((__m128i *)(dst + i + 4), _mm_unpackhi_epi16(v, zero));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+static void widen_float_sse2(const gfloat *src, gdouble *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128 v = _mm_loadu_ps(src + i);
+
+    _mm_storeu_pd(dst + i, _mm_cvtps_pd(v));
+    _mm_storeu_pd(dst + i + 2, _mm_cvtps_pd(_mm_movehl_ps(v, v)));
+  }
+
+  widen_float_scalar(src + i, dst + i, n - i);
+}
+
+static gsize narrow_int32_sse2(const gdouble *src, gint32 *dst, gsize n, gdouble lower, gdouble upper) {
+  const __m128d lo = _mm_set1_pd(lower);
+  const __m128d hi = _mm_set1_pd(upper);
+  gsize         i  = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128d a = _mm_loadu_pd(src + i);
+    __m128d b = _mm_loadu_pd(src + i + 2);
+    __m128d ok_a = _mm_and_pd(_mm_cmpgt_pd(a, lo), _mm_cmplt_pd(a, hi));
+    __m128d ok_b = _mm_and_pd(_mm_cmpgt_pd(b, lo), _mm_cmplt_pd(b, hi));
+
+    if ((_mm_movemask_pd(ok_a) & _mm_movemask_pd(ok_b)) != 3) {
+      break;
+    }
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm_unpacklo_epi64(_mm_cvttpd_epi32(a), _mm_cvttpd_epi32(b)));
+  }
+
+  return i + narrow_int32_scalar(src + i, dst + i, n - i, lower, upper);
+}
+
+static void narrow_float_sse2(const gdouble *src, gfloat *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m128 a = _mm_cvtpd_ps(_mm_loadu_pd(src + i));
+    __m128 b = _mm_cvtpd_ps(_mm_loadu_pd(src + i + 2));
+
+    _mm_storeu_ps(dst + i, _mm_movelh_ps(a, b));
+  }
+
+  narrow_float_scalar(src + i, dst + i, n - i);
+}
+
+static const ArrayKernels sse2_kernels = {
+  widen_int8_sse2,
+  widen_uint8_sse2,
+  widen_int16_sse2,
+  widen_uint16_sse2,
+  widen_float_sse2,
+  narrow_int32_sse2,
+  narrow_float_sse2,
+};
+
+/*
+ * AVX2, built for the target regardless of -march and only picked if the CPU has it
+ */
+
+#define AVX2    __attribute__((target("avx2")))
+
+AVX2 static void widen_int8_avx2(const gint8 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepi8_epi32(v));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+AVX2 static void widen_uint8_avx2(const guint8 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadl_epi64((const __m128i *)(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepu8_epi32(v));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+AVX2 static void widen_int16_avx2(const gint16 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepi16_epi32(v));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+AVX2 static void widen_uint16_avx2(const guint16 *src, gint32 *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m128i v = _mm_loadu_si128((const __m128i *)(src + i));
+    _mm256_storeu_si256((__m256i *)(dst + i), _mm256_cvtepu16_epi32(v));
+  }
+
+  widen_scalar(src + i, dst + i, n - i);
+}
+
+AVX2 static void widen_float_avx2(const gfloat *src, gdouble *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    _mm256_storeu_pd(dst + i, _mm256_cvtps_pd(_mm_loadu_ps(src + i)));
+  }
+
+  widen_float_scalar(src + i, dst + i, n - i);
+}
+
+AVX2 static gsize narrow_int32_avx2(const gdouble *src, gint32 *dst, gsize n, gdouble lower, gdouble upper) {
+  const __m256d lo = _mm256_set1_pd(lower);
+  const __m256d hi = _mm256_set1_pd(upper);
+  gsize         i  = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256d v  = _mm256_loadu_pd(src + i);
+    __m256d ok = _mm256_and_pd(_mm256_cmp_pd(v, lo, _CMP_GT_OQ), _mm256_cmp_pd(v, hi, _CMP_LT_OQ));
+
+    if (_mm256_movemask_pd(ok) != 0xF) {
+      break;
+    }
+
+    _mm_storeu_si128((__m128i *)(dst + i), _mm256_cvttpd_epi32(v));
+  }
+
+  return i + narrow_int32_scalar(src + i, dst + i, n - i, lower, upper);
+}
+
+AVX2 static void narrow_float_avx2(const gdouble *src, gfloat *dst, gsize n) {
+  gsize i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    _mm_storeu_ps(dst + i, _mm256_cvtpd_ps(_mm256_loadu_pd(src + i)));
+  }
+
+  narrow_float_scalar(src + i, dst + i, n - i);
+}
+
+#undef AVX2
+
+static const ArrayKernels avx2_kernels = {
+  widen_int8_avx2,
+  widen_uint8_avx2,
+  widen_int16_avx2,
+  widen_uint16_avx2,
+  widen_float_avx2,
+  narrow_int32_avx2,
+  narrow_float_avx2,
+};
+
+#endif
+
+static const ArrayKernels *select_kernels() {
+#if defined(__x86_64__)
+  __builtin_cpu_init();
+
+  if (__builtin_cpu_supports("avx2")) {
+    return &avx2_kernels;
+  }
+
+  return &sse2_kernels;
+#else
+  return &scalar_kernels;
+#endif
+}
+
+static const ArrayKernels *get_kernels() {
+  static const ArrayKernels *kernels = select_kernels();
+  return kernels;
+}
+
+/**
+ * Exclusive bounds of the doubles that truncate into the range of tag
+ */
+static void get_bounds(GITypeTag tag, gdouble *lower, gdouble *upper) {
+  switch (tag) {
+  case GI_TYPE_TAG_INT8:
+    *lower = G_MININT8 - 1.0;
+    *upper = G_MAXINT8 + 1.0;
+    break;
+
+  case GI_TYPE_TAG_UINT8:
+    *lower = -1.0;
+    *upper = G_MAXUINT8 + 1.0;
+    break;
+
+  case GI_TYPE_TAG_INT16:
+    *lower = G_MININT16 - 1.0;
+    *upper = G_MAXINT16 + 1.0;
+    break;
+
+  case GI_TYPE_TAG_UINT16:
+    *lower = -1.0;
+    *upper = G_MAXUINT16 + 1.0;
+    break;
+
+  case GI_TYPE_TAG_UINT32:
+    *lower = -1.0;
+    *upper = G_MAXUINT32 + 1.0;
+    break;
+
+  default:
+    *lower = G_MININT32 - 1.0;
+    *upper = G_MAXINT32 + 1.0;
+    break;
+  }
+}
+
+template<typename T>
+static void store_narrowed(const gint32 *src, void *dst, gsize start, gsize n) {
+  for (gsize i = 0; i < n; i++) {
+    ((T *)dst)[start + i] = (T)src[i];
+  }
+}
+
+GITypeTag GetArrayKernelTag(GITypeInfo *array_type) {
+  if (g_type_info_get_array_type(array_type) != GI_ARRAY_TYPE_C) {
+    return GI_TYPE_TAG_VOID;
+  }
+
+  GITypeInfo *element_type = g_type_info_get_param_type(array_type, 0);
+  GITypeTag   tag          = g_type_info_get_tag(element_type);
+  bool        is_pointer   = g_type_info_is_pointer(element_type);
+
+  g_base_info_unref(element_type);
+
+  if (is_pointer) {
+    return GI_TYPE_TAG_VOID;
+  }
+
+  switch (tag) {
+  case GI_TYPE_TAG_INT8:
+  case GI_TYPE_TAG_UINT8:
+  case GI_TYPE_TAG_INT16:
+  case GI_TYPE_TAG_UINT16:
+  case GI_TYPE_TAG_INT32:
+  case GI_TYPE_TAG_UINT32:
+  case GI_TYPE_TAG_FLOAT:
+  case GI_TYPE_TAG_DOUBLE:
+    return tag;
+
+  default:
+    return GI_TYPE_TAG_VOID;
+  }
+}
+
+/**
+ * Elements are appended in order with the default attributes, which is what
+ * keeps QuickJS on its fast array representation.
+ */
+JSValue JS_NewArrayFromNumbers(JSContext *ctx, GITypeTag tag, const void *data, gsize n) {
+  const ArrayKernels *kernels = get_kernels();
+  JSValue             array   = JS_NewArray(ctx);
+
+  union {
+    gint32  ints[CHUNK_SIZE];
+    gdouble doubles[CHUNK_SIZE];
+  } buffer;
+
+  if (JS_IsException(array)) {
+    return array;
+  }
+
+  for (gsize start = 0; start < n; start += CHUNK_SIZE) {
+    gsize          count   = MIN(CHUNK_SIZE, n - start);
+    const gint32 * ints    = buffer.ints;
+    const gdouble *doubles = nullptr;
+
+    switch (tag) {
+    case GI_TYPE_TAG_INT8:
+      kernels->widen_int8((const gint8 *)data + start, buffer.ints, count);
+      break;
+
+    case GI_TYPE_TAG_UINT8:
+      kernels->widen_uint8((const guint8 *)data + start, buffer.ints, count);
+      break;
+
+    case GI_TYPE_TAG_INT16:
+      kernels->widen_int16((const gint16 *)data + start, buffer.ints, count);
+      break;
+
+    case GI_TYPE_TAG_UINT16:
+      kernels->widen_uint16((const guint16 *)data + start, buffer.ints, count);
+      break;
+
+    case GI_TYPE_TAG_INT32:
+      ints = (const gint32 *)data + start;
+      break;
+
+    case GI_TYPE_TAG_UINT32:
+      for (gsize i = 0; i < count; i++) {
+        buffer.doubles[i] = ((const guint32 *)data)[start + i];
+      }
+      doubles = buffer.doubles;
+      break;
+
+    case GI_TYPE_TAG_FLOAT:
+      kernels->widen_float((const gfloat *)data + start, buffer.doubles, count);
+      doubles = buffer.doubles;
+      break;
+
+    default:
+      doubles = (const gdouble *)data + start;
+      break;
+    }
+
+    for (gsize i = 0; i < count; i++) {
+      JSValue value = doubles != nullptr ? JS_NewFloat64(ctx, doubles[i]) : JS_NewInt32(ctx, ints[i]);
+
+      if (JS_DefinePropertyValueUint32(ctx, array, start + i, value, JS_PROP_C_W_E) < 0) {
+        JS_FreeValue(ctx, array);
+        return JS_EXCEPTION;
+      }
+    }
+  }
+
+  return array;
+}
+
+bool JS_IsPlainArray(JSContext *ctx, JSValueConst value) {
+  // Class IDs of the builtin classes are the same in every runtime
+  static gsize array_class_id = 0;
+
+  if (!JS_IsObject(value)) {
+    return false;
+  }
+
+  if (g_once_init_enter(&array_class_id)) {
+    JSValue array = JS_NewArray(ctx);
+    g_once_init_leave(&array_class_id, JS_GetClassID(array));
+    JS_FreeValue(ctx, array);
+  }
+
+  return JS_GetClassID(value) == array_class_id;
+}
+
+bool JS_ArrayToNumbers(JSContext *ctx, GITypeTag tag, JSValueConst array, gsize n, void *dst) {
+  const ArrayKernels *kernels = get_kernels();
+  gdouble             lower, upper;
+  gdouble             doubles[CHUNK_SIZE];
+  gint32              ints[CHUNK_SIZE];
+
+  get_bounds(tag, &lower, &upper);
+
+  for (gsize start = 0; start < n; start += CHUNK_SIZE) {
+    gsize    count  = MIN(CHUNK_SIZE, n - start);
+    gdouble *values = tag == GI_TYPE_TAG_DOUBLE ? (gdouble *)dst + start : doubles;
+
+    for (gsize i = 0; i < count; i++) {
+      JSValue element = JS_GetPropertyUint32(ctx, array, start + i);
+
+      switch (JS_VALUE_GET_TAG(element)) {
+      case JS_TAG_INT:
+        values[i] = JS_VALUE_GET_INT(element);
+        break;
+
+      case JS_TAG_FLOAT64:
+        values[i] = JS_VALUE_GET_FLOAT64(element);
+        break;
+
+      case JS_TAG_EXCEPTION:
+        return false;
+
+      default: {
+        int rc = JS_ToFloat64(ctx, &values[i], element);
+        JS_FreeValue(ctx, element);
+
+        if (rc < 0) {
+          return false;
+        }
+        break;
+      }
+      }
+    }
+
+    gsize valid = count;
+
+    switch (tag) {
+    case GI_TYPE_TAG_INT8:
+      valid = kernels->narrow_int32(values, ints, count, lower, upper);
+      store_narrowed<gint8>(ints, dst, start, valid);
+      break;
+
+    case GI_TYPE_TAG_UINT8:
+      valid = kernels->narrow_int32(values, ints, count, lower, upper);
+      store_narrowed<guint8>(ints, dst, start, valid);
+      break;
+
+    case GI_TYPE_TAG_INT16:
+      valid = kernels->narrow_int32(values, ints, count, lower, upper);
+      store_narrowed<gint16>(ints, dst, start, valid);
+      break;
+
+    case GI_TYPE_TAG_UINT16:
+      valid = kernels->narrow_int32(values, ints, count, lower, upper);
+      store_narrowed<guint16>(ints, dst, start, valid);
+      break;
+
+    case GI_TYPE_TAG_INT32:
+      valid = kernels->narrow_int32(values, (gint32 *)dst + start, count, lower, upper);
+      break;
+
+    case GI_TYPE_TAG_UINT32:
+      for (valid = 0; valid < count; valid++) {
+        if (!(values[valid] > lower && values[valid] < upper)) {
+          break;
+        }
+
+        ((guint32 *)dst)[start + valid] = (guint32)values[valid];
+      }
+      break;
+
+    case GI_TYPE_TAG_FLOAT:
+      kernels->narrow_float(values, (gfloat *)dst + start, count);
+      break;
+
+    default:
+      break;
+    }
+
+    if (valid < count) {
+      JS_ThrowRangeError(ctx, "Element %zu (%g) is out of range for %s",
+                         start + valid, values[valid], g_type_tag_to_string(tag));
+      return false;
+    }
+  }
+
+  return true;
+}
+
+}
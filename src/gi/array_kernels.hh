@@ -0,0 +1,58 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * Bulk conversion between C arrays of 8, 16 and 32 bit integers, floats or
+ * doubles and plain JS Arrays. The element conversions run through SSE2/AVX2
+ * kernels picked at first use, with a scalar fallback elsewhere.
+ */
+
+/**
+ * @returns the element tag of a C array type the kernels handle, or
+ * GI_TYPE_TAG_VOID if the array needs the generic conversion
+ */
+GITypeTag GetArrayKernelTag(GITypeInfo *array_type);
+
+// Longest JS Array converted in bulk, in elements
+#define ARRAY_KERNEL_MAX_LENGTH (1 << 26)
+
+/**
+ * @returns true if value is a JS Array itself. Array.isArray also accepts
+ * Proxies of arrays, whose length and elements are whatever the traps say.
+ */
+bool JS_IsPlainArray(JSContext *ctx, JSValueConst value);
+
+/**
+ * Creates a JS Array holding the n elements of data, a C array of tag elements
+ */
+JSValue JS_NewArrayFromNumbers(JSContext *ctx, GITypeTag tag, const void *data, gsize n);
+
+/**
+ * Stores the first n elements of array into dst, a C array of tag elements.
+ * Integer elements out of range for tag throw a RangeError instead of wrapping.
+ * @returns false if an exception was thrown
+ */
+bool JS_ArrayToNumbers(JSContext *ctx, GITypeTag tag, JSValueConst array, gsize n, void *dst);
+
+}
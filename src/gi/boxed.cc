@@ -0,0 +1,67 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/boxed.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+namespace QJSGir {
+
+size_t Boxed::GetSize(GIBaseInfo *boxed_info) {
+  switch (g_base_info_get_type(boxed_info)) {
+  case GI_INFO_TYPE_STRUCT:
+  case GI_INFO_TYPE_BOXED:
+    return g_struct_info_get_size(boxed_info);
+
+  case GI_INFO_TYPE_UNION:
+    return g_union_info_get_size(boxed_info);
+
+  default:
+    return 0;
+  }
+}
+
+/**
+ * The struct size, or what opaque containers hold, whose struct size tells nothing
+ */
+size_t Boxed::GetNativeSize(GIBaseInfo *boxed_info, GType gtype, void *data) {
+  if (gtype == G_TYPE_BYTES) {
+    return g_bytes_get_size((GBytes *)data);
+  }
+
+  if (gtype == G_TYPE_BYTE_ARRAY) {
+    return sizeof(GByteArray) + ((GByteArray *)data)->len;
+  }
+
+  return GetSize(boxed_info);
+}
+
+void *pointer_from_wrapper(JSValue value) {
+  Boxed *boxed = (Boxed *)JS_GetOpaque(value, js_boxed_classid);
+
+  if (boxed != nullptr) {
+    return boxed->data;
+  }
+
+  return JS_GetGObject(value);
+}
+
+}
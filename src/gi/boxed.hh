@@ -22,6 +22,8 @@
 
 namespace QJSGir {
 
+struct HeapGroup;
+
 class Boxed {
 public:
   void *data;
@@ -29,9 +31,19 @@ public:
   GIBaseInfo *info;
   unsigned long size;
   bool owns_memory;
+
+  // Owned memory of a boxed type that came from g_malloc0, freed with g_free
+  bool plain_memory;
+
+  // Native memory retained while the memory is owned, as accounted
+  gsize native_size;
   JSValue *persistent;
 
+  // Heap stats group of the type, looked up when the wrapper is created
+  HeapGroup *heap_group;
+
   static size_t GetSize(GIBaseInfo *boxed_info);
+  static size_t GetNativeSize(GIBaseInfo *boxed_info, GType gtype, void *data);
 };
 
 void *pointer_from_wrapper(JSValue value);
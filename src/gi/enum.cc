@@ -0,0 +1,188 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/enum.hh"
+#include "gi/type.hh"
+
+namespace QJSGir {
+
+// GIEnumInfo -> EnumTable *, plus the same tables by index
+static GHashTable *enum_tables       = NULL;
+static GPtrArray * enum_tables_array = NULL;
+G_LOCK_DEFINE_STATIC(enum_tables);
+
+/**
+ * Value names are exposed in upper case (`Gtk.Align.START`); a name that would
+ * start with a digit gets a leading underscore.
+ */
+static char *make_value_name(GIValueInfo *value_info) {
+  const char *name = g_base_info_get_name(value_info);
+  char *      upper = g_ascii_strup(name, -1);
+
+  if (g_ascii_isdigit(upper[0])) {
+    char *prefixed = g_strconcat("_", upper, NULL);
+    g_free(upper);
+    return prefixed;
+  }
+
+  return upper;
+}
+
+static EnumTable *make_enum_table(GIEnumInfo *info) {
+  EnumTable *table = new EnumTable();
+
+  table->info         = g_base_info_ref(info);
+  table->storage_type = g_enum_info_get_storage_type(info);
+  table->n_values     = g_enum_info_get_n_values(info);
+  table->names        = new char *[table->n_values];
+  table->values       = new gint64[table->n_values];
+
+  for (int i = 0; i < table->n_values; i++) {
+    GIValueInfo *value_info = g_enum_info_get_value(info, i);
+
+    table->names[i]  = make_value_name(value_info);
+    table->values[i] = g_value_info_get_value(value_info);
+
+    g_base_info_unref(value_info);
+  }
+
+  return table;
+}
+
+EnumTable *GetEnumTable(GIEnumInfo *info) {
+  G_LOCK(enum_tables);
+
+  if (enum_tables == NULL) {
+    enum_tables       = g_hash_table_new(base_info_hash, base_info_equal);
+    enum_tables_array = g_ptr_array_new();
+  }
+
+  EnumTable *table = (EnumTable *)g_hash_table_lookup(enum_tables, info);
+
+  if (table == nullptr) {
+    table        = make_enum_table(info);
+    table->index = enum_tables_array->len;
+
+    g_hash_table_insert(enum_tables, table->info, table);
+    g_ptr_array_add(enum_tables_array, table);
+  }
+
+  G_UNLOCK(enum_tables);
+  return table;
+}
+
+EnumTable *GetEnumTable(int index) {
+  G_LOCK(enum_tables);
+  EnumTable *table = (EnumTable *)g_ptr_array_index(enum_tables_array, index);
+  G_UNLOCK(enum_tables);
+
+  return table;
+}
+
+/**
+ * @returns the name of the first member with that exact value, or NULL
+ */
+const char *EnumTable::NameOf(gint64 value) const {
+  for (int i = 0; i < n_values; i++) {
+    if (values[i] == value) {
+      return names[i];
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Stores a JS number as an enum of the given storage type. Small integers
+ * are taken straight from the JSValue, without any conversion call.
+ */
+bool jsvalue_to_enum_giargument(JSContext *ctx, GITypeTag storage_type, GIArgument *arg, JSValue value) {
+  gint64 v;
+
+  if (JS_VALUE_GET_TAG(value) == JS_TAG_INT) {
+    v = JS_VALUE_GET_INT(value);
+  } else if (JS_ToInt64(ctx, &v, value)) {
+    return false;
+  }
+
+  switch (storage_type) {
+  case GI_TYPE_TAG_INT8:
+    arg->v_int8 = (gint8)v;
+    break;
+
+  case GI_TYPE_TAG_UINT8:
+    arg->v_uint8 = (guint8)v;
+    break;
+
+  case GI_TYPE_TAG_INT16:
+    arg->v_int16 = (gint16)v;
+    break;
+
+  case GI_TYPE_TAG_UINT16:
+    arg->v_uint16 = (guint16)v;
+    break;
+
+  case GI_TYPE_TAG_UINT32:
+    arg->v_uint32 = (guint32)v;
+    break;
+
+  case GI_TYPE_TAG_INT64:
+  case GI_TYPE_TAG_UINT64:
+    arg->v_int64 = v;
+    break;
+
+  case GI_TYPE_TAG_INT32:
+  default:
+    arg->v_int32 = (gint32)v;
+    break;
+  }
+
+  return true;
+}
+
+JSValue jsvalue_from_enum_giargument(JSContext *ctx, GITypeTag storage_type, GIArgument *arg) {
+  switch (storage_type) {
+  case GI_TYPE_TAG_INT8:
+    return JS_NewInt32(ctx, arg->v_int8);
+
+  case GI_TYPE_TAG_UINT8:
+    return JS_NewInt32(ctx, arg->v_uint8);
+
+  case GI_TYPE_TAG_INT16:
+    return JS_NewInt32(ctx, arg->v_int16);
+
+  case GI_TYPE_TAG_UINT16:
+    return JS_NewInt32(ctx, arg->v_uint16);
+
+  case GI_TYPE_TAG_UINT32:
+    return JS_NewUint32(ctx, arg->v_uint32);
+
+  case GI_TYPE_TAG_INT64:
+  case GI_TYPE_TAG_UINT64:
+    return JS_NewInt64(ctx, arg->v_int64);
+
+  case GI_TYPE_TAG_INT32:
+  default:
+    return JS_NewInt32(ctx, arg->v_int32);
+  }
+}
+
+}
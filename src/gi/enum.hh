@@ -0,0 +1,49 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * Name/value table of an enum or flags type. Tables are built once per
+ * GIEnumInfo for the whole process and never change afterwards.
+ */
+struct EnumTable {
+  GIEnumInfo *info;
+  GITypeTag   storage_type;
+  int         n_values;
+  char **     names;
+  gint64 *    values;
+
+  // Position in the process-wide registry, see GetEnumTable(int)
+  int         index;
+
+  const char *NameOf(gint64 value) const;
+};
+
+EnumTable *GetEnumTable(GIEnumInfo *info);
+EnumTable *GetEnumTable(int index);
+
+bool jsvalue_to_enum_giargument(JSContext *ctx, GITypeTag storage_type, GIArgument *arg, JSValue value);
+JSValue jsvalue_from_enum_giargument(JSContext *ctx, GITypeTag storage_type, GIArgument *arg);
+
+}
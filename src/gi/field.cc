@@ -0,0 +1,135 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/field.hh"
+#include "gi/value.hh"
+
+namespace QJSGir {
+
+#define FIELD_POINTER(type, data, field)    ((type *)G_STRUCT_MEMBER_P(data, (field)->offset))
+
+/*
+ * Plain numbers, converted in place by the number kernels
+ */
+
+static JSValue get_number_field(JSContext *ctx, FieldAccessor *field, void *data) {
+  return field->from_number(ctx, FIELD_POINTER(GIArgument, data, field));
+}
+
+static bool set_number_field(JSContext *ctx, FieldAccessor *field, void *data, JSValue value) {
+  return field->to_number(ctx, value, FIELD_POINTER(GIArgument, data, field));
+}
+
+/*
+ * Generic converters, for fields that aren't plain numbers
+ */
+
+static JSValue get_generic_field(JSContext *ctx, FieldAccessor *field, void *data) {
+  GIArgument arg;
+
+  if (!g_field_info_get_field(field->info, data, &arg)) {
+    return JS_ThrowTypeError(ctx, "Reading field %s is not supported", g_base_info_get_name(field->info));
+  }
+
+  return jsvalue_from_giargument(ctx, field->type_info, &arg);
+}
+
+static bool set_generic_field(JSContext *ctx, FieldAccessor *field, void *data, JSValue value) {
+  GIArgument arg;
+
+  if (!jsvalue_to_giargument(ctx, field->type_info, &arg, value)) {
+    return false;
+  }
+
+  bool success = g_field_info_set_field(field->info, data, &arg);
+  free_giargument(field->type_info, &arg, GI_TRANSFER_NOTHING, GI_DIRECTION_IN);
+
+  if (!success) {
+    JS_ThrowTypeError(ctx, "Writing field %s is not supported", g_base_info_get_name(field->info));
+  }
+
+  return success;
+}
+
+static void select_converters(FieldAccessor *field, GITypeTag tag) {
+  // Characters are stored as 32 bit code points
+  if (tag == GI_TYPE_TAG_UNICHAR) {
+    tag = GI_TYPE_TAG_UINT32;
+  }
+
+  field->to_number   = GetNumberToArgumentForTag(tag);
+  field->from_number = GetNumberFromArgumentForTag(tag);
+
+  if (field->to_number != nullptr) {
+    field->get = get_number_field;
+    field->set = set_number_field;
+  } else {
+    field->get = get_generic_field;
+    field->set = set_generic_field;
+  }
+}
+
+FieldAccessor::FieldAccessor() {
+  info      = nullptr;
+  type_info = nullptr;
+}
+
+FieldAccessor::~FieldAccessor() {
+  if (info != nullptr) {
+    g_base_info_unref(type_info);
+    g_base_info_unref(info);
+  }
+}
+
+void FieldAccessor::Init(GIFieldInfo *field_info) {
+  info      = g_base_info_ref(field_info);
+  type_info = g_field_info_get_type(info);
+  offset    = g_field_info_get_offset(info);
+
+  GIFieldInfoFlags flags = g_field_info_get_flags(info);
+  readable = (flags & GI_FIELD_IS_READABLE) != 0;
+  writable = (flags & GI_FIELD_IS_WRITABLE) != 0;
+
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  // Enums and flags are stored inline as integers of their storage type
+  if (tag == GI_TYPE_TAG_INTERFACE && !g_type_info_is_pointer(type_info)) {
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    GIInfoType  interface_type = g_base_info_get_type(interface_info);
+
+    if (interface_type == GI_INFO_TYPE_ENUM || interface_type == GI_INFO_TYPE_FLAGS) {
+      tag = g_enum_info_get_storage_type(interface_info);
+    }
+
+    g_base_info_unref(interface_info);
+  }
+
+  // Pointers and bitfields, which have a size in bits, take the generic path
+  if (g_type_info_is_pointer(type_info) || g_field_info_get_size(info) != 0) {
+    tag = GI_TYPE_TAG_VOID;
+  }
+
+  select_converters(this, tag);
+}
+
+#undef FIELD_POINTER
+
+}
@@ -0,0 +1,58 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/number.hh"
+
+namespace QJSGir {
+
+struct FieldAccessor;
+
+typedef JSValue (*FieldGetter)(JSContext *ctx, FieldAccessor *field, void *data);
+typedef bool (*FieldSetter)(JSContext *ctx, FieldAccessor *field, void *data, JSValue value);
+
+/**
+ * Access plan for a single struct/union field. The offset and the converter
+ * are resolved once from the GIFieldInfo, so reads and writes of scalar
+ * fields go straight to the boxed memory.
+ */
+struct FieldAccessor {
+  GIFieldInfo *info;
+  GITypeInfo * type_info;
+  gint         offset;
+  bool         readable;
+  bool         writable;
+
+  FieldGetter  get;
+  FieldSetter  set;
+
+  // Kernels of plain number fields, nullptr for the others
+  NumberToArgument   to_number;
+  NumberFromArgument from_number;
+
+  FieldAccessor();
+  ~FieldAccessor();
+
+  void Init(GIFieldInfo *info);
+};
+
+}
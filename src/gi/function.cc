@@ -15,6 +15,73 @@
  * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
  **/
 
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/function.hh"
+#include "jsapi/AotStubs.hh"
+#include "jsapi/opaque/FunctionInfo.hh"
+#include "jsapi/opaque/JSFunctionInfo.hh"
+
 namespace QJSGir {
 
+/**
+ * Creates the JS function of a GIFunctionInfo. The call plan is shared across
+ * contexts (see GetFunctionInfo), so all this allocates is one callable
+ * object holding a reference to it. Functions with a generated stub skip the
+ * call plan altogether.
+ */
+JSValue MakeFunction(JSContext *ctx, GIBaseInfo *info) {
+  JSValue stub = JS_MakeAotFunction(ctx, info);
+
+  if (!JS_IsUndefined(stub)) {
+    return stub;
+  }
+
+  return JS_MakeOpaqueFunctionInfo(ctx, GetFunctionInfo(info));
+}
+
+static int get_n_methods(GIBaseInfo *info) {
+  switch (g_base_info_get_type(info)) {
+  case GI_INFO_TYPE_OBJECT:    return g_object_info_get_n_methods(info);
+  case GI_INFO_TYPE_INTERFACE: return g_interface_info_get_n_methods(info);
+  case GI_INFO_TYPE_UNION:     return g_union_info_get_n_methods(info);
+  default:                     return g_struct_info_get_n_methods(info);
+  }
+}
+
+static GIFunctionInfo *get_method(GIBaseInfo *info, int i) {
+  switch (g_base_info_get_type(info)) {
+  case GI_INFO_TYPE_OBJECT:    return g_object_info_get_method(info, i);
+  case GI_INFO_TYPE_INTERFACE: return g_interface_info_get_method(info, i);
+  case GI_INFO_TYPE_UNION:     return g_union_info_get_method(info, i);
+  default:                     return g_struct_info_get_method(info, i);
+  }
+}
+
+/**
+ * Installs the instance methods of an object, interface, struct or union on
+ * proto and the rest (constructors, static functions) on class_obj, unless
+ * class_obj is JS_UNDEFINED. Methods are writable and configurable like the
+ * methods of a JS class, so a subclass or an implemented interface can
+ * redefine them.
+ */
+void DefineMethods(JSContext *ctx, GIBaseInfo *info, JSValue proto, JSValue class_obj) {
+  int n_methods = get_n_methods(info);
+
+  for (int i = 0; i < n_methods; i++) {
+    GIFunctionInfo *    meth_info = get_method(info, i);
+    GIFunctionInfoFlags flags     = g_function_info_get_flags(meth_info);
+    bool                is_method = (flags & GI_FUNCTION_IS_METHOD) && !(flags & GI_FUNCTION_IS_CONSTRUCTOR);
+    JSValue             target    = is_method ? proto : class_obj;
+
+    if (JS_IsObject(target)) {
+      JS_DefinePropertyValueStr(ctx, target, g_base_info_get_name(meth_info), MakeFunction(ctx, meth_info),
+                                JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    }
+
+    g_base_info_unref(meth_info);
+  }
+}
+
 }
@@ -22,6 +22,7 @@
 
 namespace QJSGir {
 
-JSValue MakeFunction(GIBaseInfo *info);
+JSValue MakeFunction(JSContext *ctx, GIBaseInfo *info);
+void DefineMethods(JSContext *ctx, GIBaseInfo *info, JSValue proto, JSValue class_obj);
 
 }
@@ -0,0 +1,283 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <math.h>
+#include <quickjs/quickjs.h>
+
+#include <limits>
+
+#include "gi/number.hh"
+
+namespace QJSGir {
+
+template<typename T>
+static inline void store(GIArgument *arg, T value) {
+  *(T *)arg = value;
+}
+
+template<typename T>
+static inline T load(GIArgument *arg) {
+  return *(T *)arg;
+}
+
+/*
+ * JS -> C
+ */
+
+template<typename T>
+static bool throw_out_of_range(JSContext *ctx, const char *value) {
+  JS_ThrowRangeError(ctx, "%s is out of range for %sint%d",
+                     value, std::numeric_limits<T>::is_signed ? "" : "u", (int)(sizeof(T) * 8));
+  return false;
+}
+
+/**
+ * BigInts are range checked through their decimal form, since JS_ToBigInt64
+ * wraps modulo 2^64 and would hide both negative and too large values
+ */
+template<typename T>
+static bool bigint_to_integer(JSContext *ctx, JSValueConst value, GIArgument *arg) {
+  const char *str = JS_ToCString(ctx, value);
+
+  if (str == NULL) {
+    return false;
+  }
+
+  bool success;
+
+  // Nothing is stored on failure, fields keep their value
+  if (std::numeric_limits<T>::is_signed) {
+    gint64 v;
+    success = g_ascii_string_to_signed(str, 10, std::numeric_limits<T>::min(), std::numeric_limits<T>::max(), &v, NULL);
+
+    if (success) {
+      store<T>(arg, (T)v);
+    }
+  } else {
+    guint64 v;
+    success = g_ascii_string_to_unsigned(str, 10, 0, std::numeric_limits<T>::max(), &v, NULL);
+
+    if (success) {
+      store<T>(arg, (T)v);
+    }
+  }
+
+  if (!success) {
+    throw_out_of_range<T>(ctx, str);
+  }
+
+  JS_FreeCString(ctx, str);
+  return success;
+}
+
+/**
+ * Integers are truncated towards zero, and a value outside the range of the C
+ * type throws a RangeError instead of wrapping. A JS_TAG_INT only needs the
+ * check for the types narrower than it or unsigned; 64 bit integers also
+ * accept BigInts, which carry values outside the safe range.
+ */
+template<typename T>
+static bool to_integer(JSContext *ctx, JSValueConst value, GIArgument *arg) {
+  typedef std::numeric_limits<T> limits;
+
+  double v;
+
+  switch (JS_VALUE_GET_TAG(value)) {
+  case JS_TAG_INT: {
+    int32_t i = JS_VALUE_GET_INT(value);
+
+    if (i < (gint64)limits::min() || (i > 0 && (guint64)i > (guint64)limits::max())) {
+      char str[16];
+      g_snprintf(str, sizeof(str), "%d", i);
+      return throw_out_of_range<T>(ctx, str);
+    }
+
+    store<T>(arg, (T)i);
+    return true;
+  }
+
+  case JS_TAG_BIG_INT:
+    if (sizeof(T) == sizeof(gint64)) {
+      return bigint_to_integer<T>(ctx, value, arg);
+    }
+
+    // Narrower types take numbers only, ToFloat64 throws the TypeError
+    if (JS_ToFloat64(ctx, &v, value) < 0) {
+      return false;
+    }
+    break;
+
+  case JS_TAG_FLOAT64:
+    v = JS_VALUE_GET_FLOAT64(value);
+    break;
+
+  default:
+    if (JS_ToFloat64(ctx, &v, value) < 0) {
+      return false;
+    }
+    break;
+  }
+
+  // max() + 1 is a power of two, exact as a double even where max() isn't
+  double truncated = trunc(v);
+
+  if (!(truncated >= (double)limits::min() && truncated < (double)limits::max() + 1.0)) {
+    char str[G_ASCII_DTOSTR_BUF_SIZE];
+    return throw_out_of_range<T>(ctx, g_ascii_dtostr(str, sizeof(str), v));
+  }
+
+  store<T>(arg, (T)truncated);
+  return true;
+}
+
+template<typename T>
+static bool to_float(JSContext *ctx, JSValueConst value, GIArgument *arg) {
+  double v;
+
+  switch (JS_VALUE_GET_TAG(value)) {
+  case JS_TAG_INT:
+    store<T>(arg, (T)JS_VALUE_GET_INT(value));
+    return true;
+
+  case JS_TAG_FLOAT64:
+    store<T>(arg, (T)JS_VALUE_GET_FLOAT64(value));
+    return true;
+
+  default:
+    if (JS_ToFloat64(ctx, &v, value) < 0) {
+      return false;
+    }
+
+    store<T>(arg, (T)v);
+    return true;
+  }
+}
+
+static bool to_boolean(JSContext *ctx, JSValueConst value, GIArgument *arg) {
+  if (JS_VALUE_GET_TAG(value) == JS_TAG_BOOL) {
+    arg->v_boolean = JS_VALUE_GET_BOOL(value);
+    return true;
+  }
+
+  int v = JS_ToBool(ctx, value);
+
+  if (v < 0) {
+    return false;
+  }
+
+  arg->v_boolean = v;
+  return true;
+}
+
+/*
+ * C -> JS
+ */
+
+template<typename T>
+static JSValue from_int32(JSContext *ctx, GIArgument *arg) {
+  return JS_NewInt32(ctx, load<T>(arg));
+}
+
+static JSValue from_uint32(JSContext *ctx, GIArgument *arg) {
+  return JS_NewUint32(ctx, arg->v_uint32);
+}
+
+/**
+ * 64 bit integers are plain numbers unless they don't fit a double exactly
+ */
+static JSValue from_int64(JSContext *ctx, GIArgument *arg) {
+  gint64 v = arg->v_int64;
+
+  if (v >= -MAX_SAFE_INTEGER && v <= MAX_SAFE_INTEGER) {
+    return JS_NewInt64(ctx, v);
+  }
+
+  return JS_NewBigInt64(ctx, v);
+}
+
+static JSValue from_uint64(JSContext *ctx, GIArgument *arg) {
+  guint64 v = arg->v_uint64;
+
+  if (v <= (guint64)MAX_SAFE_INTEGER) {
+    return JS_NewInt64(ctx, (gint64)v);
+  }
+
+  return JS_NewBigUint64(ctx, v);
+}
+
+template<typename T>
+static JSValue from_float(JSContext *ctx, GIArgument *arg) {
+  return JS_NewFloat64(ctx, (double)load<T>(arg));
+}
+
+static JSValue from_boolean(JSContext *ctx, GIArgument *arg) {
+  return JS_NewBool(ctx, arg->v_boolean);
+}
+
+NumberToArgument GetNumberToArgumentForTag(GITypeTag tag) {
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN: return to_boolean;
+  case GI_TYPE_TAG_INT8:    return to_integer<gint8>;
+  case GI_TYPE_TAG_UINT8:   return to_integer<guint8>;
+  case GI_TYPE_TAG_INT16:   return to_integer<gint16>;
+  case GI_TYPE_TAG_UINT16:  return to_integer<guint16>;
+  case GI_TYPE_TAG_INT32:   return to_integer<gint32>;
+  case GI_TYPE_TAG_UINT32:  return to_integer<guint32>;
+  case GI_TYPE_TAG_INT64:   return to_integer<gint64>;
+  case GI_TYPE_TAG_UINT64:  return to_integer<guint64>;
+  case GI_TYPE_TAG_FLOAT:   return to_float<gfloat>;
+  case GI_TYPE_TAG_DOUBLE:  return to_float<gdouble>;
+  default:                  return nullptr;
+  }
+}
+
+NumberFromArgument GetNumberFromArgumentForTag(GITypeTag tag) {
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN: return from_boolean;
+  case GI_TYPE_TAG_INT8:    return from_int32<gint8>;
+  case GI_TYPE_TAG_UINT8:   return from_int32<guint8>;
+  case GI_TYPE_TAG_INT16:   return from_int32<gint16>;
+  case GI_TYPE_TAG_UINT16:  return from_int32<guint16>;
+  case GI_TYPE_TAG_INT32:   return from_int32<gint32>;
+  case GI_TYPE_TAG_UINT32:  return from_uint32;
+  case GI_TYPE_TAG_INT64:   return from_int64;
+  case GI_TYPE_TAG_UINT64:  return from_uint64;
+  case GI_TYPE_TAG_FLOAT:   return from_float<gfloat>;
+  case GI_TYPE_TAG_DOUBLE:  return from_float<gdouble>;
+  default:                  return nullptr;
+  }
+}
+
+NumberToArgument GetNumberToArgument(GITypeInfo *type_info) {
+  if (g_type_info_is_pointer(type_info)) {
+    return nullptr;
+  }
+
+  return GetNumberToArgumentForTag(g_type_info_get_tag(type_info));
+}
+
+NumberFromArgument GetNumberFromArgument(GITypeInfo *type_info) {
+  if (g_type_info_is_pointer(type_info)) {
+    return nullptr;
+  }
+
+  return GetNumberFromArgumentForTag(g_type_info_get_tag(type_info));
+}
+
+}
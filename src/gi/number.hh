@@ -0,0 +1,51 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+// Largest magnitude a double holds exactly, 2^53 - 1; larger 64 bit integers become BigInts
+#define MAX_SAFE_INTEGER    ((gint64)9007199254740991LL)
+
+/**
+ * Conversion kernels for non-pointer numeric and boolean values, specialized
+ * per GI tag with fast paths per JS tag. Call plans pick them once, so the
+ * per-call cost is a single indirect call.
+ */
+typedef bool (*NumberToArgument)(JSContext *ctx, JSValueConst value, GIArgument *arg);
+typedef JSValue (*NumberFromArgument)(JSContext *ctx, GIArgument *arg);
+
+/**
+ * @returns the kernel for type_info, or nullptr if it isn't a plain number
+ */
+NumberToArgument GetNumberToArgument(GITypeInfo *type_info);
+NumberFromArgument GetNumberFromArgument(GITypeInfo *type_info);
+
+/**
+ * @returns the kernel for values of tag stored inline, or nullptr if tag isn't
+ * a plain number. Kernels only touch the first bytes of the GIArgument, the
+ * size of the C type, so they also read and write struct fields in place.
+ */
+NumberToArgument GetNumberToArgumentForTag(GITypeTag tag);
+NumberFromArgument GetNumberFromArgumentForTag(GITypeTag tag);
+
+}
@@ -221,4 +221,20 @@ gsize get_type_size(GITypeInfo *type_info) {
   return size;
 }
 
+/**
+ * Hash/equality for GIBaseInfo keys. Every g_irepository_get_info() call
+ * returns a fresh GIBaseInfo, so identity is the typelib entry instead, which
+ * g_base_info_equal() compares by blob. The offset of the blob has no getter;
+ * the public GIBaseInfo mirrors GIRealInfo, where dummy6 holds it.
+ */
+guint base_info_hash(gconstpointer info) {
+  GIBaseInfo *base_info = (GIBaseInfo *)info;
+
+  return g_direct_hash(g_base_info_get_typelib(base_info)) ^ (base_info->dummy6 * 2654435761u);
+}
+
+gboolean base_info_equal(gconstpointer a, gconstpointer b) {
+  return g_base_info_equal((GIBaseInfo *)a, (GIBaseInfo *)b);
+}
+
 }
@@ -25,4 +25,7 @@ gsize get_type_tag_size(GITypeTag tag);
 char *get_type_name(GITypeInfo *type_info);
 gsize get_type_size(GITypeInfo *type_info);
 
+guint base_info_hash(gconstpointer info);
+gboolean base_info_equal(gconstpointer a, gconstpointer b);
+
 }
@@ -0,0 +1,47 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+
+/*
+ * On-disk layout of a typelib archive, written by quickjs-gobject-typelib-archive
+ * and loaded with LoadTypelibArchive(). All integers are little endian.
+ *
+ *   TypelibArchiveHeader
+ *   TypelibArchiveEntry[n_entries]
+ *   typelib data, each one starting on an 8 byte boundary
+ *
+ * Entries are loaded in order, so dependencies should come first.
+ */
+
+#define TYPELIB_ARCHIVE_MAGIC        "QJSGTLA1"
+#define TYPELIB_ARCHIVE_ALIGNMENT    8
+
+struct TypelibArchiveHeader {
+  char    magic[8];
+  guint32 n_entries;
+  guint32 reserved;
+};
+
+struct TypelibArchiveEntry {
+  char    name[64];   // "Namespace-Version", NUL terminated
+  guint64 offset;     // from the start of the archive
+  guint64 size;
+};
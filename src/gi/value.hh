@@ -34,4 +34,7 @@ void free_giargument(GITypeInfo *type_info, GIArgument *arg, GITransfer transfer
 long giargument_to_length(GITypeInfo *type_info, GIArgument *arg, bool is_pointer);
 void free_giargument_array(GITypeInfo *type_info, GIArgument *arg, GITransfer transfer, GIDirection direction, long length);
 
+JSValue jsvalue_from_gvariant(JSContext *ctx, GVariant *variant);
+GVariant *jsvalue_to_gvariant(JSContext *ctx, const GVariantType *type, JSValue value);
+
 }
@@ -0,0 +1,832 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <math.h>
+#include <quickjs/quickjs.h>
+#include <string.h>
+
+#include "gi/number.hh"
+#include "gi/value.hh"
+#include "utils/jsutils.hh"
+
+/*
+ * GVariant <-> JS conversion working on the serialized form.
+ *
+ * Unpacking walks the bytes of g_variant_get_data() guided by the type
+ * string, following the GVariant serialization format, so no child GVariant
+ * is ever created. Like GLib, malformed data reads as default values rather
+ * than failing. Packing creates the leaves with g_variant_new_* and the
+ * containers from child arrays sized from the JS value up front.
+ */
+
+// Same limit as GLib's G_VARIANT_MAX_RECURSION_DEPTH
+#define MAX_DEPTH           128
+
+static JSValue unpack(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth);
+
+static inline gsize align_up(gsize offset, gsize alignment_mask) {
+  return (offset + alignment_mask) & ~alignment_mask;
+}
+
+/**
+ * Computes the alignment mask and fixed size (0 if variable) of the type at
+ * the start of type.
+ * @returns the end of that type in the string
+ */
+static const char *type_layout(const char *type, gsize *alignment_mask, gsize *fixed_size) {
+  switch (*type) {
+  case 'b':
+  case 'y':
+    *alignment_mask = 0;
+    *fixed_size     = 1;
+    return type + 1;
+
+  case 'n':
+  case 'q':
+    *alignment_mask = 1;
+    *fixed_size     = 2;
+    return type + 1;
+
+  case 'i':
+  case 'u':
+  case 'h':
+    *alignment_mask = 3;
+    *fixed_size     = 4;
+    return type + 1;
+
+  case 'x':
+  case 't':
+  case 'd':
+    *alignment_mask = 7;
+    *fixed_size     = 8;
+    return type + 1;
+
+  case 's':
+  case 'o':
+  case 'g':
+    *alignment_mask = 0;
+    *fixed_size     = 0;
+    return type + 1;
+
+  case 'v':
+    *alignment_mask = 7;
+    *fixed_size     = 0;
+    return type + 1;
+
+  case 'm':
+  case 'a': {
+    gsize       element_size;
+    const char *end = type_layout(type + 1, alignment_mask, &element_size);
+    *fixed_size = 0;
+    return end;
+  }
+
+  case '(':
+  case '{': {
+    const char *member   = type + 1;
+    gsize       offset   = 0;
+    bool        is_fixed = true;
+
+    *alignment_mask = 0;
+
+    while (*member != ')' && *member != '}') {
+      gsize member_alignment, member_size;
+      member = type_layout(member, &member_alignment, &member_size);
+
+      *alignment_mask |= member_alignment;
+      is_fixed         = is_fixed && member_size != 0;
+      offset           = align_up(offset, member_alignment) + member_size;
+    }
+
+    if (is_fixed) {
+      *fixed_size = offset == 0 ? 1 : align_up(offset, *alignment_mask);
+    } else {
+      *fixed_size = 0;
+    }
+
+    return member + 1;
+  }
+
+  default:
+    *alignment_mask = 0;
+    *fixed_size     = 0;
+    return type + 1;
+  }
+}
+
+static inline gsize offset_size_for(gsize container_size) {
+  if (container_size <= G_MAXUINT8) {
+    return 1;
+  }
+
+  if (container_size <= G_MAXUINT16) {
+    return 2;
+  }
+
+  if (container_size <= G_MAXUINT32) {
+    return 4;
+  }
+
+  return 8;
+}
+
+// Framing offsets are always little endian
+static inline gsize read_offset(const guchar *data, gsize offset_size) {
+  gsize value = 0;
+
+  for (gsize i = 0; i < offset_size; i++) {
+    value |= (gsize)data[i] << (8 * i);
+  }
+
+  return value;
+}
+
+template<typename T>
+static inline T read_fixed(const guchar *data, gsize size) {
+  T value = 0;
+
+  if (size == sizeof(T)) {
+    memcpy(&value, data, sizeof(T));
+  }
+
+  return value;
+}
+
+/**
+ * Walks the elements of a serialized array
+ */
+struct ArrayReader {
+  const char *   element_type;
+  gsize          alignment_mask;
+  gsize          fixed_size;
+  const guchar * data;
+  gsize          n_elements;
+  gsize          offset_size;
+  gsize          offsets_start;
+  gsize          next_start;
+  gsize          index;
+
+  ArrayReader(const char *type, const guchar *array_data, gsize size) {
+    element_type = type + 1;
+    data         = array_data;
+    next_start   = 0;
+    index        = 0;
+    n_elements   = 0;
+    offset_size  = 0;
+
+    type_layout(element_type, &alignment_mask, &fixed_size);
+
+    if (size == 0) {
+      return;
+    }
+
+    if (fixed_size != 0) {
+      n_elements = size % fixed_size == 0 ? size / fixed_size : 0;
+      return;
+    }
+
+    offset_size   = offset_size_for(size);
+    offsets_start = read_offset(data + size - offset_size, offset_size);
+
+    if (offsets_start <= size && (size - offsets_start) % offset_size == 0) {
+      n_elements = (size - offsets_start) / offset_size;
+    }
+  }
+
+  /**
+   * @returns false once all elements were read
+   */
+  bool Next(const guchar **child, gsize *child_size) {
+    if (index >= n_elements) {
+      return false;
+    }
+
+    if (fixed_size != 0) {
+      *child      = data + index * fixed_size;
+      *child_size = fixed_size;
+      index++;
+      return true;
+    }
+
+    gsize start = align_up(next_start, alignment_mask);
+    gsize end   = read_offset(data + offsets_start + index * offset_size, offset_size);
+
+    index++;
+    next_start = end;
+
+    if (start > end || end > offsets_start) {
+      *child      = data;
+      *child_size = 0;
+      return true;
+    }
+
+    *child      = data + start;
+    *child_size = end - start;
+    return true;
+  }
+};
+
+/**
+ * Walks the members of a serialized tuple or dict entry
+ */
+struct TupleReader {
+  const char *   member_type;
+  const guchar * data;
+  gsize          size;
+  gsize          offset_size;
+  gsize          n_offsets;
+  gsize          offset;
+
+  TupleReader(const char *type, const guchar *tuple_data, gsize tuple_size) {
+    member_type = type + 1;
+    data        = tuple_data;
+    size        = tuple_size;
+    offset_size = offset_size_for(size);
+    n_offsets   = 0;
+    offset      = 0;
+  }
+
+  /**
+   * @returns false once all members were read
+   */
+  bool Next(const char **type, const guchar **child, gsize *child_size) {
+    if (*member_type == ')' || *member_type == '}') {
+      return false;
+    }
+
+    gsize       alignment_mask, fixed_size, end;
+    const char *next  = type_layout(member_type, &alignment_mask, &fixed_size);
+    gsize       start = align_up(offset, alignment_mask);
+    gsize       limit = size - MIN(size, n_offsets * offset_size);
+
+    if (fixed_size != 0) {
+      end = start + fixed_size;
+    } else if (*next == ')' || *next == '}') {
+      end = limit;
+    } else {
+      n_offsets++;
+      end   = n_offsets * offset_size <= size ? read_offset(data + size - n_offsets * offset_size, offset_size) : 0;
+      limit = size - MIN(size, n_offsets * offset_size);
+    }
+
+    *type       = member_type;
+    member_type = next;
+    offset      = end;
+
+    if (start > end || end > limit) {
+      *child      = data;
+      *child_size = 0;
+      return true;
+    }
+
+    *child      = data + start;
+    *child_size = end - start;
+    return true;
+  }
+};
+
+static JSValue unpack_string(JSContext *ctx, const guchar *data, gsize size) {
+  if (size == 0 || data[size - 1] != '\0' || memchr(data, '\0', size - 1) != NULL) {
+    return JS_NewString(ctx, "");
+  }
+
+  return JS_NewStringLen(ctx, (const char *)data, size - 1);
+}
+
+/**
+ * 64 bit integers go through the number kernels, which pick numbers or BigInts
+ */
+template<typename T>
+static JSValue unpack_int64(JSContext *ctx, GITypeTag tag, T value) {
+  GIArgument arg;
+  *(T *)&arg = value;
+
+  return QJSGir::GetNumberFromArgumentForTag(tag)(ctx, &arg);
+}
+
+static JSValue unpack_variant(JSContext *ctx, const guchar *data, gsize size, int depth) {
+  // The child data is followed by a nul byte and the child's type string
+  gsize separator = size;
+
+  while (separator > 0 && data[separator - 1] != '\0') {
+    separator--;
+  }
+
+  if (separator == 0) {
+    return JS_NULL;
+  }
+
+  const char *type     = (const char *)data + separator;
+  const char *type_end = (const char *)data + size;
+  const char *scanned  = NULL;
+
+  if (!g_variant_type_string_scan(type, type_end, &scanned) || scanned != type_end) {
+    return JS_NULL;
+  }
+
+  return unpack(ctx, type, data, separator - 1, depth + 1);
+}
+
+static JSValue unpack_maybe(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth) {
+  gsize alignment_mask, fixed_size;
+  type_layout(type + 1, &alignment_mask, &fixed_size);
+
+  if (size == 0 || (fixed_size != 0 && size != fixed_size)) {
+    return JS_NULL;
+  }
+
+  // Variable sized children carry an extra nul byte
+  return unpack(ctx, type + 1, data, fixed_size != 0 ? size : size - 1, depth + 1);
+}
+
+static JSValue unpack_byte_array(JSContext *ctx, const guchar *data, gsize size) {
+  JSValue buffer = JS_NewArrayBufferCopy(ctx, data, size);
+
+  if (JS_IsException(buffer)) {
+    return buffer;
+  }
+
+  JSValue global = JS_GetGlobalObject(ctx);
+  JSValue ctor   = JS_GetPropertyStr(ctx, global, "Uint8Array");
+  JSValue array  = JS_CallConstructor(ctx, ctor, 1, &buffer);
+
+  JS_FreeValue(ctx, ctor);
+  JS_FreeValue(ctx, global);
+  JS_FreeValue(ctx, buffer);
+  return array;
+}
+
+static JSValue unpack_dictionary(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth) {
+  ArrayReader   reader(type, data, size);
+  JSValue       obj = JS_NewObject(ctx);
+  const guchar *entry;
+  gsize         entry_size;
+
+  while (reader.Next(&entry, &entry_size)) {
+    TupleReader   entry_reader(reader.element_type, entry, entry_size);
+    const char *  key_type, *value_type;
+    const guchar *key, *value;
+    gsize         key_size, value_size;
+
+    entry_reader.Next(&key_type, &key, &key_size);
+    entry_reader.Next(&value_type, &value, &value_size);
+
+    JSAtom atom;
+
+    if (*key_type == 's' || *key_type == 'o' || *key_type == 'g') {
+      bool valid = key_size > 0 && key[key_size - 1] == '\0';
+      atom = JS_NewAtomLen(ctx, valid ? (const char *)key : "", valid ? strlen((const char *)key) : 0);
+    } else {
+      JSValue key_value = unpack(ctx, key_type, key, key_size, depth + 1);
+      atom = JS_ValueToAtom(ctx, key_value);
+      JS_FreeValue(ctx, key_value);
+    }
+
+    JSValue js_value = unpack(ctx, value_type, value, value_size, depth + 1);
+
+    if (atom == JS_ATOM_NULL || JS_IsException(js_value)) {
+      JS_FreeAtom(ctx, atom);
+      JS_FreeValue(ctx, obj);
+      return JS_EXCEPTION;
+    }
+
+    JS_DefinePropertyValue(ctx, obj, atom, js_value, JS_PROP_C_W_E);
+    JS_FreeAtom(ctx, atom);
+  }
+
+  return obj;
+}
+
+static JSValue unpack_array(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth) {
+  if (type[1] == 'y') {
+    return unpack_byte_array(ctx, data, size);
+  }
+
+  if (type[1] == '{') {
+    return unpack_dictionary(ctx, type, data, size, depth);
+  }
+
+  ArrayReader   reader(type, data, size);
+  JSValue       array = JS_NewArray(ctx);
+  const guchar *child;
+  gsize         child_size;
+
+  while (reader.Next(&child, &child_size)) {
+    JSValue value = unpack(ctx, reader.element_type, child, child_size, depth + 1);
+
+    if (JS_IsException(value)) {
+      JS_FreeValue(ctx, array);
+      return value;
+    }
+
+    JS_DefinePropertyValueUint32(ctx, array, reader.index - 1, value, JS_PROP_C_W_E);
+  }
+
+  return array;
+}
+
+static JSValue unpack_tuple(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth) {
+  TupleReader   reader(type, data, size);
+  JSValue       array = JS_NewArray(ctx);
+  const char *  member_type;
+  const guchar *child;
+  gsize         child_size;
+  uint32_t      index = 0;
+
+  while (reader.Next(&member_type, &child, &child_size)) {
+    JSValue value = unpack(ctx, member_type, child, child_size, depth + 1);
+
+    if (JS_IsException(value)) {
+      JS_FreeValue(ctx, array);
+      return value;
+    }
+
+    JS_DefinePropertyValueUint32(ctx, array, index++, value, JS_PROP_C_W_E);
+  }
+
+  return array;
+}
+
+static JSValue unpack(JSContext *ctx, const char *type, const guchar *data, gsize size, int depth) {
+  if (depth > MAX_DEPTH) {
+    return JS_ThrowRangeError(ctx, "GVariant is nested too deeply");
+  }
+
+  switch (*type) {
+  case 'b': return JS_NewBool(ctx, read_fixed<guint8>(data, size) != 0);
+  case 'y': return JS_NewInt32(ctx, read_fixed<guint8>(data, size));
+  case 'n': return JS_NewInt32(ctx, read_fixed<gint16>(data, size));
+  case 'q': return JS_NewInt32(ctx, read_fixed<guint16>(data, size));
+  case 'i':
+  case 'h': return JS_NewInt32(ctx, read_fixed<gint32>(data, size));
+  case 'u': return JS_NewUint32(ctx, read_fixed<guint32>(data, size));
+  case 'x': return unpack_int64(ctx, GI_TYPE_TAG_INT64, read_fixed<gint64>(data, size));
+  case 't': return unpack_int64(ctx, GI_TYPE_TAG_UINT64, read_fixed<guint64>(data, size));
+  case 'd': return JS_NewFloat64(ctx, read_fixed<gdouble>(data, size));
+  case 's':
+  case 'o':
+  case 'g': return unpack_string(ctx, data, size);
+  case 'v': return unpack_variant(ctx, data, size, depth);
+  case 'm': return unpack_maybe(ctx, type, data, size, depth);
+  case 'a': return unpack_array(ctx, type, data, size, depth);
+  case '(':
+  case '{': return unpack_tuple(ctx, type, data, size, depth);
+  default:  return JS_NULL;
+  }
+}
+
+namespace QJSGir {
+
+/**
+ * Deeply converts variant into JS values: numbers (BigInts for 64 bit values
+ * outside the safe range), strings, null for empty maybes, Uint8Array for
+ * bytestrings, objects for dictionaries and arrays for other arrays and tuples.
+ */
+JSValue jsvalue_from_gvariant(JSContext *ctx, GVariant *variant) {
+  const char *  type = g_variant_get_type_string(variant);
+  const guchar *data = (const guchar *)g_variant_get_data(variant);
+  gsize         size = g_variant_get_size(variant);
+
+  return unpack(ctx, type, data, size, 0);
+}
+
+}
+
+/*
+ * JS -> GVariant
+ */
+
+static GVariant *pack(JSContext *ctx, const GVariantType *type, JSValue value, int depth);
+
+static const GVariantType *infer_type(JSContext *ctx, JSValue value) {
+  switch (JS_VALUE_GET_TAG(value)) {
+  case JS_TAG_BOOL:    return G_VARIANT_TYPE_BOOLEAN;
+  case JS_TAG_INT:     return G_VARIANT_TYPE_INT32;
+  case JS_TAG_FLOAT64: return G_VARIANT_TYPE_DOUBLE;
+  case JS_TAG_BIG_INT: return G_VARIANT_TYPE_INT64;
+  case JS_TAG_STRING:  return G_VARIANT_TYPE_STRING;
+  case JS_TAG_OBJECT:
+    if (JS_IsArray(ctx, value)) {
+      return G_VARIANT_TYPE("av");
+    }
+
+    if (QJSGir::JS_IsTypedArray(ctx, value)) {
+      return G_VARIANT_TYPE_BYTESTRING;
+    }
+
+    return G_VARIANT_TYPE_VARDICT;
+
+  default:
+    return NULL;
+  }
+}
+
+static void free_children(GVariant **children, uint32_t n_children) {
+  for (uint32_t i = 0; i < n_children; i++) {
+    g_variant_unref(children[i]);
+  }
+
+  g_free(children);
+}
+
+static inline bool pack_number(JSContext *ctx, GITypeTag tag, JSValue value, GIArgument *arg) {
+  return QJSGir::GetNumberToArgumentForTag(tag)(ctx, value, arg);
+}
+
+/**
+ * Integers are range checked by the number kernels, like arguments of calls
+ */
+static GVariant *pack_basic(JSContext *ctx, const GVariantType *type, JSValue value) {
+  GIArgument arg;
+
+  switch (*g_variant_type_peek_string(type)) {
+  case 'b':
+    return g_variant_new_boolean(JS_ToBool(ctx, value) > 0);
+
+  case 'y':
+    return pack_number(ctx, GI_TYPE_TAG_UINT8, value, &arg) ? g_variant_new_byte(arg.v_uint8) : NULL;
+
+  case 'n':
+    return pack_number(ctx, GI_TYPE_TAG_INT16, value, &arg) ? g_variant_new_int16(arg.v_int16) : NULL;
+
+  case 'q':
+    return pack_number(ctx, GI_TYPE_TAG_UINT16, value, &arg) ? g_variant_new_uint16(arg.v_uint16) : NULL;
+
+  case 'i':
+    return pack_number(ctx, GI_TYPE_TAG_INT32, value, &arg) ? g_variant_new_int32(arg.v_int32) : NULL;
+
+  case 'h':
+    return pack_number(ctx, GI_TYPE_TAG_INT32, value, &arg) ? g_variant_new_handle(arg.v_int32) : NULL;
+
+  case 'u':
+    return pack_number(ctx, GI_TYPE_TAG_UINT32, value, &arg) ? g_variant_new_uint32(arg.v_uint32) : NULL;
+
+  case 'x':
+    return pack_number(ctx, GI_TYPE_TAG_INT64, value, &arg) ? g_variant_new_int64(arg.v_int64) : NULL;
+
+  case 't':
+    return pack_number(ctx, GI_TYPE_TAG_UINT64, value, &arg) ? g_variant_new_uint64(arg.v_uint64) : NULL;
+
+  case 'd':
+    return pack_number(ctx, GI_TYPE_TAG_DOUBLE, value, &arg) ? g_variant_new_double(arg.v_double) : NULL;
+
+  case 's':
+  case 'o':
+  case 'g': {
+    const char *str = JS_ToCString(ctx, value);
+
+    if (str == NULL) {
+      return NULL;
+    }
+
+    GVariant *result = NULL;
+    char      kind   = *g_variant_type_peek_string(type);
+
+    if (kind == 's') {
+      result = g_variant_new_string(str);
+    } else if (kind == 'o' && g_variant_is_object_path(str)) {
+      result = g_variant_new_object_path(str);
+    } else if (kind == 'g' && g_variant_is_signature(str)) {
+      result = g_variant_new_signature(str);
+    } else {
+      JS_ThrowTypeError(ctx, "'%s' is not a valid %s", str, kind == 'o' ? "object path" : "signature");
+    }
+
+    JS_FreeCString(ctx, str);
+    return result;
+  }
+
+  default:
+    JS_ThrowTypeError(ctx, "Unsupported GVariant type");
+    return NULL;
+  }
+}
+
+static GVariant *pack_dictionary(JSContext *ctx, const GVariantType *type, JSValue value, int depth) {
+  const GVariantType *entry_type = g_variant_type_element(type);
+  const GVariantType *key_type   = g_variant_type_key(entry_type);
+  const GVariantType *value_type = g_variant_type_value(entry_type);
+  char                key_kind   = *g_variant_type_peek_string(key_type);
+  JSPropertyEnum *    props;
+  uint32_t            n_props;
+
+  if (!JS_IsObject(value)) {
+    JS_ThrowTypeError(ctx, "Expected an object for a GVariant dictionary");
+    return NULL;
+  }
+
+  if (JS_GetOwnPropertyNames(ctx, &props, &n_props, value, JS_GPN_STRING_MASK | JS_GPN_ENUM_ONLY) < 0) {
+    return NULL;
+  }
+
+  GVariant **children   = g_new(GVariant *, n_props);
+  uint32_t   n_children = 0;
+  bool       success    = true;
+
+  for (uint32_t i = 0; i < n_props && success; i++) {
+    JSValue key      = JS_AtomToValue(ctx, props[i].atom);
+    JSValue js_value = JS_GetProperty(ctx, value, props[i].atom);
+
+    // Keys are strings in JS, convert them back for the other key types
+    if (key_kind != 's' && key_kind != 'o' && key_kind != 'g') {
+      const char *str    = JS_ToCString(ctx, key);
+      char *      end    = NULL;
+      double      number = str ? g_ascii_strtod(str, &end) : NAN;
+
+      JS_FreeValue(ctx, key);
+      key = JS_UNDEFINED;
+
+      if (key_kind == 'b' && str && (strcmp(str, "true") == 0 || strcmp(str, "false") == 0)) {
+        key = JS_NewBool(ctx, str[0] == 't');
+      } else if (key_kind != 'b' && str && *str != '\0' && *end == '\0' && !isnan(number)) {
+        key = JS_NewFloat64(ctx, number);
+      } else if (str) {
+        JS_ThrowTypeError(ctx, "Key '%s' is not a valid %s", str, key_kind == 'b' ? "boolean" : "number");
+      }
+
+      JS_FreeCString(ctx, str);
+    }
+
+    GVariant *packed_key   = JS_IsUndefined(key) ? NULL : pack(ctx, key_type, key, depth + 1);
+    GVariant *packed_value = packed_key ? pack(ctx, value_type, js_value, depth + 1) : NULL;
+
+    if (packed_value != NULL) {
+      children[n_children++] = g_variant_new_dict_entry(packed_key, packed_value);
+    } else {
+      if (packed_key != NULL) {
+        g_variant_unref(g_variant_ref_sink(packed_key));
+      }
+      success = false;
+    }
+
+    JS_FreeValue(ctx, key);
+    JS_FreeValue(ctx, js_value);
+  }
+
+  for (uint32_t i = 0; i < n_props; i++) {
+    JS_FreeAtom(ctx, props[i].atom);
+  }
+  js_free(ctx, props);
+
+  if (!success) {
+    free_children(children, n_children);
+    return NULL;
+  }
+
+  GVariant *result = g_variant_new_array(entry_type, children, n_children);
+  g_free(children);
+  return result;
+}
+
+static GVariant *pack_array(JSContext *ctx, const GVariantType *type, JSValue value, int depth) {
+  const GVariantType *element_type = g_variant_type_element(type);
+
+  if (g_variant_type_is_dict_entry(element_type)) {
+    return pack_dictionary(ctx, type, value, depth);
+  }
+
+  if (g_variant_type_equal(element_type, G_VARIANT_TYPE_BYTE) && QJSGir::JS_IsTypedArray(ctx, value)) {
+    size_t offset, byte_length, bytes_per_element, buffer_size;
+
+    JSValue  buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byte_length, &bytes_per_element);
+    uint8_t *data   = JS_IsException(buffer) ? NULL : JS_GetArrayBuffer(ctx, &buffer_size, buffer);
+    JS_FreeValue(ctx, buffer);
+
+    if (data == NULL) {
+      return NULL;
+    }
+
+    return g_variant_new_fixed_array(G_VARIANT_TYPE_BYTE, data + offset, byte_length, 1);
+  }
+
+  int64_t length;
+  JSValue length_value = JS_GetPropertyStr(ctx, value, "length");
+  int     failed       = JS_ToInt64(ctx, &length, length_value);
+  JS_FreeValue(ctx, length_value);
+
+  if (failed < 0) {
+    return NULL;
+  }
+
+  if (!JS_IsArray(ctx, value) || length < 0 || length > G_MAXUINT32) {
+    JS_ThrowTypeError(ctx, "Expected an array for a GVariant array");
+    return NULL;
+  }
+
+  GVariant **children = g_new(GVariant *, length);
+
+  for (uint32_t i = 0; i < length; i++) {
+    JSValue child = JS_GetPropertyUint32(ctx, value, i);
+    children[i] = pack(ctx, element_type, child, depth + 1);
+    JS_FreeValue(ctx, child);
+
+    if (children[i] == NULL) {
+      free_children(children, i);
+      return NULL;
+    }
+  }
+
+  GVariant *result = g_variant_new_array(element_type, children, length);
+  g_free(children);
+  return result;
+}
+
+static GVariant *pack_tuple(JSContext *ctx, const GVariantType *type, JSValue value, int depth) {
+  gsize n_items = g_variant_type_n_items(type);
+
+  if (!JS_IsArray(ctx, value)) {
+    JS_ThrowTypeError(ctx, "Expected an array of %zu items for a GVariant tuple", n_items);
+    return NULL;
+  }
+
+  GVariant **         children    = g_new(GVariant *, n_items);
+  const GVariantType *member_type = g_variant_type_first(type);
+
+  for (uint32_t i = 0; i < n_items; i++, member_type = g_variant_type_next(member_type)) {
+    JSValue child = JS_GetPropertyUint32(ctx, value, i);
+    children[i] = pack(ctx, member_type, child, depth + 1);
+    JS_FreeValue(ctx, child);
+
+    if (children[i] == NULL) {
+      free_children(children, i);
+      return NULL;
+    }
+  }
+
+  GVariant *result = g_variant_type_is_dict_entry(type)
+    ? g_variant_new_dict_entry(children[0], children[1])
+    : g_variant_new_tuple(children, n_items);
+
+  g_free(children);
+  return result;
+}
+
+static GVariant *pack(JSContext *ctx, const GVariantType *type, JSValue value, int depth) {
+  if (depth > MAX_DEPTH) {
+    JS_ThrowRangeError(ctx, "Value is nested too deeply for a GVariant");
+    return NULL;
+  }
+
+  switch (*g_variant_type_peek_string(type)) {
+  case 'v': {
+    const GVariantType *inferred = infer_type(ctx, value);
+
+    if (inferred == NULL) {
+      JS_ThrowTypeError(ctx, "Cannot store this value in a GVariant");
+      return NULL;
+    }
+
+    GVariant *child = pack(ctx, inferred, value, depth + 1);
+    return child ? g_variant_new_variant(child) : NULL;
+  }
+
+  case 'm': {
+    const GVariantType *element_type = g_variant_type_element(type);
+
+    if (JS_IsNull(value) || JS_IsUndefined(value)) {
+      return g_variant_new_maybe(element_type, NULL);
+    }
+
+    GVariant *child = pack(ctx, element_type, value, depth + 1);
+    return child ? g_variant_new_maybe(element_type, child) : NULL;
+  }
+
+  case 'a':
+    return pack_array(ctx, type, value, depth);
+
+  case '(':
+  case '{':
+    return pack_tuple(ctx, type, value, depth);
+
+  default:
+    return pack_basic(ctx, type, value);
+  }
+}
+
+namespace QJSGir {
+
+/**
+ * Builds a floating GVariant of the given definite type from value
+ * @returns NULL with a pending exception on failure
+ */
+GVariant *jsvalue_to_gvariant(JSContext *ctx, const GVariantType *type, JSValue value) {
+  return pack(ctx, type, value, 0);
+}
+
+}
@@ -0,0 +1,75 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <dlfcn.h>
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/AllocStats.hh"
+#include "preload/alloc_counter.hh"
+
+namespace QJSGir {
+
+static QJSGirAllocCounters *get_alloc_counters() {
+  static gsize                   initialized = 0;
+  static QJSGirAllocCountersFunc counters_func;
+
+  if (g_once_init_enter(&initialized)) {
+    counters_func = (QJSGirAllocCountersFunc)dlsym(RTLD_DEFAULT, QJS_GIR_ALLOC_COUNTERS_SYMBOL);
+    g_once_init_leave(&initialized, 1);
+  }
+
+  return counters_func ? counters_func() : nullptr;
+}
+
+/**
+ * GI.countAllocations(fn, ...args)
+ * Calls fn(...args) once and returns { mallocs, frees, bytes } done by this
+ * thread during the call, including the engine's own allocations. Needs the
+ * allocation counter library to be preloaded.
+ */
+JSValue js_gi_count_allocations(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  QJSGirAllocCounters *counters = get_alloc_counters();
+
+  if (counters == nullptr) {
+    return JS_ThrowInternalError(ctx, "Allocation counting needs LD_PRELOAD=libquickjs-gobject-alloc-counter.so");
+  }
+
+  if (!JS_IsFunction(ctx, argv[0])) {
+    return JS_ThrowTypeError(ctx, "GI.countAllocations expects a function");
+  }
+
+  QJSGirAllocCounters before = *counters;
+  JSValue             result = JS_Call(ctx, argv[0], JS_UNDEFINED, argc - 1, argv + 1);
+  QJSGirAllocCounters after  = *counters;
+
+  if (JS_IsException(result)) {
+    return result;
+  }
+
+  JS_FreeValue(ctx, result);
+
+  JSValue stats = JS_NewObject(ctx);
+  JS_SetPropertyStr(ctx, stats, "mallocs", JS_NewInt64(ctx, after.mallocs - before.mallocs));
+  JS_SetPropertyStr(ctx, stats, "frees", JS_NewInt64(ctx, after.frees - before.frees));
+  JS_SetPropertyStr(ctx, stats, "bytes", JS_NewInt64(ctx, after.bytes - before.bytes));
+
+  return stats;
+}
+
+}
@@ -0,0 +1,169 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <dlfcn.h>
+#include <girepository.h>
+#include <gmodule.h>
+#include <quickjs/quickjs.h>
+
+#include "aot/aot.hh"
+#include "jsapi/AotStubs.hh"
+#include "jsapi/NamespaceLoader.hh"
+
+namespace QJSGir {
+
+/*
+ * The companion module is looked for next to the library this code lives in.
+ * A namespace is validated once: its version and typelib checksum must match
+ * the ones the stubs were generated from, otherwise no stub of it is used.
+ */
+
+struct AotIndex {
+  GHashTable *functions; // "Container.name" or "name" -> const AotFunction *
+};
+
+G_LOCK_DEFINE_STATIC(aot);
+
+static GHashTable *aot_indexes = NULL; // ns -> AotIndex *, NULL if invalid
+
+static AotFindFunc get_aot_find() {
+  static gsize       initialized = 0;
+  static AotFindFunc find_func   = NULL;
+
+  if (g_once_init_enter(&initialized)) {
+    Dl_info self;
+
+    if (dladdr((void *)&JS_MakeAotFunction, &self) && self.dli_fname != NULL) {
+      char *   dir    = g_path_get_dirname(self.dli_fname);
+      char *   path   = g_module_build_path(dir, "quickjs-gobject-aot");
+      GModule *module = g_module_open(path, G_MODULE_BIND_LAZY);
+
+      if (module != NULL) {
+        g_module_make_resident(module);
+        g_module_symbol(module, QJS_GIR_AOT_FIND_SYMBOL, (gpointer *)&find_func);
+      }
+
+      g_free(path);
+      g_free(dir);
+    }
+
+    g_once_init_leave(&initialized, 1);
+  }
+
+  return find_func;
+}
+
+static AotIndex *validate_namespace(const AotNamespace *aot_ns) {
+  GIRepository *repo    = g_irepository_get_default();
+  const char *  version = g_irepository_get_version(repo, aot_ns->ns);
+
+  if (version == NULL || g_strcmp0(version, aot_ns->version) != 0) {
+    return NULL;
+  }
+
+  char *checksum = GetArchivedTypelibChecksum(aot_ns->ns);
+
+  if (checksum == NULL) {
+    checksum = aot_typelib_checksum(g_irepository_get_typelib_path(repo, aot_ns->ns));
+  }
+
+  bool matches = g_strcmp0(checksum, aot_ns->checksum) == 0;
+  g_free(checksum);
+
+  if (!matches) {
+    g_warning("Ignoring the generated stubs of %s-%s, the typelib has changed", aot_ns->ns, aot_ns->version);
+    return NULL;
+  }
+
+  AotIndex *index  = g_new0(AotIndex, 1);
+  index->functions = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+
+  for (int i = 0; i < aot_ns->n_functions; i++) {
+    const AotFunction *function = &aot_ns->functions[i];
+    char *             key      = function->container
+      ? g_strdup_printf("%s.%s", function->container, function->name)
+      : g_strdup(function->name);
+
+    g_hash_table_insert(index->functions, key, (gpointer)function);
+  }
+
+  return index;
+}
+
+static const AotFunction *find_function(GIBaseInfo *info) {
+  AotFindFunc find_func = get_aot_find();
+
+  if (find_func == NULL) {
+    return NULL;
+  }
+
+  const char *ns = g_base_info_get_namespace(info);
+  AotIndex *  index;
+
+  G_LOCK(aot);
+
+  if (aot_indexes == NULL) {
+    aot_indexes = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+
+  if (!g_hash_table_lookup_extended(aot_indexes, ns, NULL, (gpointer *)&index)) {
+    const AotNamespace *aot_ns = find_func(ns);
+
+    index = aot_ns ? validate_namespace(aot_ns) : NULL;
+    g_hash_table_insert(aot_indexes, g_strdup(ns), index);
+  }
+
+  G_UNLOCK(aot);
+
+  if (index == NULL) {
+    return NULL;
+  }
+
+  GIBaseInfo *container = g_base_info_get_container(info);
+  char *      key       = container
+    ? g_strdup_printf("%s.%s", g_base_info_get_name(container), g_base_info_get_name(info))
+    : g_strdup(g_base_info_get_name(info));
+
+  const AotFunction *function = (const AotFunction *)g_hash_table_lookup(index->functions, key);
+  g_free(key);
+
+  return function;
+}
+
+JSValue JS_MakeAotFunction(JSContext *ctx, GIBaseInfo *info) {
+  const AotFunction *function = find_function(info);
+
+  if (function == NULL) {
+    return JS_UNDEFINED;
+  }
+
+  // The stub calls through this slot; resolving again gives the same address
+  if (*function->address == NULL) {
+    gpointer address = NULL;
+
+    if (!g_typelib_symbol(g_base_info_get_typelib(info), g_function_info_get_symbol(info), &address)) {
+      return JS_UNDEFINED;
+    }
+
+    *function->address = address;
+  }
+
+  return JS_NewCFunction2(ctx, function->stub, function->name, function->length, JS_CFUNC_generic, 0);
+}
+
+}
@@ -0,0 +1,33 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * Returns the generated stub for a function as a plain JS function, or
+ * JS_UNDEFINED if the companion module has none or was generated from a
+ * different typelib than the one loaded.
+ */
+JSValue JS_MakeAotFunction(JSContext *ctx, GIBaseInfo *info);
+
+}
@@ -18,49 +18,56 @@
 #include <girepository.h>
 #include <quickjs/quickjs.h>
 #include "gi/function.hh"
+#include "utils/macros.hh"
+#include "jsapi/AllocStats.hh"
 #include "jsapi/BootstrapGI.hh"
+#include "jsapi/Callback.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DBus.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/Enum.hh"
+#include "jsapi/HeapStats.hh"
+#include "jsapi/MemoryPressure.hh"
+#include "jsapi/MemoryView.hh"
+#include "jsapi/NamespaceLoader.hh"
+#include "jsapi/Scope.hh"
+#include "jsapi/Transfer.hh"
+#include "jsapi/VectorCall.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+#include "jsapi/opaque/JSFunctionInfo.hh"
+#include "jsapi/opaque/ContainerView.hh"
+#include "jsapi/opaque/JSGObject.hh"
 
 namespace QJSGir {
 
 static void DefineFunction(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
   const char *function_name = g_base_info_get_name((GIBaseInfo *)info);
 
-  JSValue fn = QJSGir::MakeFunction(info);
+  JSValue fn = QJSGir::MakeFunction(ctx, info);
 
   JS_DefinePropertyValueStr(ctx, module_obj, function_name, fn, 0);
 }
 
-static void DefineFunction(JSContext *ctx, JSValue module_obj, GIBaseInfo *info, const char *base_name) {
-  JSValue fn = QJSGir::MakeFunction(info);
+/**
+ * Namespace.Class holds the constructors and static functions of the class
+ * and its prototype, which instances inherit the methods from.
+ */
+static void DefineObject(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
+  JSValue class_obj = JS_MakeObjectClass(ctx, info);
 
-  char *function_name = g_strdup_printf("%s_%s", base_name, g_base_info_get_name(info));
+  DefineMethods(ctx, info, JS_UNDEFINED, class_obj);
 
-  JS_DefinePropertyValueStr(ctx, module_obj, function_name, fn, 0);
-  g_free(function_name);
+  JS_DefinePropertyValueStr(ctx, module_obj, g_base_info_get_name(info), class_obj, 0);
 }
 
-static void DefineObjectFunctions(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
-  const char *object_name = g_base_info_get_name((GIBaseInfo *)info);
-
-  int n_methods = g_object_info_get_n_methods(info);
-
-  for (int i = 0; i < n_methods; i++) {
-    GIFunctionInfo *meth_info = g_object_info_get_method(info, i);
-    DefineFunction(ctx, module_obj, meth_info, object_name);
-    g_base_info_unref((GIBaseInfo *)meth_info);
-  }
+static void DefineBoxed(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
+  JS_DefinePropertyValueStr(ctx, module_obj, g_base_info_get_name(info), JS_MakeBoxedConstructor(ctx, info), 0);
 }
 
-static void DefineBoxedFunctions(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
-  const char *object_name = g_base_info_get_name((GIBaseInfo *)info);
+static void DefineEnum(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
+  const char *enum_name = g_base_info_get_name(info);
 
-  int n_methods = g_struct_info_get_n_methods(info);
-
-  for (int i = 0; i < n_methods; i++) {
-    GIFunctionInfo *meth_info = g_struct_info_get_method(info, i);
-    DefineFunction(ctx, module_obj, meth_info, object_name);
-    g_base_info_unref((GIBaseInfo *)meth_info);
-  }
+  JS_DefinePropertyValueStr(ctx, module_obj, enum_name, JS_MakeEnum(ctx, info), 0);
 }
 
 static void DefineBootstrapInfo(JSContext *ctx, JSValue module_obj, GIBaseInfo *info) {
@@ -72,12 +79,18 @@ static void DefineBootstrapInfo(JSContext *ctx, JSValue module_obj, GIBaseInfo *
     break;
 
   case GI_INFO_TYPE_OBJECT:
-    DefineObjectFunctions(ctx, module_obj, info);
+    DefineObject(ctx, module_obj, info);
     break;
 
   case GI_INFO_TYPE_BOXED:
   case GI_INFO_TYPE_STRUCT:
-    DefineBoxedFunctions(ctx, module_obj, info);
+  case GI_INFO_TYPE_UNION:
+    DefineBoxed(ctx, module_obj, info);
+    break;
+
+  case GI_INFO_TYPE_ENUM:
+  case GI_INFO_TYPE_FLAGS:
+    DefineEnum(ctx, module_obj, info);
     break;
 
   default:
@@ -85,25 +98,63 @@ static void DefineBootstrapInfo(JSContext *ctx, JSValue module_obj, GIBaseInfo *
   }
 }
 
+static const JSCFunctionListEntry js_gi_funcs[] = {
+  JS_CFUNC_DEF("setLazyContainers", 1, js_gi_set_lazy_containers),
+  JS_CFUNC_DEF("setBlockingCallbacks", 1, js_gi_set_blocking_callbacks),
+  JS_CFUNC_DEF("memoryStats", 0, js_gi_memory_stats),
+  JS_CFUNC_DEF("heapStats", 0, js_gi_heap_stats),
+  JS_CFUNC_DEF("map", 1, js_gi_map),
+  JS_CFUNC_DEF("setMemoryPressure", 1, js_gi_set_memory_pressure),
+  JS_CFUNC_DEF("setReleaseBatchSize", 1, js_gi_set_release_batch_size),
+  JS_CFUNC_DEF("drainReleases", 0, js_gi_drain_releases),
+  JS_CFUNC_DEF("require", 1, js_gi_require),
+  JS_CFUNC_DEF("countAllocations", 1, js_gi_count_allocations),
+  JS_CFUNC_DEF("transfer", 1, js_gi_transfer),
+  JS_CFUNC_DEF("receive", 1, js_gi_receive),
+  JS_CFUNC_DEF("scope", 1, js_gi_scope),
+  JS_CFUNC_DEF("keep", 1, js_gi_keep),
+  JS_CFUNC_DEF("dbusProxy", 4, js_gi_dbus_proxy),
+  JS_CFUNC_DEF("memoryView", 3, js_gi_memory_view),
+};
+
+static void DefineNamespace(JSContext *ctx, JSValue module_obj, const char *ns) {
+  GIBaseInfo **infos = GetNamespaceInfos(ns);
+
+  for (GIBaseInfo **info = infos; *info != NULL; info++) {
+    DefineBootstrapInfo(ctx, module_obj, *info);
+  }
+
+  FreeNamespaceInfos(infos);
+}
+
+JSValue MakeNamespace(JSContext *ctx, const char *ns) {
+  JSValue ns_obj = JS_NewObject(ctx);
+
+  DefineNamespace(ctx, ns_obj, ns);
+  return ns_obj;
+}
+
 JSValue BootstrapGI(JSContext *ctx) {
-  GIRepository *repo  = g_irepository_get_default();
-  GError *      error = NULL;
+  GError *error = NULL;
 
   const char *ns = "GIRepository";
 
-  g_irepository_require(repo, ns, NULL, (GIRepositoryLoadFlags)0, &error);
+  LoadDefaultTypelibArchive();
+  RequireNamespace(ns, NULL, &error);
 
   if (error) {
     return JS_Throw(ctx, JS_NewString(ctx, error->message));
   }
 
+  if (!js_setup_context_data(ctx) || !js_setup_function_info(ctx)) {
+    return JS_EXCEPTION;
+  }
+
   JSValue module_obj = JS_NewObject(ctx);
 
-  int n = g_irepository_get_n_infos(repo, ns);
-  for (int i = 0; i < n; i++) {
-    GIBaseInfo *info = g_irepository_get_info(repo, ns, i);
-    DefineBootstrapInfo(ctx, module_obj, info);
-  }
+  JS_SetPropertyFunctionList(ctx, module_obj, js_gi_funcs, countof(js_gi_funcs));
+
+  DefineNamespace(ctx, module_obj, ns);
 
   return module_obj;
 }
@@ -21,5 +21,6 @@
 namespace QJSGir {
 
 JSValue BootstrapGI(JSContext *ctx);
+JSValue MakeNamespace(JSContext *ctx, const char *ns);
 
 }
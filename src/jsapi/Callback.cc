@@ -0,0 +1,442 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girffi.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+#include <string.h>
+
+#include "gi/value.hh"
+#include "jsapi/Callback.hh"
+#include "jsapi/ContextData.hh"
+#include "utils/perf_map.hh"
+
+namespace QJSGir {
+
+/**
+ * A call of a callback handed to the JS thread. Blocking calls live on the
+ * stack of the calling thread and point into its frame; the others own a copy
+ * of the argument values.
+ */
+struct CallbackInvocation {
+  QueuedCall call;
+  Callback * callback;
+  bool       release;
+  bool       blocking;
+  void *     ret;
+  void **    args;
+  gint       done;
+};
+
+static GMutex invocation_mutex;
+static GCond  invocation_cond;
+
+/*
+ * A blocked thread only gets its result once the JS thread drains the queue.
+ * If the JS thread is itself waiting on that thread, e.g. joining it inside a
+ * native call, both wait forever, so blocking is opt-in with
+ * GI.setBlockingCallbacks(true). Otherwise such calls are refused.
+ */
+static gint blocking_callbacks_enabled = FALSE;
+
+static void report_exception(JSContext *ctx, Callback *callback) {
+  JSValue     exception = JS_GetException(ctx);
+  const char *message   = JS_ToCString(ctx, exception);
+
+  g_warning("Exception in callback %s.%s: %s",
+            g_base_info_get_namespace(callback->info),
+            g_base_info_get_name(callback->info),
+            message ? message : "?");
+
+  JS_FreeCString(ctx, message);
+  JS_FreeValue(ctx, exception);
+}
+
+static void zero_return(Callback *callback, void *ret) {
+  if (callback->cif.rtype->type != FFI_TYPE_VOID) {
+    memset(ret, 0, MAX(callback->cif.rtype->size, sizeof(ffi_arg)));
+  }
+}
+
+/**
+ * Stores a return value the way libffi expects it from a closure, with
+ * integers narrower than a register widened to ffi_arg.
+ */
+static void store_return(GITypeTag tag, GIArgument *value, void *ret) {
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN: *(ffi_sarg *)ret = value->v_boolean; break;
+  case GI_TYPE_TAG_INT8:    *(ffi_sarg *)ret = value->v_int8; break;
+  case GI_TYPE_TAG_UINT8:   *(ffi_arg *)ret = value->v_uint8; break;
+  case GI_TYPE_TAG_INT16:   *(ffi_sarg *)ret = value->v_int16; break;
+  case GI_TYPE_TAG_UINT16:  *(ffi_arg *)ret = value->v_uint16; break;
+  case GI_TYPE_TAG_INT32:   *(ffi_sarg *)ret = value->v_int32; break;
+  case GI_TYPE_TAG_UINT32:
+  case GI_TYPE_TAG_UNICHAR: *(ffi_arg *)ret = value->v_uint32; break;
+  case GI_TYPE_TAG_INT64:   *(gint64 *)ret = value->v_int64; break;
+  case GI_TYPE_TAG_UINT64:  *(guint64 *)ret = value->v_uint64; break;
+  case GI_TYPE_TAG_FLOAT:   *(gfloat *)ret = value->v_float; break;
+  case GI_TYPE_TAG_DOUBLE:  *(gdouble *)ret = value->v_double; break;
+  case GI_TYPE_TAG_GTYPE:   *(GType *)ret = value->v_size; break;
+  default:                  *(gpointer *)ret = value->v_pointer; break;
+  }
+}
+
+static GITypeTag get_storage_tag(GITypeInfo *type_info) {
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  if (tag == GI_TYPE_TAG_INTERFACE && !g_type_info_is_pointer(type_info)) {
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    GIInfoType  interface_type = g_base_info_get_type(interface_info);
+
+    if (interface_type == GI_INFO_TYPE_ENUM || interface_type == GI_INFO_TYPE_FLAGS) {
+      tag = g_enum_info_get_storage_type(interface_info);
+    }
+
+    g_base_info_unref(interface_info);
+  }
+
+  return tag;
+}
+
+/**
+ * The user_data argument of a callback type points to itself as its closure
+ */
+static inline bool is_user_data(GIArgInfo *arg_info, int i) {
+  return g_arg_info_get_closure(arg_info) == i;
+}
+
+/**
+ * Calls the JS function on the JS thread, converting the arguments and the return value
+ */
+static void invoke_callback(Callback *callback, JSContext *ctx, void *ret, void **args) {
+  if (ctx == NULL) {
+    zero_return(callback, ret);
+    return;
+  }
+
+  int      n_args  = g_callable_info_get_n_args(callback->info);
+  JSValue *js_args = g_newa(JSValue, n_args);
+  bool *   skip    = g_newa(bool, n_args);
+  int      n_js    = 0;
+
+  for (int i = 0; i < n_args; i++) {
+    skip[i] = false;
+  }
+
+  for (int i = 0; i < n_args; i++) {
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(callback->info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    int length_i = g_type_info_get_array_length(&type_info);
+
+    if (is_user_data(&arg_info, i)) {
+      skip[i] = true;
+    }
+
+    if (length_i >= 0 && length_i < n_args) {
+      skip[length_i] = true;
+    }
+  }
+
+  for (int i = 0; i < n_args; i++) {
+    if (skip[i]) {
+      continue;
+    }
+
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(callback->info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    int  length_i = g_type_info_get_array_length(&type_info);
+    long length   = -1;
+
+    if (length_i >= 0 && length_i < n_args) {
+      GIArgInfo  length_info;
+      GITypeInfo length_type;
+      g_callable_info_load_arg(callback->info, length_i, &length_info);
+      g_arg_info_load_type(&length_info, &length_type);
+
+      length = giargument_to_length(&length_type, (GIArgument *)args[length_i], false);
+    }
+
+    bool borrowed = g_arg_info_get_ownership_transfer(&arg_info) == GI_TRANSFER_NOTHING;
+
+    js_args[n_js++] = jsvalue_from_giargument(ctx, &type_info, (GIArgument *)args[i], length, borrowed);
+  }
+
+  JSValue result = JS_Call(ctx, callback->fn, JS_UNDEFINED, n_js, js_args);
+
+  for (int i = 0; i < n_js; i++) {
+    JS_FreeValue(ctx, js_args[i]);
+  }
+
+  if (JS_IsException(result)) {
+    report_exception(ctx, callback);
+    zero_return(callback, ret);
+    return;
+  }
+
+  GITypeInfo return_type;
+  g_callable_info_load_return_type(callback->info, &return_type);
+
+  if (g_type_info_get_tag(&return_type) != GI_TYPE_TAG_VOID) {
+    GIArgument value;
+
+    if (jsvalue_to_giargument(ctx, &return_type, &value, result, g_callable_info_may_return_null(callback->info))) {
+      store_return(get_storage_tag(&return_type), &value, ret);
+    } else {
+      report_exception(ctx, callback);
+      zero_return(callback, ret);
+    }
+  }
+
+  JS_FreeValue(ctx, result);
+}
+
+static void free_callback(Callback *callback) {
+  if (callback->ctx != NULL) {
+    ContextData *context_data = GetContextData(callback->ctx);
+
+    if (context_data != nullptr) {
+      g_hash_table_remove(context_data->callbacks, callback);
+    }
+
+    JS_FreeValue(callback->ctx, callback->fn);
+  }
+
+  g_callable_info_destroy_closure(callback->info, callback->closure);
+  g_base_info_unref(callback->info);
+  CallbackQueueUnref(callback->queue);
+  delete callback;
+}
+
+static void run_invocation(QueuedCall *call, JSContext *ctx) {
+  CallbackInvocation *invocation = (CallbackInvocation *)call;
+  Callback *          callback   = invocation->callback;
+
+  if (invocation->release) {
+    free_callback(callback);
+    g_free(invocation);
+    return;
+  }
+
+  invoke_callback(callback, ctx, invocation->ret, invocation->args);
+
+  if (callback->scope == GI_SCOPE_TYPE_ASYNC) {
+    CallbackDestroyNotify(callback);
+  }
+
+  if (invocation->blocking) {
+    g_mutex_lock(&invocation_mutex);
+    invocation->done = TRUE;
+    g_cond_broadcast(&invocation_cond);
+    g_mutex_unlock(&invocation_mutex);
+  } else {
+    g_free(invocation);
+  }
+}
+
+static void callback_closure(ffi_cif *cif, void *ret, void **args, void *data) {
+  Callback *callback = (Callback *)data;
+
+  if (CallbackQueueIsOwner(callback->queue)) {
+    invoke_callback(callback, callback->ctx, ret, args);
+
+    if (callback->scope == GI_SCOPE_TYPE_ASYNC) {
+      CallbackDestroyNotify(callback);
+    }
+    return;
+  }
+
+  if (callback->blocking) {
+    if (!g_atomic_int_get(&blocking_callbacks_enabled)) {
+      g_warning("Callback %s.%s called from another thread needs GI.setBlockingCallbacks(true), ignored",
+                g_base_info_get_namespace(callback->info),
+                g_base_info_get_name(callback->info));
+      zero_return(callback, ret);
+      return;
+    }
+
+    CallbackInvocation invocation = {};
+    invocation.call.run = run_invocation;
+    invocation.callback = callback;
+    invocation.blocking = true;
+    invocation.ret      = ret;
+    invocation.args     = args;
+
+    CallbackQueuePush(callback->queue, &invocation.call);
+
+    g_mutex_lock(&invocation_mutex);
+    while (!invocation.done) {
+      g_cond_wait(&invocation_cond, &invocation_mutex);
+    }
+    g_mutex_unlock(&invocation_mutex);
+    return;
+  }
+
+  // Nothing is borrowed, so the values can outlive this frame
+  int                 n_args     = cif->nargs;
+  CallbackInvocation *invocation = (CallbackInvocation *)g_malloc0(
+    sizeof(CallbackInvocation) + n_args * (sizeof(void *) + sizeof(GIArgument)));
+  GIArgument *        values     = (GIArgument *)(invocation + 1);
+
+  invocation->call.run = run_invocation;
+  invocation->callback = callback;
+  invocation->args     = (void **)(values + n_args);
+
+  for (int i = 0; i < n_args; i++) {
+    memcpy(&values[i], args[i], MIN(cif->arg_types[i]->size, sizeof(GIArgument)));
+    invocation->args[i] = &values[i];
+  }
+
+  CallbackQueuePush(callback->queue, &invocation->call);
+}
+
+/**
+ * Foreign threads have to wait for the result, or for the JS thread to be
+ * done with pointers that are only valid during the call.
+ */
+static bool needs_blocking(GICallableInfo *info) {
+  GITypeInfo return_type;
+  g_callable_info_load_return_type(info, &return_type);
+
+  if (g_type_info_get_tag(&return_type) != GI_TYPE_TAG_VOID) {
+    return true;
+  }
+
+  for (int i = 0; i < g_callable_info_get_n_args(info); i++) {
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    if (!is_user_data(&arg_info, i) && g_type_info_is_pointer(&type_info) &&
+        g_arg_info_get_ownership_transfer(&arg_info) == GI_TRANSFER_NOTHING) {
+      return true;
+    }
+  }
+
+  return false;
+}
+
+static bool is_supported(GICallableInfo *info) {
+  if (g_callable_info_can_throw_gerror(info)) {
+    return false;
+  }
+
+  for (int i = 0; i < g_callable_info_get_n_args(info); i++) {
+    GIArgInfo arg_info;
+    g_callable_info_load_arg(info, i, &arg_info);
+
+    if (g_arg_info_get_direction(&arg_info) != GI_DIRECTION_IN) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+Callback *JS_ToCallback(JSContext *ctx, GIArgInfo *arg_info, GITypeInfo *type_info, JSValueConst fn) {
+  if (!JS_IsFunction(ctx, fn)) {
+    JS_ThrowTypeError(ctx, "Expected a function for parameter %s", g_base_info_get_name(arg_info));
+    return nullptr;
+  }
+
+  GICallableInfo *info         = g_type_info_get_interface(type_info);
+  CallbackQueue * queue        = GetCallbackQueue(ctx);
+  ContextData *   context_data = GetContextData(ctx);
+
+  if (queue == nullptr || !is_supported(info)) {
+    JS_ThrowTypeError(ctx, "Callbacks of type %s.%s are not supported",
+                      g_base_info_get_namespace(info), g_base_info_get_name(info));
+    g_base_info_unref(info);
+    return nullptr;
+  }
+
+  Callback *callback = new Callback();
+  callback->info     = info;
+  callback->ctx      = ctx;
+  callback->fn       = JS_DupValue(ctx, fn);
+  callback->queue    = CallbackQueueRef(queue);
+  callback->scope    = g_arg_info_get_scope(arg_info);
+  callback->blocking = needs_blocking(info);
+  callback->closure  = g_callable_info_create_closure(info, &callback->cif, callback_closure, callback);
+
+  callback->native_address = g_callable_info_get_closure_native_address(info, callback->closure);
+
+  PerfMapAdd(callback->native_address, FFI_TRAMPOLINE_SIZE, info, "[closure]");
+
+  g_hash_table_add(context_data->callbacks, callback);
+  return callback;
+}
+
+/**
+ * Releases the callback on its JS thread. The release is queued even there:
+ * it then runs after every call already queued, and never from inside the
+ * closure being released.
+ */
+void CallbackDestroyNotify(gpointer data) {
+  Callback *          callback   = (Callback *)data;
+  CallbackInvocation *invocation = g_new0(CallbackInvocation, 1);
+
+  invocation->call.run = run_invocation;
+  invocation->callback = callback;
+  invocation->release  = true;
+
+  CallbackQueuePush(callback->queue, &invocation->call);
+}
+
+void CallbackCallDone(Callback *callback, bool called) {
+  if (callback == nullptr) {
+    return;
+  }
+
+  // Async callbacks release themselves when called, notified ones when notified
+  if (!called || callback->scope == GI_SCOPE_TYPE_CALL || callback->scope == GI_SCOPE_TYPE_INVALID) {
+    CallbackDestroyNotify(callback);
+  }
+}
+
+/**
+ * GI.setBlockingCallbacks(enabled)
+ */
+JSValue js_gi_set_blocking_callbacks(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  g_atomic_int_set(&blocking_callbacks_enabled, JS_ToBool(ctx, argv[0]));
+  return JS_UNDEFINED;
+}
+
+void DetachCallbacks(JSRuntime *rt, GHashTable *callbacks) {
+  GHashTableIter iter;
+  gpointer       key;
+
+  g_hash_table_iter_init(&iter, callbacks);
+  while (g_hash_table_iter_next(&iter, &key, NULL)) {
+    Callback *callback = (Callback *)key;
+
+    JS_FreeValueRT(rt, callback->fn);
+    callback->fn  = JS_UNDEFINED;
+    callback->ctx = NULL;
+  }
+
+  g_hash_table_remove_all(callbacks);
+}
+
+}
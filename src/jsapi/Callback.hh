@@ -0,0 +1,73 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girffi.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/CallbackQueue.hh"
+
+namespace QJSGir {
+
+/**
+ * A JS function passed where C expects a callback. The closure may be called
+ * from any thread: on the JS thread it calls the function directly, from any
+ * other thread it queues the call to the JS thread. Callbacks that return a
+ * value or borrow pointers from their caller block the calling thread until
+ * the JS thread has run them, if enabled with GI.setBlockingCallbacks(), and
+ * are refused otherwise; the others return immediately.
+ */
+struct Callback {
+  GICallableInfo *info;
+  ffi_closure *   closure;
+  gpointer        native_address;
+  ffi_cif         cif;
+
+  // Both reset once the context is gone
+  JSContext *     ctx;
+  JSValue         fn;
+
+  CallbackQueue * queue;
+  GIScopeType     scope;
+  bool            blocking;
+};
+
+/**
+ * Wraps fn for an argument of callback type, throwing if it can't be
+ * @returns the callback or nullptr
+ */
+Callback *JS_ToCallback(JSContext *ctx, GIArgInfo *arg_info, GITypeInfo *type_info, JSValueConst fn);
+
+/**
+ * Tells the callback of an argument that the call is over, releasing it
+ * unless its scope keeps it alive after the call
+ */
+void CallbackCallDone(Callback *callback, bool called);
+
+void CallbackDestroyNotify(gpointer data);
+
+/**
+ * Drops the functions of the callbacks still alive when the context goes away
+ */
+void DetachCallbacks(JSRuntime *rt, GHashTable *callbacks);
+
+JSValue js_gi_set_blocking_callbacks(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
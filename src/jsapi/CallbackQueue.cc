@@ -0,0 +1,193 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/CallbackQueue.hh"
+#include "jsapi/ContextData.hh"
+
+namespace QJSGir {
+
+struct CallbackQueue {
+  gint          ref_count;
+
+  // Most recently pushed first; producers only ever prepend, the consumer takes all
+  QueuedCall *  head;
+
+  GThread *     owner;
+  GMainContext *main_context;
+  GSource *     source;
+
+  // Only read and written by the owner thread, NULL once detached
+  JSContext *   ctx;
+  gint          detached;
+};
+
+struct CallbackSource {
+  GSource        source;
+  CallbackQueue *queue;
+};
+
+static void push_call(CallbackQueue *queue, QueuedCall *call) {
+  QueuedCall *head;
+
+  do {
+    head       = (QueuedCall *)g_atomic_pointer_get(&queue->head);
+    call->next = head;
+  } while (!g_atomic_pointer_compare_and_exchange(&queue->head, head, call));
+
+  // Only the push onto an empty queue has to wake the consumer
+  if (head == NULL) {
+    g_main_context_wakeup(queue->main_context);
+  }
+}
+
+/**
+ * Takes everything queued so far, oldest first
+ */
+static QueuedCall *take_calls(CallbackQueue *queue) {
+  QueuedCall *head;
+
+  do {
+    head = (QueuedCall *)g_atomic_pointer_get(&queue->head);
+  } while (head != NULL && !g_atomic_pointer_compare_and_exchange(&queue->head, head, NULL));
+
+  QueuedCall *reversed = NULL;
+
+  while (head != NULL) {
+    QueuedCall *next = head->next;
+    head->next = reversed;
+    reversed   = head;
+    head       = next;
+  }
+
+  return reversed;
+}
+
+static void run_calls(QueuedCall *call, JSContext *ctx) {
+  while (call != NULL) {
+    QueuedCall *next = call->next;
+    call->run(call, ctx);
+    call = next;
+  }
+}
+
+static gboolean callback_source_prepare(GSource *source, gint *timeout) {
+  CallbackQueue *queue = ((CallbackSource *)source)->queue;
+
+  *timeout = -1;
+  return g_atomic_pointer_get(&queue->head) != NULL;
+}
+
+static gboolean callback_source_check(GSource *source) {
+  CallbackQueue *queue = ((CallbackSource *)source)->queue;
+
+  return g_atomic_pointer_get(&queue->head) != NULL;
+}
+
+static gboolean callback_source_dispatch(GSource *source, GSourceFunc callback, gpointer user_data) {
+  CallbackQueue *queue = ((CallbackSource *)source)->queue;
+
+  run_calls(take_calls(queue), queue->ctx);
+  return G_SOURCE_CONTINUE;
+}
+
+static GSourceFuncs callback_source_funcs = {
+  callback_source_prepare,
+  callback_source_check,
+  callback_source_dispatch,
+  NULL,
+};
+
+static CallbackQueue *callback_queue_new(JSContext *ctx) {
+  CallbackQueue *queue = g_new0(CallbackQueue, 1);
+
+  queue->ref_count    = 1;
+  queue->owner        = g_thread_self();
+  queue->main_context = g_main_context_ref_thread_default();
+  queue->ctx          = ctx;
+
+  queue->source = g_source_new(&callback_source_funcs, sizeof(CallbackSource));
+  ((CallbackSource *)queue->source)->queue = queue;
+  g_source_set_name(queue->source, "quickjs-gobject callbacks");
+  g_source_attach(queue->source, queue->main_context);
+
+  return queue;
+}
+
+/**
+ * @returns the queue of ctx, borrowed, or nullptr if the GI module isn't set up
+ */
+CallbackQueue *GetCallbackQueue(JSContext *ctx) {
+  ContextData *context_data = GetContextData(ctx);
+
+  if (context_data == nullptr) {
+    return nullptr;
+  }
+
+  if (context_data->callback_queue == nullptr) {
+    context_data->callback_queue = callback_queue_new(ctx);
+  }
+
+  return context_data->callback_queue;
+}
+
+CallbackQueue *CallbackQueueRef(CallbackQueue *queue) {
+  g_atomic_int_inc(&queue->ref_count);
+  return queue;
+}
+
+void CallbackQueueUnref(CallbackQueue *queue) {
+  if (!g_atomic_int_dec_and_test(&queue->ref_count)) {
+    return;
+  }
+
+  g_main_context_unref(queue->main_context);
+  g_free(queue);
+}
+
+bool CallbackQueueIsOwner(CallbackQueue *queue) {
+  return queue->owner == g_thread_self();
+}
+
+void CallbackQueuePush(CallbackQueue *queue, QueuedCall *call) {
+  push_call(queue, call);
+
+  /*
+   * Nothing drains a detached queue. A push that raced with CallbackQueueDetach
+   * runs what it finds itself, without a context.
+   */
+  if (g_atomic_int_get(&queue->detached)) {
+    run_calls(take_calls(queue), NULL);
+  }
+}
+
+void CallbackQueueDetach(CallbackQueue *queue) {
+  queue->ctx = NULL;
+  g_atomic_int_set(&queue->detached, TRUE);
+
+  g_source_destroy(queue->source);
+  g_source_unref(queue->source);
+  queue->source = NULL;
+
+  run_calls(take_calls(queue), NULL);
+  CallbackQueueUnref(queue);
+}
+
+}
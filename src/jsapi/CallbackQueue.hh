@@ -0,0 +1,55 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * A unit of work handed to the JS thread of a context. run() is called on
+ * that thread with the context, or with NULL once the context is gone, and
+ * owns the call from then on.
+ */
+struct QueuedCall {
+  QueuedCall *next;
+  void (*run)(QueuedCall *call, JSContext *ctx);
+};
+
+/**
+ * Multi-producer, single-consumer queue into the JS thread of a context.
+ * Any thread may push without taking a lock; the JS thread is woken through
+ * its main context and drains everything queued so far in one batch.
+ */
+struct CallbackQueue;
+
+CallbackQueue *GetCallbackQueue(JSContext *ctx);
+CallbackQueue *CallbackQueueRef(CallbackQueue *queue);
+void CallbackQueueUnref(CallbackQueue *queue);
+
+bool CallbackQueueIsOwner(CallbackQueue *queue);
+void CallbackQueuePush(CallbackQueue *queue, QueuedCall *call);
+
+/**
+ * Called when the context goes away; calls queued later run with a NULL context
+ */
+void CallbackQueueDetach(CallbackQueue *queue);
+
+}
@@ -0,0 +1,313 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/type.hh"
+#include "jsapi/Callback.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/MemoryPressure.hh"
+#include "utils/jsutils.hh"
+
+namespace QJSGir {
+
+/*
+ * The ContextData is the opaque of an object of its own class, kept as that
+ * class's prototype. Class prototypes belong to the context, which marks them
+ * and frees them when it goes away, and scripts can't reach them; so the
+ * lookup needs no lock and the module object shows no extra property.
+ */
+static JSClassID js_context_data_classid;
+
+static void free_value_pointer(gpointer data) {
+  delete (JSValue *)data;
+}
+
+ContextData::ContextData(JSContext *js_ctx) {
+  ctx        = js_ctx;
+  rt         = JS_GetRuntime(js_ctx);
+  prototypes = g_hash_table_new_full(base_info_hash, base_info_equal,
+                                     (GDestroyNotify)g_base_info_unref, free_value_pointer);
+  namespaces = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, free_value_pointer);
+
+  error_prototypes = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, free_value_pointer);
+  callbacks        = g_hash_table_new(g_direct_hash, g_direct_equal);
+  callback_queue   = nullptr;
+  scope            = nullptr;
+  container_views  = false;
+  pending_operations = g_hash_table_new(g_direct_hash, g_direct_equal);
+  heap_groups      = g_hash_table_new(g_direct_hash, g_direct_equal);
+  domain_atom      = JS_NewAtom(ctx, "domain");
+  code_atom        = JS_NewAtom(ctx, "code");
+  message_atom     = JS_NewAtom(ctx, "message");
+
+  RetainMemoryPressure(rt);
+  RetainReleaseQueue(rt);
+}
+
+/**
+ * The cached values are released by the finalizer, which has the runtime at
+ * hand; by then the context is already being torn down.
+ */
+ContextData::~ContextData() {
+  g_hash_table_unref(prototypes);
+  g_hash_table_unref(namespaces);
+  g_hash_table_unref(error_prototypes);
+  g_hash_table_unref(callbacks);
+  g_hash_table_unref(pending_operations);
+  g_hash_table_unref(heap_groups);
+  ReleaseMemoryPressure(rt);
+  DropReleaseQueue(rt);
+}
+
+/**
+ * @returns a new reference to the cached prototype, or JS_UNDEFINED
+ */
+JSValue ContextData::GetPrototype(GIBaseInfo *info) {
+  JSValue *proto = (JSValue *)g_hash_table_lookup(prototypes, info);
+
+  if (proto == nullptr) {
+    return JS_UNDEFINED;
+  }
+
+  return JS_DupValue(ctx, *proto);
+}
+
+/**
+ * Takes ownership of proto
+ */
+void ContextData::SetPrototype(GIBaseInfo *info, JSValue proto) {
+  JSValue *old = (JSValue *)g_hash_table_lookup(prototypes, info);
+
+  if (old != nullptr) {
+    JS_FreeValue(ctx, *old);
+  }
+
+  g_hash_table_replace(prototypes, g_base_info_ref(info), new JSValue(proto));
+}
+
+JSValue ContextData::GetNamespace(const char *ns) {
+  JSValue *ns_obj = (JSValue *)g_hash_table_lookup(namespaces, ns);
+
+  if (ns_obj == nullptr) {
+    return JS_UNDEFINED;
+  }
+
+  return JS_DupValue(ctx, *ns_obj);
+}
+
+void ContextData::SetNamespace(const char *ns, JSValue ns_obj) {
+  JSValue *old = (JSValue *)g_hash_table_lookup(namespaces, ns);
+
+  if (old != nullptr) {
+    JS_FreeValue(ctx, *old);
+  }
+
+  g_hash_table_replace(namespaces, g_strdup(ns), new JSValue(ns_obj));
+}
+
+JSValue ContextData::GetErrorPrototype(GQuark domain) {
+  JSValue *proto = (JSValue *)g_hash_table_lookup(error_prototypes, GUINT_TO_POINTER(domain));
+
+  if (proto == nullptr) {
+    return JS_UNDEFINED;
+  }
+
+  return JS_DupValue(ctx, *proto);
+}
+
+void ContextData::SetErrorPrototype(GQuark domain, JSValue proto) {
+  JSValue *old = (JSValue *)g_hash_table_lookup(error_prototypes, GUINT_TO_POINTER(domain));
+
+  if (old != nullptr) {
+    JS_FreeValue(ctx, *old);
+  }
+
+  g_hash_table_replace(error_prototypes, GUINT_TO_POINTER(domain), new JSValue(proto));
+}
+
+/**
+ * Caches the process-wide group, so creating a wrapper doesn't take the heap
+ * stats lock once its type was seen in this context
+ */
+HeapGroup *ContextData::GetHeapGroup(HeapKind kind, gconstpointer key, const char *name, const char *ns) {
+  HeapGroup *group = (HeapGroup *)g_hash_table_lookup(heap_groups, key);
+
+  if (group == nullptr) {
+    group = HeapStatsGetGroup(kind, key, name, ns);
+    g_hash_table_insert(heap_groups, (gpointer)key, group);
+  }
+
+  return group;
+}
+
+ContextData *GetContextData(JSContext *ctx) {
+  if (!JS_IsRegisteredClass(JS_GetRuntime(ctx), js_context_data_classid)) {
+    return nullptr;
+  }
+
+  // Only the context's own reference is left once this returns, which is enough
+  JSValue      holder = JS_GetClassProto(ctx, js_context_data_classid);
+  ContextData *data   = (ContextData *)JS_GetOpaque(holder, js_context_data_classid);
+
+  JS_FreeValue(ctx, holder);
+  return data;
+}
+
+void TrackPendingOperation(JSContext *ctx, gpointer operation, PendingCancelFunc cancel) {
+  ContextData *data = GetContextData(ctx);
+
+  if (data != nullptr) {
+    g_hash_table_insert(data->pending_operations, operation, (gpointer)cancel);
+  }
+}
+
+void UntrackPendingOperation(JSContext *ctx, gpointer operation) {
+  ContextData *data = GetContextData(ctx);
+
+  if (data != nullptr) {
+    g_hash_table_remove(data->pending_operations, operation);
+  }
+}
+
+static void cancel_promise(JSRuntime *rt, gpointer operation) {
+  JSValue *resolving_funcs = (JSValue *)operation;
+
+  JS_FreeValueRT(rt, resolving_funcs[0]);
+  JS_FreeValueRT(rt, resolving_funcs[1]);
+  resolving_funcs[0] = resolving_funcs[1] = JS_UNDEFINED;
+}
+
+void TrackPendingPromise(JSContext *ctx, JSValue *resolving_funcs) {
+  TrackPendingOperation(ctx, resolving_funcs, cancel_promise);
+}
+
+bool PendingPromiseCancelled(const JSValue *resolving_funcs) {
+  return JS_IsUndefined(resolving_funcs[0]);
+}
+
+void SettlePendingPromise(JSContext *ctx, JSValue *resolving_funcs, bool reject, JSValue value) {
+  UntrackPendingOperation(ctx, resolving_funcs);
+  JS_SettlePromise(ctx, resolving_funcs, reject, value);
+}
+
+/**
+ * Pending operations can't deliver anything anymore, they only keep their
+ * native state and drop it once they complete. The context is already out of
+ * the table, so operations finalized meanwhile leave this one alone.
+ */
+static void cancel_pending_operations(JSRuntime *rt, GHashTable *table) {
+  GHashTableIter iter;
+  gpointer       operation, cancel;
+
+  g_hash_table_iter_init(&iter, table);
+  while (g_hash_table_iter_next(&iter, &operation, &cancel)) {
+    ((PendingCancelFunc)cancel)(rt, operation);
+  }
+
+  g_hash_table_remove_all(table);
+}
+
+static void free_value_table(JSRuntime *rt, GHashTable *table) {
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_hash_table_iter_init(&iter, table);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    JS_FreeValueRT(rt, *(JSValue *)value);
+  }
+}
+
+static void mark_value_table(JSRuntime *rt, GHashTable *table, JS_MarkFunc *mark_func) {
+  GHashTableIter iter;
+  gpointer       value;
+
+  g_hash_table_iter_init(&iter, table);
+  while (g_hash_table_iter_next(&iter, NULL, &value)) {
+    JS_MarkValue(rt, *(JSValue *)value, mark_func);
+  }
+}
+
+static void js_context_data_finalizer(JSRuntime *rt, JSValue val) {
+  ContextData *data = (ContextData *)JS_GetOpaque(val, js_context_data_classid);
+
+  free_value_table(rt, data->prototypes);
+  free_value_table(rt, data->namespaces);
+  free_value_table(rt, data->error_prototypes);
+  cancel_pending_operations(rt, data->pending_operations);
+
+  // Callbacks may outlive the context, calls arriving later do nothing
+  DetachCallbacks(rt, data->callbacks);
+
+  if (data->callback_queue != nullptr) {
+    CallbackQueueDetach(data->callback_queue);
+  }
+
+  JS_FreeAtomRT(rt, data->domain_atom);
+  JS_FreeAtomRT(rt, data->code_atom);
+  JS_FreeAtomRT(rt, data->message_atom);
+
+  delete data;
+}
+
+static void js_context_data_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func) {
+  ContextData *data = (ContextData *)JS_GetOpaque(val, js_context_data_classid);
+
+  mark_value_table(rt, data->prototypes, mark_func);
+  mark_value_table(rt, data->namespaces, mark_func);
+  mark_value_table(rt, data->error_prototypes, mark_func);
+}
+
+static JSClassDef js_context_data_class = {
+  "ContextData",
+  .finalizer = js_context_data_finalizer,
+  .gc_mark   = js_context_data_mark,
+};
+
+/**
+ * Creates the ContextData of ctx, unless the module was already set up in it,
+ * and ties its lifetime to the context
+ */
+bool js_setup_context_data(JSContext *ctx) {
+  JS_NewClassID(&js_context_data_classid);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, js_context_data_classid) &&
+      JS_NewClass(rt, js_context_data_classid, &js_context_data_class) < 0) {
+    JS_ThrowOutOfMemory(ctx);
+    return false;
+  }
+
+  if (GetContextData(ctx) != nullptr) {
+    return true;
+  }
+
+  JSValue holder = JS_NewObjectClass(ctx, js_context_data_classid);
+
+  if (JS_IsException(holder)) {
+    return false;
+  }
+
+  JS_SetOpaque(holder, new ContextData(ctx));
+  JS_SetClassProto(ctx, js_context_data_classid, holder);
+  return true;
+}
+
+}
@@ -0,0 +1,113 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/CallbackQueue.hh"
+#include "jsapi/HeapStats.hh"
+#include "jsapi/Scope.hh"
+
+namespace QJSGir {
+
+/**
+ * Per-context state of the module. It is owned by the context that imported
+ * the module, through a slot scripts can't see, and lives exactly as long.
+ */
+struct ContextData {
+  JSContext * ctx;
+  JSRuntime * rt;
+
+  // GIBaseInfo -> JSValue *, the prototype used for wrappers of that type
+  GHashTable *prototypes;
+
+  // namespace name -> JSValue *, namespace objects published by GI.require
+  GHashTable *namespaces;
+
+  // GQuark -> JSValue *, the prototype of exceptions thrown for a GError domain
+  GHashTable *error_prototypes;
+
+  // Callback * set, the callbacks created in this context that are still alive
+  GHashTable *callbacks;
+
+  // Calls from other threads into this context, created on first use
+  CallbackQueue *callback_queue;
+
+  // Innermost GI.scope running in this context, nullptr outside of one
+  Scope *     scope;
+
+  // Whether containers are returned as lazy views, set by GI.setLazyContainers
+  bool        container_views;
+
+  // operation -> PendingCancelFunc, operations holding JS values until they complete
+  GHashTable *pending_operations;
+
+  // group key -> HeapGroup *, the heap stats groups of the wrappers made in this context.
+  // Boxed and object groups are keyed by GType or interned name, which never collide
+  GHashTable *heap_groups;
+
+  // property names of GError exceptions, always defined in this order so all of them share a shape
+  JSAtom      domain_atom;
+  JSAtom      code_atom;
+  JSAtom      message_atom;
+
+  ContextData(JSContext *ctx);
+  ~ContextData();
+
+  JSValue GetPrototype(GIBaseInfo *info);
+  void SetPrototype(GIBaseInfo *info, JSValue proto);
+
+  JSValue GetNamespace(const char *ns);
+  void SetNamespace(const char *ns, JSValue ns_obj);
+
+  JSValue GetErrorPrototype(GQuark domain);
+  void SetErrorPrototype(GQuark domain, JSValue proto);
+
+  HeapGroup *GetHeapGroup(HeapKind kind, gconstpointer key, const char *name, const char *ns);
+};
+
+ContextData *GetContextData(JSContext *ctx);
+
+typedef void (*PendingCancelFunc)(JSRuntime *rt, gpointer operation);
+
+/**
+ * Registers an operation that completes later, from the main loop, and holds
+ * JS values of ctx meanwhile. If the context goes away first, cancel frees
+ * those values; the operation must then not touch the context, whose address
+ * may already be reused.
+ */
+void TrackPendingOperation(JSContext *ctx, gpointer operation, PendingCancelFunc cancel);
+void UntrackPendingOperation(JSContext *ctx, gpointer operation);
+
+/**
+ * Tracks the resolving functions of a promise as a pending operation. If the
+ * context goes away first they are freed and set to JS_UNDEFINED, which
+ * PendingPromiseCancelled() reports.
+ */
+void TrackPendingPromise(JSContext *ctx, JSValue *resolving_funcs);
+bool PendingPromiseCancelled(const JSValue *resolving_funcs);
+
+/**
+ * Settles a tracked promise that is not cancelled. Takes ownership of value.
+ */
+void SettlePendingPromise(JSContext *ctx, JSValue *resolving_funcs, bool reject, JSValue value);
+bool js_setup_context_data(JSContext *ctx);
+
+}
@@ -0,0 +1,355 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <gio/gio.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+#include <string.h>
+
+#include "gi/value.hh"
+#include "utils/error.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DBus.hh"
+#include "jsapi/ErrorDomain.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+namespace QJSGir {
+
+/*
+ * GI.dbusProxy(connection, busName, objectPath, interfaceXml[, interfaceName])
+ * binds the methods of a D-Bus interface to a remote object. Each method of
+ * the returned object packs its arguments, calls g_dbus_connection_call and
+ * returns a Promise of the reply: undefined without out arguments, the value
+ * for one, an array for several. Errors reject with the GError.
+ *
+ * What GDBusProxy does per call, looking up the method, parsing signatures
+ * and checking the reply, is done once per interface: the parsed interface
+ * and the argument and reply types of each method are cached for the
+ * process, keyed by the introspection XML and the interface name.
+ */
+
+struct DBusMethodPlan {
+  const char *   name;
+  int            n_in_args;
+  int            n_out_args;
+  GVariantType **in_types;
+  GVariantType * reply_type;
+};
+
+struct DBusInterfacePlan {
+  GDBusNodeInfo *     node;
+  GDBusInterfaceInfo *info;
+  DBusMethodPlan *    methods;
+  int                 n_methods;
+};
+
+/**
+ * A remote object the methods of a proxy call
+ */
+struct DBusBinding {
+  GDBusConnection *        connection;
+  char *                   bus_name;
+  char *                   object_path;
+  const DBusInterfacePlan *plan;
+};
+
+/**
+ * A call waiting for its reply
+ */
+struct PendingDBusCall {
+  JSContext *ctx;
+  JSValue    resolving_funcs[2];
+  int        n_out_args;
+};
+
+// "interfaceName\nxml" -> DBusInterfacePlan *, never released
+static GHashTable *interface_plans = NULL;
+G_LOCK_DEFINE_STATIC(interface_plans);
+
+static JSClassID js_dbus_binding_classid;
+
+static GVariantType *make_tuple_type(GDBusArgInfo **args, int *n_args) {
+  GString *signature = g_string_new("(");
+
+  for (*n_args = 0; args != NULL && args[*n_args] != NULL; (*n_args)++) {
+    g_string_append(signature, args[*n_args]->signature);
+  }
+
+  g_string_append_c(signature, ')');
+
+  GVariantType *type = g_variant_type_new(signature->str);
+  g_string_free(signature, TRUE);
+  return type;
+}
+
+static DBusInterfacePlan *make_interface_plan(GDBusNodeInfo *node, GDBusInterfaceInfo *info) {
+  DBusInterfacePlan *plan = g_new0(DBusInterfacePlan, 1);
+
+  plan->node = g_dbus_node_info_ref(node);
+  plan->info = g_dbus_interface_info_ref(info);
+
+  while (info->methods != NULL && info->methods[plan->n_methods] != NULL) {
+    plan->n_methods++;
+  }
+
+  plan->methods = g_new0(DBusMethodPlan, plan->n_methods);
+
+  for (int i = 0; i < plan->n_methods; i++) {
+    GDBusMethodInfo *method_info = info->methods[i];
+    DBusMethodPlan * method      = &plan->methods[i];
+    GVariantType *   in_type     = make_tuple_type(method_info->in_args, &method->n_in_args);
+
+    method->name       = method_info->name;
+    method->reply_type = make_tuple_type(method_info->out_args, &method->n_out_args);
+    method->in_types   = g_new(GVariantType *, method->n_in_args);
+
+    const GVariantType *member = g_variant_type_first(in_type);
+
+    for (int j = 0; j < method->n_in_args; j++, member = g_variant_type_next(member)) {
+      method->in_types[j] = g_variant_type_copy(member);
+    }
+
+    g_variant_type_free(in_type);
+  }
+
+  return plan;
+}
+
+/**
+ * @returns the cached plan of the interface, or nullptr after throwing
+ */
+static const DBusInterfacePlan *get_interface_plan(JSContext *ctx, const char *xml, const char *interface_name) {
+  char *key = g_strconcat(interface_name ? interface_name : "", "\n", xml, NULL);
+
+  G_LOCK(interface_plans);
+
+  if (interface_plans == NULL) {
+    interface_plans = g_hash_table_new(g_str_hash, g_str_equal);
+  }
+
+  DBusInterfacePlan *plan = (DBusInterfacePlan *)g_hash_table_lookup(interface_plans, key);
+
+  if (plan == nullptr) {
+    GError *       error = NULL;
+    GDBusNodeInfo *node  = g_dbus_node_info_new_for_xml(xml, &error);
+
+    if (node == NULL) {
+      Throw::FromGError(ctx, error);
+      g_error_free(error);
+    } else {
+      GDBusInterfaceInfo *info = interface_name != NULL
+        ? g_dbus_node_info_lookup_interface(node, interface_name)
+        : node->interfaces != NULL ? node->interfaces[0] : NULL;
+
+      if (info != NULL) {
+        plan = make_interface_plan(node, info);
+        g_hash_table_insert(interface_plans, key, plan);
+        key = NULL;
+      } else {
+        JS_ThrowTypeError(ctx, "Interface %s is not described by the XML", interface_name ? interface_name : "");
+      }
+
+      g_dbus_node_info_unref(node);
+    }
+  }
+
+  G_UNLOCK(interface_plans);
+  g_free(key);
+
+  return plan;
+}
+
+static void js_dbus_binding_finalizer(JSRuntime *rt, JSValue val) {
+  DBusBinding *binding = (DBusBinding *)JS_GetOpaque(val, js_dbus_binding_classid);
+
+  g_object_unref(binding->connection);
+  g_free(binding->bus_name);
+  g_free(binding->object_path);
+  delete binding;
+}
+
+static JSClassDef js_dbus_binding_class = {
+  "DBusBinding",
+  .finalizer = js_dbus_binding_finalizer,
+};
+
+static void js_setup_dbus(JSContext *ctx) {
+  JS_NewClassID(&js_dbus_binding_classid);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, js_dbus_binding_classid)) {
+    JS_NewClass(rt, js_dbus_binding_classid, &js_dbus_binding_class);
+  }
+}
+
+static void dbus_call_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+  PendingDBusCall *pending = (PendingDBusCall *)user_data;
+  GError *         error   = NULL;
+  GVariant *       reply   = g_dbus_connection_call_finish(G_DBUS_CONNECTION(source), result, &error);
+
+  // The context went away meanwhile and already released the resolving functions
+  if (!PendingPromiseCancelled(pending->resolving_funcs)) {
+    JSContext *ctx = pending->ctx;
+
+    if (reply == NULL) {
+      g_dbus_error_strip_remote_error(error);
+      SettlePendingPromise(ctx, pending->resolving_funcs, true, JS_NewGError(ctx, error));
+    } else if (pending->n_out_args == 0) {
+      SettlePendingPromise(ctx, pending->resolving_funcs, false, JS_UNDEFINED);
+    } else if (pending->n_out_args == 1) {
+      GVariant *child = g_variant_get_child_value(reply, 0);
+      SettlePendingPromise(ctx, pending->resolving_funcs, false, jsvalue_from_gvariant(ctx, child));
+      g_variant_unref(child);
+    } else {
+      SettlePendingPromise(ctx, pending->resolving_funcs, false, jsvalue_from_gvariant(ctx, reply));
+    }
+  }
+
+  if (reply != NULL) {
+    g_variant_unref(reply);
+  }
+
+  g_clear_error(&error);
+  delete pending;
+}
+
+/**
+ * proxy.Method(...inArgs) -> Promise
+ */
+static JSValue js_dbus_call(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic, JSValue *func_data) {
+  DBusBinding *         binding = (DBusBinding *)JS_GetOpaque(func_data[0], js_dbus_binding_classid);
+  const DBusMethodPlan *method  = &binding->plan->methods[magic];
+
+  if (argc < method->n_in_args) {
+    Throw::NotEnoughArguments(ctx, method->n_in_args, argc);
+    return JS_EXCEPTION;
+  }
+
+  GVariant **children = g_newa(GVariant *, method->n_in_args + 1);
+
+  for (int i = 0; i < method->n_in_args; i++) {
+    children[i] = jsvalue_to_gvariant(ctx, method->in_types[i], argv[i]);
+
+    if (children[i] == NULL) {
+      for (int j = 0; j < i; j++) {
+        g_variant_unref(g_variant_ref_sink(children[j]));
+      }
+      return JS_EXCEPTION;
+    }
+  }
+
+  PendingDBusCall *pending = new PendingDBusCall();
+  JSValue          promise = JS_NewPromiseCapability(ctx, pending->resolving_funcs);
+
+  if (JS_IsException(promise)) {
+    for (int i = 0; i < method->n_in_args; i++) {
+      g_variant_unref(g_variant_ref_sink(children[i]));
+    }
+    delete pending;
+    return promise;
+  }
+
+  pending->ctx        = ctx;
+  pending->n_out_args = method->n_out_args;
+
+  TrackPendingPromise(ctx, pending->resolving_funcs);
+
+  g_dbus_connection_call(binding->connection,
+                         binding->bus_name,
+                         binding->object_path,
+                         binding->plan->info->name,
+                         method->name,
+                         g_variant_new_tuple(children, method->n_in_args),
+                         method->reply_type,
+                         G_DBUS_CALL_FLAGS_NONE,
+                         -1,
+                         NULL,
+                         dbus_call_ready,
+                         pending);
+
+  return promise;
+}
+
+JSValue js_gi_dbus_proxy(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  if (argc < 4) {
+    Throw::NotEnoughArguments(ctx, 4, argc);
+    return JS_EXCEPTION;
+  }
+
+  GObject *connection = JS_GetGObject(argv[0]);
+
+  if (connection == NULL || !g_type_is_a(G_OBJECT_TYPE(connection), G_TYPE_DBUS_CONNECTION)) {
+    return JS_ThrowTypeError(ctx, "Expected a Gio.DBusConnection");
+  }
+
+  // The bus name is null on peer-to-peer connections
+  bool        has_bus_name   = !JS_IsNull(argv[1]);
+  bool        has_interface  = argc > 4 && !JS_IsUndefined(argv[4]);
+  const char *bus_name       = has_bus_name ? JS_ToCString(ctx, argv[1]) : NULL;
+  const char *object_path    = JS_ToCString(ctx, argv[2]);
+  const char *xml            = JS_ToCString(ctx, argv[3]);
+  const char *interface_name = has_interface ? JS_ToCString(ctx, argv[4]) : NULL;
+
+  const DBusInterfacePlan *plan   = nullptr;
+  JSValue                  result = JS_EXCEPTION;
+  bool                     converted =
+    object_path != NULL && xml != NULL && (bus_name != NULL || !has_bus_name) && (interface_name != NULL || !has_interface);
+
+  if (converted) {
+    if (g_variant_is_object_path(object_path)) {
+      plan = get_interface_plan(ctx, xml, interface_name);
+    } else {
+      JS_ThrowTypeError(ctx, "'%s' is not a valid object path", object_path);
+    }
+  }
+
+  if (plan != nullptr) {
+    js_setup_dbus(ctx);
+
+    JSValue binding_obj = JS_NewObjectClass(ctx, js_dbus_binding_classid);
+
+    if (!JS_IsException(binding_obj)) {
+      DBusBinding *binding = new DBusBinding();
+      binding->connection  = G_DBUS_CONNECTION(g_object_ref(connection));
+      binding->bus_name    = g_strdup(bus_name);
+      binding->object_path = g_strdup(object_path);
+      binding->plan        = plan;
+      JS_SetOpaque(binding_obj, binding);
+
+      result = JS_NewObject(ctx);
+
+      for (int i = 0; i < plan->n_methods; i++) {
+        const DBusMethodPlan *method = &plan->methods[i];
+        JSValue fn = JS_NewCFunctionData(ctx, js_dbus_call, method->n_in_args, i, 1, &binding_obj);
+
+        JS_DefinePropertyValueStr(ctx, result, method->name, fn, JS_PROP_C_W_E);
+      }
+
+      JS_FreeValue(ctx, binding_obj);
+    }
+  }
+
+  JS_FreeCString(ctx, bus_name);
+  JS_FreeCString(ctx, object_path);
+  JS_FreeCString(ctx, xml);
+  JS_FreeCString(ctx, interface_name);
+
+  return result;
+}
+
+}
@@ -0,0 +1,237 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/DeferredRelease.hh"
+
+#define DEFAULT_BATCH_SIZE    256
+
+namespace QJSGir {
+
+struct PendingRelease {
+  ReleaseFunc func;
+  gpointer    data;
+};
+
+// JSRuntime * -> ReleaseQueue *
+static GHashTable *release_queue_table = NULL;
+G_LOCK_DEFINE_STATIC(release_queue_table);
+
+// Releases queued by all runtimes, read without the lock
+static gint n_pending_releases = 0;
+
+static ReleaseQueue *lookup(JSRuntime *rt) {
+  return release_queue_table
+    ? (ReleaseQueue *)g_hash_table_lookup(release_queue_table, rt)
+    : nullptr;
+}
+
+/**
+ * Moves up to max pending releases out of the queue, oldest first. Called
+ * with the lock held; the releases run after it is dropped, since they can
+ * finalize more wrappers and queue more releases.
+ */
+static GArray *take_releases(ReleaseQueue *queue, guint max) {
+  guint   n     = MIN(max, queue->pending->len);
+  GArray *batch = g_array_sized_new(FALSE, FALSE, sizeof(PendingRelease), n);
+
+  g_array_append_vals(batch, queue->pending->data, n);
+  g_array_remove_range(queue->pending, 0, n);
+  queue->released += n;
+
+  g_atomic_int_add(&n_pending_releases, -(gint)n);
+
+  return batch;
+}
+
+static guint run_releases(GArray *batch) {
+  guint n = batch->len;
+
+  for (guint i = 0; i < n; i++) {
+    PendingRelease *release = &g_array_index(batch, PendingRelease, i);
+    release->func(release->data);
+  }
+
+  g_array_unref(batch);
+  return n;
+}
+
+static gboolean drain_idle(gpointer user_data) {
+  ReleaseQueue *queue = (ReleaseQueue *)user_data;
+
+  G_LOCK(release_queue_table);
+  GArray *batch = take_releases(queue, MAX(queue->batch_size, 1));
+  G_UNLOCK(release_queue_table);
+
+  run_releases(batch);
+
+  G_LOCK(release_queue_table);
+
+  bool done = queue->pending->len == 0;
+  if (done) {
+    g_source_unref(queue->idle);
+    queue->idle = NULL;
+  }
+
+  G_UNLOCK(release_queue_table);
+  return done ? G_SOURCE_REMOVE : G_SOURCE_CONTINUE;
+}
+
+/**
+ * Every context using the module holds a reference on the queue of its runtime
+ */
+void RetainReleaseQueue(JSRuntime *rt) {
+  G_LOCK(release_queue_table);
+
+  if (release_queue_table == NULL) {
+    release_queue_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  ReleaseQueue *queue = lookup(rt);
+
+  if (queue == nullptr) {
+    queue = new ReleaseQueue();
+    queue->rt           = rt;
+    queue->pending      = g_array_new(FALSE, FALSE, sizeof(PendingRelease));
+    queue->batch_size   = DEFAULT_BATCH_SIZE;
+    queue->main_context = g_main_context_ref_thread_default();
+
+    g_hash_table_insert(release_queue_table, rt, queue);
+  }
+
+  queue->n_contexts++;
+  G_UNLOCK(release_queue_table);
+}
+
+/**
+ * Once the last context is gone, everything still queued is released and
+ * later finalizers release right away.
+ */
+void DropReleaseQueue(JSRuntime *rt) {
+  G_LOCK(release_queue_table);
+
+  ReleaseQueue *queue = lookup(rt);
+
+  if (queue == nullptr || --queue->n_contexts > 0) {
+    G_UNLOCK(release_queue_table);
+    return;
+  }
+
+  g_hash_table_remove(release_queue_table, rt);
+
+  if (queue->idle != NULL) {
+    g_source_destroy(queue->idle);
+    g_source_unref(queue->idle);
+  }
+
+  GArray *batch = take_releases(queue, G_MAXUINT);
+  G_UNLOCK(release_queue_table);
+
+  run_releases(batch);
+
+  g_array_unref(queue->pending);
+  g_main_context_unref(queue->main_context);
+  delete queue;
+}
+
+void DeferRelease(JSRuntime *rt, ReleaseFunc func, gpointer data) {
+  G_LOCK(release_queue_table);
+
+  ReleaseQueue *queue = lookup(rt);
+
+  if (queue == nullptr || queue->batch_size == 0) {
+    G_UNLOCK(release_queue_table);
+    func(data);
+    return;
+  }
+
+  PendingRelease release = { func, data };
+  g_array_append_val(queue->pending, release);
+  g_atomic_int_inc(&n_pending_releases);
+
+  if (queue->idle == NULL) {
+    queue->idle = g_idle_source_new();
+    g_source_set_callback(queue->idle, drain_idle, queue, NULL);
+    g_source_set_name(queue->idle, "quickjs-gobject releases");
+    g_source_attach(queue->idle, queue->main_context);
+  }
+
+  G_UNLOCK(release_queue_table);
+}
+
+gint64 DrainReleases(JSRuntime *rt, guint max) {
+  gint64 total = 0;
+
+  // Releases can queue more releases, so keep going until the queue stays empty
+  do {
+    G_LOCK(release_queue_table);
+    ReleaseQueue *queue = lookup(rt);
+    GArray *      batch = NULL;
+
+    if (queue != nullptr && queue->pending->len > 0) {
+      batch = take_releases(queue, max != 0 ? max : MAX(queue->batch_size, 1));
+    }
+    G_UNLOCK(release_queue_table);
+
+    if (batch == NULL) {
+      break;
+    }
+
+    total += run_releases(batch);
+  } while (max == G_MAXUINT);
+
+  return total;
+}
+
+bool HasPendingReleases() {
+  return g_atomic_int_get(&n_pending_releases) > 0;
+}
+
+/**
+ * GI.setReleaseBatchSize(n)
+ * Finalizers queue native releases, which run n at a time from an idle source.
+ * 0 makes finalizers release right away.
+ */
+JSValue js_gi_set_release_batch_size(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  uint32_t batch_size;
+
+  if (JS_ToUint32(ctx, &batch_size, argv[0])) {
+    return JS_EXCEPTION;
+  }
+
+  G_LOCK(release_queue_table);
+  ReleaseQueue *queue = lookup(JS_GetRuntime(ctx));
+  if (queue != nullptr) {
+    queue->batch_size = batch_size;
+  }
+  G_UNLOCK(release_queue_table);
+
+  return JS_UNDEFINED;
+}
+
+/**
+ * GI.drainReleases()
+ * Runs every queued release now, e.g. at the end of a job, and returns how many ran.
+ */
+JSValue js_gi_drain_releases(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  return JS_NewInt64(ctx, DrainReleases(JS_GetRuntime(ctx), G_MAXUINT));
+}
+
+}
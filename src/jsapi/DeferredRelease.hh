@@ -0,0 +1,72 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+typedef void (*ReleaseFunc)(gpointer data);
+
+/**
+ * Native releases pushed by finalizers of one runtime. Finalizers run inside
+ * the GC, where unreffing a GObject may run arbitrary dispose code; they
+ * queue the release instead. An idle source on the runtime's main context
+ * runs the queue in batches; GI calls and forced GCs drain it as well, for
+ * hosts that don't run a main loop.
+ */
+struct ReleaseQueue {
+  JSRuntime *   rt;
+  int           n_contexts;
+
+  GArray *      pending;     // PendingRelease
+  guint         batch_size;  // 0 releases right away
+  gint64        released;
+
+  GMainContext *main_context;
+  GSource *     idle;        // scheduled drain, NULL if none
+};
+
+void RetainReleaseQueue(JSRuntime *rt);
+void DropReleaseQueue(JSRuntime *rt);
+
+/**
+ * Runs func(data) at the next safe point, or right away if there is no queue.
+ * Only for releases that can run foreign code; plain memory is freed directly.
+ */
+void DeferRelease(JSRuntime *rt, ReleaseFunc func, gpointer data);
+
+/**
+ * Runs up to max releases queued for rt, oldest first; 0 runs one batch of
+ * the configured size. With G_MAXUINT, also runs the ones queued meanwhile
+ * until the queue stays empty. Must not be called from a finalizer.
+ * @returns how many releases ran
+ */
+gint64 DrainReleases(JSRuntime *rt, guint max);
+
+/**
+ * Whether any runtime has queued releases, cheap enough for hot paths
+ */
+bool HasPendingReleases();
+
+JSValue js_gi_set_release_batch_size(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+JSValue js_gi_drain_releases(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
@@ -0,0 +1,70 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/enum.hh"
+#include "jsapi/Enum.hh"
+
+namespace QJSGir {
+
+/**
+ * Enum.nameOf(value)
+ * The magic is the index of the EnumTable, so no per-enum data object is needed.
+ */
+static JSValue js_enum_name_of(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic) {
+  EnumTable *table = GetEnumTable(magic);
+  int64_t    value;
+
+  if (JS_VALUE_GET_TAG(argv[0]) == JS_TAG_INT) {
+    value = JS_VALUE_GET_INT(argv[0]);
+  } else if (JS_ToInt64(ctx, &value, argv[0])) {
+    return JS_EXCEPTION;
+  }
+
+  const char *name = table->NameOf(value);
+
+  return name ? JS_NewString(ctx, name) : JS_UNDEFINED;
+}
+
+/**
+ * Creates the JS object of an enum or flags type: one read-only int property
+ * per member plus nameOf(), made non-extensible so the object keeps a single
+ * stable shape.
+ */
+JSValue JS_MakeEnum(JSContext *ctx, GIEnumInfo *info) {
+  EnumTable *table    = GetEnumTable(info);
+  JSValue    enum_obj = JS_NewObject(ctx);
+
+  if (JS_IsException(enum_obj)) {
+    return enum_obj;
+  }
+
+  for (int i = 0; i < table->n_values; i++) {
+    JS_DefinePropertyValueStr(ctx, enum_obj, table->names[i], JS_NewInt64(ctx, table->values[i]), JS_PROP_ENUMERABLE);
+  }
+
+  JSValue name_of = JS_NewCFunctionMagic(ctx, js_enum_name_of, "nameOf", 1, JS_CFUNC_generic_magic, table->index);
+  JS_DefinePropertyValueStr(ctx, enum_obj, "nameOf", name_of, 0);
+
+  JS_PreventExtensions(ctx, enum_obj);
+  return enum_obj;
+}
+
+}
@@ -0,0 +1,109 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/ContextData.hh"
+#include "jsapi/ErrorDomain.hh"
+#include "jsapi/NamespaceLoader.hh"
+
+namespace QJSGir {
+
+/**
+ * Every error domain gets a prototype inheriting from Error.prototype, named
+ * after its enum (e.g. "Gio.IOErrorEnum") when the domain is introspectable.
+ * The prototype also holds the domain string, which instances share.
+ */
+static JSValue make_error_prototype(JSContext *ctx, ContextData *data, GQuark domain) {
+  JSValue global      = JS_GetGlobalObject(ctx);
+  JSValue error_ctor  = JS_GetPropertyStr(ctx, global, "Error");
+  JSValue error_proto = JS_GetPropertyStr(ctx, error_ctor, "prototype");
+  JSValue proto       = JS_NewObjectProto(ctx, error_proto);
+
+  JS_FreeValue(ctx, error_proto);
+  JS_FreeValue(ctx, error_ctor);
+  JS_FreeValue(ctx, global);
+
+  if (JS_IsException(proto)) {
+    return proto;
+  }
+
+  const char *domain_name = g_quark_to_string(domain);
+  GIEnumInfo *enum_info   = FindErrorDomain(domain);
+  char *      name        = enum_info
+    ? g_strdup_printf("%s.%s", g_base_info_get_namespace(enum_info), g_base_info_get_name(enum_info))
+    : g_strdup(domain_name);
+
+  JS_DefinePropertyValueStr(ctx, proto, "name", JS_NewString(ctx, name), JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+  JS_DefinePropertyValue(ctx, proto, data->domain_atom, JS_NewString(ctx, domain_name), JS_PROP_CONFIGURABLE);
+
+  if (enum_info != NULL) {
+    g_base_info_unref(enum_info);
+  }
+
+  g_free(name);
+  return proto;
+}
+
+/**
+ * Converts a GError into an exception object of its domain's class, with
+ * domain, code and message as own properties. Unlike JS_NewError() no
+ * backtrace is captured: GErrors are routinely used for expected conditions.
+ */
+JSValue JS_NewGError(JSContext *ctx, GError *error) {
+  ContextData *data = GetContextData(ctx);
+
+  if (data == nullptr) {
+    JSValue obj = JS_NewError(ctx);
+    JS_DefinePropertyValueStr(ctx, obj, "message", JS_NewString(ctx, error->message),
+                              JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+    return obj;
+  }
+
+  JSValue proto = data->GetErrorPrototype(error->domain);
+
+  if (JS_IsUndefined(proto)) {
+    proto = make_error_prototype(ctx, data, error->domain);
+
+    if (JS_IsException(proto)) {
+      return proto;
+    }
+
+    data->SetErrorPrototype(error->domain, JS_DupValue(ctx, proto));
+  }
+
+  JSValue obj    = JS_NewObjectProto(ctx, proto);
+  JSValue domain = JS_GetProperty(ctx, proto, data->domain_atom);
+
+  JS_FreeValue(ctx, proto);
+
+  if (JS_IsException(obj)) {
+    JS_FreeValue(ctx, domain);
+    return obj;
+  }
+
+  JS_DefinePropertyValue(ctx, obj, data->domain_atom, domain, JS_PROP_C_W_E);
+  JS_DefinePropertyValue(ctx, obj, data->code_atom, JS_NewInt32(ctx, error->code), JS_PROP_C_W_E);
+  JS_DefinePropertyValue(ctx, obj, data->message_atom, JS_NewString(ctx, error->message),
+                         JS_PROP_WRITABLE | JS_PROP_CONFIGURABLE);
+
+  return obj;
+}
+
+}
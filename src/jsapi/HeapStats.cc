@@ -0,0 +1,151 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+#include "utils/macros.hh"
+#include "jsapi/HeapStats.hh"
+
+namespace QJSGir {
+
+/*
+ * Process-wide counters, updated by the constructors and finalizers of the
+ * wrappers, so a report only walks the groups. Groups are never removed,
+ * their number is bounded by the number of types in use. The lock only guards
+ * the tables; callers keep the group and update it with atomics.
+ */
+
+struct HeapGroup {
+  const char *name;
+  const char *ns;
+  gssize      count;
+  gssize      bytes;
+};
+
+static const char *heap_kind_names[] = {
+  "boxed", "object", "function", "callPlan"
+};
+
+// key -> HeapGroup *, one table per HeapKind
+static GHashTable *heap_groups[countof(heap_kind_names)];
+G_LOCK_DEFINE_STATIC(heap_groups);
+
+HeapGroup *HeapStatsGetGroup(HeapKind kind, gconstpointer key, const char *name, const char *ns) {
+  int index = (int)kind;
+
+  G_LOCK(heap_groups);
+  if (heap_groups[index] == NULL) {
+    heap_groups[index] = g_hash_table_new_full(g_direct_hash, g_direct_equal, NULL, g_free);
+  }
+
+  HeapGroup *group = (HeapGroup *)g_hash_table_lookup(heap_groups[index], key);
+
+  if (group == NULL) {
+    group       = g_new0(HeapGroup, 1);
+    group->name = name;
+    group->ns   = ns;
+    g_hash_table_insert(heap_groups[index], (gpointer)key, group);
+  }
+  G_UNLOCK(heap_groups);
+
+  return group;
+}
+
+void HeapStatsAdd(HeapGroup *group, gint64 count, gint64 bytes) {
+  g_atomic_pointer_add(&group->count, (gssize)count);
+  g_atomic_pointer_add(&group->bytes, (gssize)bytes);
+}
+
+const char *HeapStatsGroupKey(const char *ns, const char *name) {
+  if (name == NULL) {
+    return g_intern_string(ns);
+  }
+
+  char key[256];
+  g_snprintf(key, sizeof(key), "%s.%s", ns, name);
+
+  return g_intern_string(key);
+}
+
+static JSValue make_string_or_null(JSContext *ctx, const char *str) {
+  return str != NULL ? JS_NewString(ctx, str) : JS_NULL;
+}
+
+/**
+ * GI.heapStats()
+ * @returns an array of { kind, namespace, type, count, bytes } with one entry per
+ * group that has live instances. bytes is the native memory owned through the
+ * wrappers: boxed copies, GObject instance sizes and call plans.
+ */
+JSValue js_gi_heap_stats(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  struct Entry {
+    const char *kind;
+    const char *ns;
+    const char *name;
+    gint64      count;
+    gint64      bytes;
+  };
+
+  // Allocations below may run finalizers, which update the groups, so the
+  // tables are copied first and the lock isn't held while building values
+  GArray *entries = g_array_new(FALSE, FALSE, sizeof(Entry));
+
+  G_LOCK(heap_groups);
+  for (size_t kind = 0; kind < countof(heap_kind_names); kind++) {
+    if (heap_groups[kind] == NULL) {
+      continue;
+    }
+
+    GHashTableIter iter;
+    gpointer       value;
+
+    g_hash_table_iter_init(&iter, heap_groups[kind]);
+    while (g_hash_table_iter_next(&iter, NULL, &value)) {
+      HeapGroup *group = (HeapGroup *)value;
+      Entry      entry = {
+        heap_kind_names[kind], group->ns, group->name,
+        (gint64)g_atomic_pointer_get(&group->count), (gint64)g_atomic_pointer_get(&group->bytes)
+      };
+
+      if (entry.count != 0) {
+        g_array_append_val(entries, entry);
+      }
+    }
+  }
+  G_UNLOCK(heap_groups);
+
+  JSValue stats = JS_NewArray(ctx);
+
+  for (guint i = 0; i < entries->len; i++) {
+    Entry * entry = &g_array_index(entries, Entry, i);
+    JSValue item  = JS_NewObject(ctx);
+
+    JS_SetPropertyStr(ctx, item, "kind", JS_NewString(ctx, entry->kind));
+    JS_SetPropertyStr(ctx, item, "namespace", make_string_or_null(ctx, entry->ns));
+    JS_SetPropertyStr(ctx, item, "type", make_string_or_null(ctx, entry->name));
+    JS_SetPropertyStr(ctx, item, "count", JS_NewInt64(ctx, entry->count));
+    JS_SetPropertyStr(ctx, item, "bytes", JS_NewInt64(ctx, entry->bytes));
+    JS_SetPropertyUint32(ctx, stats, i, item);
+  }
+
+  g_array_free(entries, TRUE);
+  return stats;
+}
+
+}
@@ -0,0 +1,52 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+enum class HeapKind {
+  BOXED, OBJECT, FUNCTION, CALL_PLAN
+};
+
+struct HeapGroup;
+
+/**
+ * @returns the group of key, created on first use and never freed. key must
+ * identify the group for the whole process lifetime (a GType or a key from
+ * HeapStatsGroupKey), name and ns must live as long. Takes a lock, so callers
+ * look the group up once and keep it.
+ */
+HeapGroup *HeapStatsGetGroup(HeapKind kind, gconstpointer key, const char *name, const char *ns);
+
+/**
+ * Adjusts the live count and retained native bytes of a group, without locking
+ */
+void HeapStatsAdd(HeapGroup *group, gint64 count, gint64 bytes);
+
+/**
+ * @returns the interned "ns.name", or ns if name is NULL, for groups without a GType
+ */
+const char *HeapStatsGroupKey(const char *ns, const char *name);
+
+JSValue js_gi_heap_stats(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
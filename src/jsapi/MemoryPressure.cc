@@ -0,0 +1,222 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/MemoryPressure.hh"
+
+#define DEFAULT_HEAP_RATIO       1.0
+#define DEFAULT_MIN_THRESHOLD    (8 * 1024 * 1024)
+
+namespace QJSGir {
+
+// JSRuntime * -> MemoryPressure *
+static GHashTable *memory_pressure_table = NULL;
+G_LOCK_DEFINE_STATIC(memory_pressure_table);
+
+static MemoryPressure *lookup(JSRuntime *rt) {
+  return memory_pressure_table
+    ? (MemoryPressure *)g_hash_table_lookup(memory_pressure_table, rt)
+    : nullptr;
+}
+
+/**
+ * Every context using the module holds a reference on the state of its runtime
+ */
+void RetainMemoryPressure(JSRuntime *rt) {
+  G_LOCK(memory_pressure_table);
+
+  if (memory_pressure_table == NULL) {
+    memory_pressure_table = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  MemoryPressure *pressure = lookup(rt);
+
+  if (pressure == nullptr) {
+    pressure = new MemoryPressure();
+    pressure->rt            = rt;
+    pressure->threshold     = DEFAULT_MIN_THRESHOLD;
+    pressure->heap_ratio    = DEFAULT_HEAP_RATIO;
+    pressure->min_threshold = DEFAULT_MIN_THRESHOLD;
+
+    g_hash_table_insert(memory_pressure_table, rt, pressure);
+  }
+
+  pressure->n_contexts++;
+  G_UNLOCK(memory_pressure_table);
+}
+
+void ReleaseMemoryPressure(JSRuntime *rt) {
+  G_LOCK(memory_pressure_table);
+
+  MemoryPressure *pressure = lookup(rt);
+
+  if (pressure != nullptr && --pressure->n_contexts == 0) {
+    g_hash_table_remove(memory_pressure_table, rt);
+    delete pressure;
+  }
+
+  G_UNLOCK(memory_pressure_table);
+}
+
+/**
+ * Accounts bytes of native memory now owned by a wrapper. The JS heap size is
+ * only computed once the external growth since the last forced GC passes the
+ * previous threshold, since JS_ComputeMemoryUsage walks the whole heap.
+ */
+void AddExternalMemory(JSContext *ctx, gint64 bytes) {
+  JSRuntime *rt = JS_GetRuntime(ctx);
+
+  G_LOCK(memory_pressure_table);
+
+  MemoryPressure *pressure = lookup(rt);
+
+  if (pressure == nullptr) {
+    G_UNLOCK(memory_pressure_table);
+    return;
+  }
+
+  pressure->external_bytes += bytes;
+  pressure->external_objects++;
+
+  gint64 growth = pressure->external_bytes - pressure->bytes_at_last_gc;
+  bool   run_gc = false;
+
+  if (growth >= pressure->threshold) {
+    JSMemoryUsage usage;
+    JS_ComputeMemoryUsage(rt, &usage);
+
+    pressure->threshold = MAX(pressure->min_threshold, (gint64)(pressure->heap_ratio * usage.malloc_size));
+    run_gc              = growth >= pressure->threshold;
+  }
+
+  G_UNLOCK(memory_pressure_table);
+
+  if (!run_gc) {
+    return;
+  }
+
+  // Finalizers call RemoveExternalMemory, so the lock can't be held here
+  JS_RunGC(rt);
+
+  // The finalizers only queued the native releases, the memory is freed here
+  DrainReleases(rt, G_MAXUINT);
+
+  G_LOCK(memory_pressure_table);
+
+  pressure = lookup(rt);
+  if (pressure != nullptr) {
+    pressure->gc_count++;
+    pressure->bytes_at_last_gc = pressure->external_bytes;
+  }
+
+  G_UNLOCK(memory_pressure_table);
+}
+
+/**
+ * Called from finalizers. Once the last context is gone, the state is too, and
+ * the remaining wrappers have nothing to report to.
+ */
+void RemoveExternalMemory(JSRuntime *rt, gint64 bytes) {
+  G_LOCK(memory_pressure_table);
+
+  MemoryPressure *pressure = lookup(rt);
+
+  if (pressure != nullptr) {
+    pressure->external_bytes -= bytes;
+    pressure->external_objects--;
+
+    if (pressure->bytes_at_last_gc > pressure->external_bytes) {
+      pressure->bytes_at_last_gc = pressure->external_bytes;
+    }
+  }
+
+  G_UNLOCK(memory_pressure_table);
+}
+
+/**
+ * GI.memoryStats()
+ */
+JSValue js_gi_memory_stats(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  MemoryPressure snapshot = {};
+
+  G_LOCK(memory_pressure_table);
+  MemoryPressure *pressure = lookup(JS_GetRuntime(ctx));
+  if (pressure != nullptr) {
+    snapshot = *pressure;
+  }
+  G_UNLOCK(memory_pressure_table);
+
+  JSValue stats = JS_NewObject(ctx);
+
+  JS_SetPropertyStr(ctx, stats, "externalBytes", JS_NewInt64(ctx, snapshot.external_bytes));
+  JS_SetPropertyStr(ctx, stats, "externalObjects", JS_NewInt64(ctx, snapshot.external_objects));
+  JS_SetPropertyStr(ctx, stats, "bytesAtLastGC", JS_NewInt64(ctx, snapshot.bytes_at_last_gc));
+  JS_SetPropertyStr(ctx, stats, "threshold", JS_NewInt64(ctx, snapshot.threshold));
+  JS_SetPropertyStr(ctx, stats, "heapRatio", JS_NewFloat64(ctx, snapshot.heap_ratio));
+  JS_SetPropertyStr(ctx, stats, "minThreshold", JS_NewInt64(ctx, snapshot.min_threshold));
+  JS_SetPropertyStr(ctx, stats, "gcCount", JS_NewInt64(ctx, snapshot.gc_count));
+
+  return stats;
+}
+
+/**
+ * GI.setMemoryPressure({ heapRatio, minThreshold })
+ * A GC is forced once external memory grew by max(minThreshold, heapRatio * JS heap size).
+ */
+JSValue js_gi_set_memory_pressure(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  double  heap_ratio    = DEFAULT_HEAP_RATIO;
+  int64_t min_threshold = DEFAULT_MIN_THRESHOLD;
+
+  if (JS_IsObject(argv[0])) {
+    JSValue ratio_value     = JS_GetPropertyStr(ctx, argv[0], "heapRatio");
+    JSValue threshold_value = JS_GetPropertyStr(ctx, argv[0], "minThreshold");
+
+    bool failed =
+      (!JS_IsUndefined(ratio_value) && JS_ToFloat64(ctx, &heap_ratio, ratio_value)) ||
+      (!JS_IsUndefined(threshold_value) && JS_ToInt64(ctx, &min_threshold, threshold_value));
+
+    JS_FreeValue(ctx, ratio_value);
+    JS_FreeValue(ctx, threshold_value);
+
+    if (failed) {
+      return JS_EXCEPTION;
+    }
+  }
+
+  if (heap_ratio < 0 || min_threshold < 0) {
+    return JS_ThrowRangeError(ctx, "Memory pressure settings must not be negative");
+  }
+
+  G_LOCK(memory_pressure_table);
+
+  MemoryPressure *pressure = lookup(JS_GetRuntime(ctx));
+  if (pressure != nullptr) {
+    pressure->heap_ratio    = heap_ratio;
+    pressure->min_threshold = min_threshold;
+    pressure->threshold     = min_threshold;
+  }
+
+  G_UNLOCK(memory_pressure_table);
+
+  return JS_UNDEFINED;
+}
+
+}
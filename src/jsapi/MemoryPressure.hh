@@ -0,0 +1,56 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * Native memory retained by wrappers of one runtime. QuickJS only sees the
+ * wrapper objects, so once enough external memory piles up relative to the JS
+ * heap, a GC is forced to give finalizers a chance to release it.
+ */
+struct MemoryPressure {
+  JSRuntime *rt;
+  int        n_contexts;
+
+  gint64     external_bytes;
+  gint64     external_objects;
+
+  // External bytes right after the last forced GC, and growth that forces the next one
+  gint64     bytes_at_last_gc;
+  gint64     threshold;
+
+  double     heap_ratio;
+  gint64     min_threshold;
+  gint64     gc_count;
+};
+
+void RetainMemoryPressure(JSRuntime *rt);
+void ReleaseMemoryPressure(JSRuntime *rt);
+
+void AddExternalMemory(JSContext *ctx, gint64 bytes);
+void RemoveExternalMemory(JSRuntime *rt, gint64 bytes);
+
+JSValue js_gi_memory_stats(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+JSValue js_gi_set_memory_pressure(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
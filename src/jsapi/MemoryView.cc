@@ -0,0 +1,184 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/boxed.hh"
+#include "jsapi/MemoryPressure.hh"
+#include "jsapi/MemoryView.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+namespace QJSGir {
+
+/*
+ * GI.memoryView(owner, ptr, byteLength) makes an ArrayBuffer over native
+ * memory, such as the pixels of a GdkPixbuf or the data of a cairo image
+ * surface, without copying it. The buffer holds a reference to owner, the
+ * struct or object wrapper the memory belongs to, so the memory stays valid
+ * for as long as the buffer is reachable. The caller vouches that the range
+ * belongs to owner; nothing else can check it.
+ *
+ * Owners can lose their memory before they are collected, to GI.scope or to
+ * GI.transfer. Their views are detached first, leaving them empty.
+ */
+
+struct MemoryView {
+  // Strong reference, released with the view
+  JSValue       owner;
+  gconstpointer owner_key;
+
+  // Weak reference, the ArrayBuffer's free function unregisters the view
+  JSValue       buffer;
+  gsize         byte_length;
+
+  // Whether the view is still listed in owner_views
+  bool          registered;
+};
+
+// Opaque of the owner wrapper -> GSList of MemoryView *
+static GHashTable *owner_views = NULL;
+static gint        n_views     = 0;
+G_LOCK_DEFINE_STATIC(owner_views);
+
+/**
+ * Detaching calls the free function right away, and the finalizer calls it
+ * again with a NULL pointer; only the first call releases the view.
+ */
+static void js_memory_view_free(JSRuntime *rt, void *opaque, void *ptr) {
+  MemoryView *view = (MemoryView *)opaque;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  G_LOCK(owner_views);
+  if (view->registered) {
+    GSList *views = (GSList *)g_hash_table_lookup(owner_views, view->owner_key);
+    views = g_slist_remove(views, view);
+
+    if (views != NULL) {
+      g_hash_table_insert(owner_views, (gpointer)view->owner_key, views);
+    } else {
+      g_hash_table_remove(owner_views, view->owner_key);
+    }
+  }
+  G_UNLOCK(owner_views);
+
+  g_atomic_int_add(&n_views, -1);
+  RemoveExternalMemory(rt, view->byte_length);
+  JS_FreeValueRT(rt, view->owner);
+  g_free(view);
+}
+
+void DetachMemoryViews(JSContext *ctx, gconstpointer owner) {
+  if (g_atomic_int_get(&n_views) == 0) {
+    return;
+  }
+
+  G_LOCK(owner_views);
+  GSList *views = (GSList *)g_hash_table_lookup(owner_views, owner);
+
+  for (GSList *l = views; l != NULL; l = l->next) {
+    ((MemoryView *)l->data)->registered = false;
+  }
+
+  g_hash_table_remove(owner_views, owner);
+  G_UNLOCK(owner_views);
+
+  // Detaching calls the free function, which releases the view
+  for (GSList *l = views; l != NULL; l = l->next) {
+    JS_DetachArrayBuffer(ctx, ((MemoryView *)l->data)->buffer);
+  }
+
+  g_slist_free(views);
+}
+
+/**
+ * Addresses come as BigInts, or as numbers when they fit in 53 bits
+ */
+static bool to_address(JSContext *ctx, JSValueConst value, guint8 **address) {
+  int64_t v;
+
+  if (JS_IsBigInt(ctx, value) ? JS_ToBigInt64(ctx, &v, value) < 0 : JS_ToInt64(ctx, &v, value) < 0) {
+    return false;
+  }
+
+  if (v == 0) {
+    JS_ThrowTypeError(ctx, "Cannot make a memory view of a NULL pointer");
+    return false;
+  }
+
+  *address = (guint8 *)GSIZE_TO_POINTER((gsize)v);
+  return true;
+}
+
+/**
+ * GI.memoryView(owner, ptr, byteLength)
+ */
+JSValue js_gi_memory_view(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  gconstpointer owner_key = JS_GetOpaque(argv[0], js_boxed_classid);
+  guint8 *      address;
+  uint64_t      byte_length;
+
+  if (owner_key == nullptr) {
+    owner_key = JS_GetOpaque(argv[0], js_gobject_classid);
+  }
+
+  if (owner_key == nullptr || pointer_from_wrapper(argv[0]) == nullptr) {
+    return JS_ThrowTypeError(ctx, "The owner of a memory view must be a struct or an object that wasn't released");
+  }
+
+  if (!to_address(ctx, argv[1], &address) || JS_ToIndex(ctx, &byte_length, argv[2]) < 0) {
+    return JS_EXCEPTION;
+  }
+
+  MemoryView *view = g_new0(MemoryView, 1);
+  view->owner     = JS_DupValue(ctx, argv[0]);
+  view->owner_key = owner_key;
+
+  JSValue buffer = JS_NewArrayBuffer(ctx, address, byte_length, js_memory_view_free, view, FALSE);
+
+  if (JS_IsException(buffer)) {
+    JS_FreeValue(ctx, view->owner);
+    g_free(view);
+    return buffer;
+  }
+
+  view->buffer      = buffer;
+  view->byte_length = byte_length;
+  view->registered  = true;
+
+  G_LOCK(owner_views);
+  if (owner_views == NULL) {
+    owner_views = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+
+  GSList *views = (GSList *)g_hash_table_lookup(owner_views, owner_key);
+  g_hash_table_insert(owner_views, (gpointer)owner_key, g_slist_prepend(views, view));
+  G_UNLOCK(owner_views);
+
+  g_atomic_int_inc(&n_views);
+
+  // The view keeps its owner alive, however small the owner's own accounting is
+  AddExternalMemory(ctx, byte_length);
+  return buffer;
+}
+
+}
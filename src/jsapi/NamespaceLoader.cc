@@ -0,0 +1,468 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <gmodule.h>
+#include <quickjs/quickjs.h>
+#include <string.h>
+
+#include "gi/typelib_archive.hh"
+#include "jsapi/BootstrapGI.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/ErrorDomain.hh"
+#include "jsapi/NamespaceLoader.hh"
+
+namespace QJSGir {
+
+/*
+ * GI.require("gi:Gtk?version=4.0") returns a promise for the namespace object.
+ *
+ * The typelib is required on the calling thread; g_irepository_require() also
+ * pulls in the typelibs of the dependencies. The repository isn't thread safe
+ * and the JS thread reads it without any lock, so that step can't move to a
+ * worker. It only maps the typelibs though; the expensive part, dlopen'ing the
+ * shared libraries of the namespace and of all its dependencies, runs as
+ * separate jobs on a thread pool, so several namespaces (and the libraries of
+ * one namespace) load in parallel. When the last job is done the namespace
+ * object is built and the promise is settled from an idle source on the main
+ * context of the calling thread.
+ */
+
+struct NamespaceLoad {
+  JSContext *   ctx;
+  JSValue       resolving_funcs[2];
+  GMainContext *main_context;
+
+  char *        ns;
+  char *        version;
+  GError *      error;
+  gint          pending_libraries;
+};
+
+struct LoaderJob {
+  NamespaceLoad *load;
+  char *         library;
+};
+
+G_LOCK_DEFINE_STATIC(repository);
+
+static GThreadPool *loader_pool = NULL;
+G_LOCK_DEFINE_STATIC(loader_pool);
+
+// namespace -> SHA-256 of the archive entry it was loaded from, under the repository lock
+static GHashTable *archive_checksums = NULL;
+
+// library names already opened by a loader, so each is dlopen'd only once
+static GHashTable *opened_libraries = NULL;
+G_LOCK_DEFINE_STATIC(opened_libraries);
+
+GITypelib *RequireNamespace(const char *ns, const char *version, GError **error) {
+  G_LOCK(repository);
+  GITypelib *typelib = g_irepository_require(g_irepository_get_default(), ns, version,
+                                             (GIRepositoryLoadFlags)0, error);
+  G_UNLOCK(repository);
+
+  return typelib;
+}
+
+static bool load_archive_entry(GIRepository *repo, const guint8 *data, gsize length,
+                               const TypelibArchiveEntry *entry, bool *loaded, GError **error) {
+  guint64 offset = GUINT64_FROM_LE(entry->offset);
+  guint64 size   = GUINT64_FROM_LE(entry->size);
+
+  *loaded = false;
+
+  if (memchr(entry->name, '\0', sizeof(entry->name)) == NULL || offset > length || size > length - offset ||
+      offset % TYPELIB_ARCHIVE_ALIGNMENT != 0) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "Corrupt typelib archive entry");
+    return false;
+  }
+
+  // Namespaces that are already there, e.g. from an earlier archive, are kept
+  char *ns      = g_strdup(entry->name);
+  char *version = strrchr(ns, '-');
+
+  if (version != NULL) {
+    *version++ = '\0';
+  }
+
+  if (version != NULL && g_irepository_is_registered(repo, ns, version)) {
+    g_free(ns);
+    return true;
+  }
+
+  GITypelib *typelib = g_typelib_new_from_const_memory(data + offset, size, error);
+
+  if (typelib == NULL) {
+    g_free(ns);
+    return false;
+  }
+
+  if (g_irepository_load_typelib(repo, typelib, (GIRepositoryLoadFlags)0, error) == NULL) {
+    g_typelib_free(typelib);
+    g_free(ns);
+    return false;
+  }
+
+  // The typelib has no file of its own to checksum, so keep the one of its bytes
+  if (archive_checksums == NULL) {
+    archive_checksums = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, g_free);
+  }
+
+  g_hash_table_replace(archive_checksums, ns, g_compute_checksum_for_data(G_CHECKSUM_SHA256, data + offset, size));
+
+  *loaded = true;
+  return true;
+}
+
+/**
+ * Registers every typelib of an archive built by quickjs-gobject-typelib-archive,
+ * so requiring those namespaces later finds them loaded instead of searching
+ * the typelib path. The archive is mapped once and stays mapped, the typelibs
+ * point into it; its pages are shared with other processes mapping it.
+ */
+bool LoadTypelibArchive(const char *path, GError **error) {
+  GMappedFile *file = g_mapped_file_new(path, FALSE, error);
+
+  if (file == NULL) {
+    return false;
+  }
+
+  const guint8 *              data   = (const guint8 *)g_mapped_file_get_contents(file);
+  gsize                       length = g_mapped_file_get_length(file);
+  const TypelibArchiveHeader *header = (const TypelibArchiveHeader *)data;
+  guint32                     n      = length >= sizeof(*header) ? GUINT32_FROM_LE(header->n_entries) : 0;
+
+  if (length < sizeof(*header) || memcmp(header->magic, TYPELIB_ARCHIVE_MAGIC, sizeof(header->magic)) != 0 ||
+      n > (length - sizeof(*header)) / sizeof(TypelibArchiveEntry)) {
+    g_set_error(error, G_FILE_ERROR, G_FILE_ERROR_INVAL, "%s is not a typelib archive", path);
+    g_mapped_file_unref(file);
+    return false;
+  }
+
+  const TypelibArchiveEntry *entries = (const TypelibArchiveEntry *)(header + 1);
+  GIRepository *             repo    = g_irepository_get_default();
+  bool                       success = true;
+  guint32                    loaded  = 0;
+
+  G_LOCK(repository);
+
+  for (guint32 i = 0; i < n && success; i++) {
+    bool entry_loaded = false;
+
+    success = load_archive_entry(repo, data, length, &entries[i], &entry_loaded, error);
+    loaded += entry_loaded;
+  }
+
+  G_UNLOCK(repository);
+
+  // Typelibs that made it in keep pointing into the mapping
+  if (loaded == 0) {
+    g_mapped_file_unref(file);
+  }
+
+  return success;
+}
+
+/**
+ * Loads the archive named by QJS_GIR_TYPELIB_ARCHIVE, once per process
+ */
+void LoadDefaultTypelibArchive() {
+  static gsize initialized = 0;
+
+  if (!g_once_init_enter(&initialized)) {
+    return;
+  }
+
+  const char *path  = g_getenv("QJS_GIR_TYPELIB_ARCHIVE");
+  GError *    error = NULL;
+
+  if (path != NULL && *path != '\0' && !LoadTypelibArchive(path, &error)) {
+    g_warning("Cannot load typelib archive %s: %s", path, error->message);
+    g_error_free(error);
+  }
+
+  g_once_init_leave(&initialized, 1);
+}
+
+/**
+ * @returns the SHA-256 of the archive entry ns was loaded from, free with
+ * g_free(); NULL if ns didn't come from a typelib archive
+ */
+char *GetArchivedTypelibChecksum(const char *ns) {
+  G_LOCK(repository);
+  char *checksum = archive_checksums ? g_strdup((const char *)g_hash_table_lookup(archive_checksums, ns)) : NULL;
+  G_UNLOCK(repository);
+
+  return checksum;
+}
+
+GIBaseInfo **GetNamespaceInfos(const char *ns) {
+  GIRepository *repo = g_irepository_get_default();
+
+  G_LOCK(repository);
+  int          n     = g_irepository_get_n_infos(repo, ns);
+  GIBaseInfo **infos = g_new0(GIBaseInfo *, MAX(n, 0) + 1);
+
+  for (int i = 0; i < n; i++) {
+    infos[i] = g_irepository_get_info(repo, ns, i);
+  }
+  G_UNLOCK(repository);
+
+  return infos;
+}
+
+void FreeNamespaceInfos(GIBaseInfo **infos) {
+  for (GIBaseInfo **info = infos; *info != NULL; info++) {
+    g_base_info_unref(*info);
+  }
+
+  g_free(infos);
+}
+
+GIEnumInfo *FindErrorDomain(GQuark domain) {
+  G_LOCK(repository);
+  GIEnumInfo *info = g_irepository_find_by_error_domain(g_irepository_get_default(), domain);
+  G_UNLOCK(repository);
+
+  return info;
+}
+
+static gboolean namespace_load_publish(gpointer user_data) {
+  NamespaceLoad *load = (NamespaceLoad *)user_data;
+
+  // the context went away while loading, there is nobody left to resolve
+  if (PendingPromiseCancelled(load->resolving_funcs)) {
+    return G_SOURCE_REMOVE;
+  }
+
+  JSContext *  ctx  = load->ctx;
+  ContextData *data = GetContextData(ctx);
+  JSValue      result;
+
+  if (load->error != NULL) {
+    result = JS_NewGError(ctx, load->error);
+  } else {
+    result = data->GetNamespace(load->ns);
+
+    if (JS_IsUndefined(result)) {
+      result = MakeNamespace(ctx, load->ns);
+      data->SetNamespace(load->ns, JS_DupValue(ctx, result));
+    }
+  }
+
+  SettlePendingPromise(ctx, load->resolving_funcs, load->error != NULL, result);
+
+  return G_SOURCE_REMOVE;
+}
+
+static void namespace_load_free(gpointer user_data) {
+  NamespaceLoad *load = (NamespaceLoad *)user_data;
+
+  g_main_context_unref(load->main_context);
+  g_clear_error(&load->error);
+  g_free(load->ns);
+  g_free(load->version);
+  g_free(load);
+}
+
+static void namespace_load_complete(NamespaceLoad *load) {
+  GSource *source = g_idle_source_new();
+
+  g_source_set_priority(source, G_PRIORITY_DEFAULT);
+  g_source_set_callback(source, namespace_load_publish, load, namespace_load_free);
+  g_source_attach(source, load->main_context);
+  g_source_unref(source);
+}
+
+static void open_library(const char *library) {
+  G_LOCK(opened_libraries);
+  bool is_new = g_hash_table_add(opened_libraries, g_strdup(library));
+  G_UNLOCK(opened_libraries);
+
+  if (!is_new) {
+    return;
+  }
+
+  // failures are left for GIRepository to report when a symbol is looked up
+  GModule *module = g_module_open(library, G_MODULE_BIND_LAZY);
+
+  if (module != NULL) {
+    g_module_make_resident(module);
+  }
+}
+
+static void collect_libraries(GIRepository *repo, const char *ns, GPtrArray *libraries) {
+  const char *shared_library = g_irepository_get_shared_library(repo, ns);
+
+  if (shared_library == NULL) {
+    return;
+  }
+
+  char **names = g_strsplit(shared_library, ",", 0);
+
+  for (char **name = names; *name != NULL; name++) {
+    g_ptr_array_add(libraries, *name);
+  }
+
+  // the strings are now owned by the array
+  g_free(names);
+}
+
+static void loader_job_run(gpointer job_data, gpointer user_data) {
+  LoaderJob *job = (LoaderJob *)job_data;
+
+  open_library(job->library);
+
+  if (g_atomic_int_dec_and_test(&job->load->pending_libraries)) {
+    namespace_load_complete(job->load);
+  }
+
+  g_free(job->library);
+  g_free(job);
+}
+
+static GThreadPool *get_loader_pool() {
+  G_LOCK(loader_pool);
+  if (loader_pool == NULL) {
+    loader_pool      = g_thread_pool_new(loader_job_run, NULL, g_get_num_processors(), FALSE, NULL);
+    opened_libraries = g_hash_table_new_full(g_str_hash, g_str_equal, g_free, NULL);
+  }
+  G_UNLOCK(loader_pool);
+
+  return loader_pool;
+}
+
+static void require_namespace(NamespaceLoad *load) {
+  GIRepository *repo = g_irepository_get_default();
+  GPtrArray *   libraries = g_ptr_array_new();
+
+  G_LOCK(repository);
+  if (g_irepository_require(repo, load->ns, load->version, (GIRepositoryLoadFlags)0, &load->error)) {
+    char **dependencies = g_irepository_get_dependencies(repo, load->ns);
+
+    collect_libraries(repo, load->ns, libraries);
+
+    for (char **dep = dependencies; dep != NULL && *dep != NULL; dep++) {
+      // dependencies are listed as "Namespace-Version"
+      char *dash = strrchr(*dep, '-');
+      if (dash != NULL) {
+        *dash = '\0';
+      }
+
+      collect_libraries(repo, *dep, libraries);
+    }
+
+    g_strfreev(dependencies);
+  }
+  G_UNLOCK(repository);
+
+  if (libraries->len == 0) {
+    g_ptr_array_free(libraries, TRUE);
+    namespace_load_complete(load);
+    return;
+  }
+
+  g_atomic_int_set(&load->pending_libraries, libraries->len);
+
+  for (guint i = 0; i < libraries->len; i++) {
+    LoaderJob *job = g_new0(LoaderJob, 1);
+    job->load    = load;
+    job->library = (char *)g_ptr_array_index(libraries, i);
+    g_thread_pool_push(get_loader_pool(), job, NULL);
+  }
+
+  g_ptr_array_free(libraries, FALSE);
+}
+
+/**
+ * Accepts "gi:Name?version=X.Y", "Name?version=X.Y" or "Name" plus an optional version argument
+ */
+static bool parse_specifier(const char *specifier, char **ns, char **version) {
+  if (g_str_has_prefix(specifier, "gi:")) {
+    specifier += 3;
+  }
+
+  const char *query = strchr(specifier, '?');
+
+  *ns      = query ? g_strndup(specifier, query - specifier) : g_strdup(specifier);
+  *version = NULL;
+
+  if (query != NULL) {
+    char **params = g_strsplit(query + 1, "&", 0);
+
+    for (char **param = params; *param != NULL; param++) {
+      if (g_str_has_prefix(*param, "version=")) {
+        g_free(*version);
+        *version = g_strdup(*param + strlen("version="));
+      }
+    }
+
+    g_strfreev(params);
+  }
+
+  return **ns != '\0';
+}
+
+JSValue js_gi_require(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  const char *specifier = JS_ToCString(ctx, argv[0]);
+
+  if (specifier == NULL) {
+    return JS_EXCEPTION;
+  }
+
+  char *ns, *version;
+  bool  valid = parse_specifier(specifier, &ns, &version);
+
+  JS_FreeCString(ctx, specifier);
+
+  if (!valid) {
+    g_free(ns);
+    g_free(version);
+    return JS_ThrowTypeError(ctx, "Invalid namespace specifier");
+  }
+
+  if (version == NULL && argc > 1 && JS_IsString(argv[1])) {
+    const char *version_arg = JS_ToCString(ctx, argv[1]);
+    version = g_strdup(version_arg);
+    JS_FreeCString(ctx, version_arg);
+  }
+
+  NamespaceLoad *load = g_new0(NamespaceLoad, 1);
+  JSValue        promise = JS_NewPromiseCapability(ctx, load->resolving_funcs);
+
+  if (JS_IsException(promise)) {
+    g_free(ns);
+    g_free(version);
+    g_free(load);
+    return promise;
+  }
+
+  load->ctx          = ctx;
+  load->main_context = g_main_context_ref_thread_default();
+  load->ns           = ns;
+  load->version      = version;
+
+  TrackPendingPromise(ctx, load->resolving_funcs);
+
+  require_namespace(load);
+
+  return promise;
+}
+
+}
@@ -0,0 +1,46 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * g_irepository_require() on the default repository, serialized with
+ * GI.require and typelib archives loading on other threads
+ */
+GITypelib *RequireNamespace(const char *ns, const char *version, GError **error);
+
+bool LoadTypelibArchive(const char *path, GError **error);
+void LoadDefaultTypelibArchive();
+char *GetArchivedTypelibChecksum(const char *ns);
+
+/**
+ * @returns a NULL terminated array of the infos of a loaded namespace, free with FreeNamespaceInfos()
+ */
+GIBaseInfo **GetNamespaceInfos(const char *ns);
+void FreeNamespaceInfos(GIBaseInfo **infos);
+
+GIEnumInfo *FindErrorDomain(GQuark domain);
+
+JSValue js_gi_require(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
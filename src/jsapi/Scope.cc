@@ -0,0 +1,230 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/ContextData.hh"
+#include "jsapi/Scope.hh"
+#include "jsapi/opaque/ContainerView.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+namespace QJSGir {
+
+/*
+ * GI.scope(fn) runs fn and, once it returns or throws, releases the native
+ * side of every struct, object and container view that GI calls handed over
+ * with ownership meanwhile: owned structs are freed, object references
+ * dropped and containers released, all in one pass. The wrappers themselves
+ * stay valid JS objects, but empty.
+ *
+ * The value fn returns escapes to the enclosing scope, or is left to the GC
+ * at the outermost one; GI.keep(value) exempts a value from the scopes
+ * altogether.
+ *
+ * If fn returns a thenable, e.g. it is async, the release waits until it
+ * settles and GI.scope returns a promise that settles the same way. Only the
+ * results registered before fn first awaited are tracked.
+ */
+
+// Scopes running in any context, so that calls outside of them skip the lookup
+static gint active_scopes = 0;
+
+void ScopeTrack(JSContext *ctx, JSValueConst value) {
+  if (g_atomic_int_get(&active_scopes) == 0 || !JS_IsObject(value)) {
+    return;
+  }
+
+  ContextData *context_data = GetContextData(ctx);
+
+  if (context_data == nullptr || context_data->scope == nullptr) {
+    return;
+  }
+
+  JSValue dup = JS_DupValue(ctx, value);
+  g_array_append_val(context_data->scope->values, dup);
+}
+
+/**
+ * Removes value from scope
+ * @returns the scope's reference to value, or JS_UNDEFINED if it wasn't there
+ */
+static JSValue scope_steal(Scope *scope, JSValueConst value) {
+  for (guint i = 0; i < scope->values->len; i++) {
+    JSValue tracked = g_array_index(scope->values, JSValue, i);
+
+    if (JS_VALUE_GET_PTR(tracked) == JS_VALUE_GET_PTR(value)) {
+      g_array_remove_index_fast(scope->values, i);
+      return tracked;
+    }
+  }
+
+  return JS_UNDEFINED;
+}
+
+static void scope_release(JSContext *ctx, Scope *scope) {
+  for (guint i = 0; i < scope->values->len; i++) {
+    JSValue value = g_array_index(scope->values, JSValue, i);
+
+    JS_ReleaseBoxed(ctx, value) || JS_ReleaseGObject(ctx, value) || JS_ReleaseContainerView(value);
+    JS_FreeValue(ctx, value);
+  }
+
+  g_array_set_size(scope->values, 0);
+}
+
+/**
+ * @returns whether value is a wrapper whose native side was released
+ */
+bool IsReleasedWrapper(JSValueConst value) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)JS_GetOpaque(value, js_gobject_classid);
+
+  if (wrapper != nullptr) {
+    return wrapper->gobject == NULL;
+  }
+
+  Boxed *boxed = (Boxed *)JS_GetOpaque(value, js_boxed_classid);
+
+  return boxed != nullptr && boxed->data == nullptr;
+}
+
+/**
+ * Fulfillment (magic 0) and rejection (magic 1) handler of a scope whose
+ * function returned a thenable. func_data[0] is the array of tracked values,
+ * the settled value escapes and is left to the GC.
+ */
+static JSValue scope_settled(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic, JSValue *func_data) {
+  JSValue  values = func_data[0];
+  uint32_t length = 0;
+  JSValue  length_value = JS_GetPropertyStr(ctx, values, "length");
+
+  JS_ToUint32(ctx, &length, length_value);
+  JS_FreeValue(ctx, length_value);
+
+  for (uint32_t i = 0; i < length; i++) {
+    JSValue value = JS_GetPropertyUint32(ctx, values, i);
+
+    if (JS_VALUE_GET_PTR(value) != JS_VALUE_GET_PTR(argv[0])) {
+      JS_ReleaseBoxed(ctx, value) || JS_ReleaseGObject(ctx, value) || JS_ReleaseContainerView(value);
+    }
+
+    JS_FreeValue(ctx, value);
+  }
+
+  JS_SetPropertyStr(ctx, values, "length", JS_NewInt32(ctx, 0));
+
+  return magic ? JS_Throw(ctx, JS_DupValue(ctx, argv[0])) : JS_DupValue(ctx, argv[0]);
+}
+
+/**
+ * Hands the values of scope over to handlers attached to thenable
+ * @returns the promise returned by thenable.then()
+ */
+static JSValue scope_defer(JSContext *ctx, Scope *scope, JSValueConst thenable, JSValueConst then) {
+  JSValue values = JS_NewArray(ctx);
+
+  for (guint i = 0; i < scope->values->len; i++) {
+    JS_SetPropertyUint32(ctx, values, i, g_array_index(scope->values, JSValue, i));
+  }
+
+  g_array_set_size(scope->values, 0);
+
+  JSValue handlers[2] = {
+    JS_NewCFunctionData(ctx, scope_settled, 1, 0, 1, &values),
+    JS_NewCFunctionData(ctx, scope_settled, 1, 1, 1, &values),
+  };
+  JSValue promise = JS_Call(ctx, then, thenable, 2, handlers);
+
+  JS_FreeValue(ctx, handlers[0]);
+  JS_FreeValue(ctx, handlers[1]);
+  JS_FreeValue(ctx, values);
+
+  return promise;
+}
+
+/**
+ * GI.scope(fn)
+ */
+JSValue js_gi_scope(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContextData *context_data = GetContextData(ctx);
+
+  if (!JS_IsFunction(ctx, argv[0])) {
+    return JS_ThrowTypeError(ctx, "GI.scope expects a function");
+  }
+
+  if (context_data == nullptr) {
+    return JS_ThrowInternalError(ctx, "GI module is not initialized in this context");
+  }
+
+  Scope scope;
+  scope.parent = context_data->scope;
+  scope.values = g_array_new(FALSE, FALSE, sizeof(JSValue));
+
+  context_data->scope = &scope;
+  g_atomic_int_inc(&active_scopes);
+
+  JSValue result = JS_Call(ctx, argv[0], JS_UNDEFINED, 0, NULL);
+
+  context_data->scope = scope.parent;
+  g_atomic_int_add(&active_scopes, -1);
+
+  JSValue then = JS_IsObject(result) ? JS_GetPropertyStr(ctx, result, "then") : JS_UNDEFINED;
+
+  if (JS_IsException(then)) {
+    JS_FreeValue(ctx, result);
+    result = JS_EXCEPTION;
+  } else if (JS_IsFunction(ctx, then)) {
+    JSValue promise = scope_defer(ctx, &scope, result, then);
+
+    JS_FreeValue(ctx, result);
+    result = promise;
+  } else if (JS_IsObject(result)) {
+    JSValue escaping = scope_steal(&scope, result);
+
+    if (scope.parent != nullptr && JS_IsObject(escaping)) {
+      g_array_append_val(scope.parent->values, escaping);
+    } else {
+      JS_FreeValue(ctx, escaping);
+    }
+  }
+
+  JS_FreeValue(ctx, then);
+  scope_release(ctx, &scope);
+  g_array_free(scope.values, TRUE);
+
+  return result;
+}
+
+/**
+ * GI.keep(value)
+ * @returns value, no longer released by the scopes it was registered with
+ */
+JSValue js_gi_keep(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContextData *context_data = GetContextData(ctx);
+
+  if (context_data != nullptr && JS_IsObject(argv[0])) {
+    for (Scope *scope = context_data->scope; scope != nullptr; scope = scope->parent) {
+      JS_FreeValue(ctx, scope_steal(scope, argv[0]));
+    }
+  }
+
+  return JS_DupValue(ctx, argv[0]);
+}
+
+}
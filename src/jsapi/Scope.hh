@@ -0,0 +1,47 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * A GI.scope(fn) call in progress. Scopes live on the C stack of the call and
+ * nest, each pointing to the enclosing one.
+ */
+struct Scope {
+  Scope * parent;
+
+  // JSValue, strong references to the results registered while fn runs
+  GArray *values;
+};
+
+/**
+ * Registers value, a result whose ownership the call passed to us, with the
+ * innermost scope of ctx. Does nothing outside of GI.scope.
+ */
+void ScopeTrack(JSContext *ctx, JSValueConst value);
+bool IsReleasedWrapper(JSValueConst value);
+
+JSValue js_gi_scope(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+JSValue js_gi_keep(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
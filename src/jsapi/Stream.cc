@@ -0,0 +1,624 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <gio/gio.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "utils/jsutils.hh"
+#include "utils/macros.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/ErrorDomain.hh"
+#include "jsapi/Stream.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+namespace QJSGir {
+
+/*
+ * Chunk buffers come from process-wide pools, one per power of two size
+ * between 4 KiB and 1 MiB. A chunk is handed to JS as an ArrayBuffer over the
+ * pooled memory, which goes back to the pool when the ArrayBuffer is
+ * collected, so a steady stream keeps reusing the same few buffers. Free
+ * buffers are chained through their first bytes.
+ */
+
+#define MIN_CHUNK_SHIFT       12
+#define MAX_CHUNK_SHIFT       20
+#define DEFAULT_CHUNK_SIZE    (64 * 1024)
+#define POOL_CAPACITY         16
+
+struct BufferPool {
+  void *free_list;
+  guint n_free;
+};
+
+static BufferPool buffer_pools[MAX_CHUNK_SHIFT - MIN_CHUNK_SHIFT + 1];
+G_LOCK_DEFINE_STATIC(buffer_pools);
+
+static int get_size_class(int64_t size) {
+  int shift = MIN_CHUNK_SHIFT;
+
+  while (shift < MAX_CHUNK_SHIFT && ((int64_t)1 << shift) < size) {
+    shift++;
+  }
+
+  return shift - MIN_CHUNK_SHIFT;
+}
+
+static inline gsize get_class_size(int size_class) {
+  return (gsize)1 << (size_class + MIN_CHUNK_SHIFT);
+}
+
+static void *pool_acquire(int size_class) {
+  BufferPool *pool = &buffer_pools[size_class];
+
+  G_LOCK(buffer_pools);
+  void *buffer = pool->free_list;
+  if (buffer != NULL) {
+    pool->free_list = *(void **)buffer;
+    pool->n_free--;
+  }
+  G_UNLOCK(buffer_pools);
+
+  return buffer != NULL ? buffer : g_malloc(get_class_size(size_class));
+}
+
+static void pool_release(int size_class, void *buffer) {
+  BufferPool *pool = &buffer_pools[size_class];
+
+  G_LOCK(buffer_pools);
+  if (pool->n_free < POOL_CAPACITY) {
+    *(void **)buffer = pool->free_list;
+    pool->free_list  = buffer;
+    pool->n_free++;
+    buffer = NULL;
+  }
+  G_UNLOCK(buffer_pools);
+
+  g_free(buffer);
+}
+
+static void js_pool_buffer_free(JSRuntime *rt, void *opaque, void *ptr) {
+  // Detaching already released the buffer, the finalizer then passes NULL
+  if (ptr == NULL) {
+    return;
+  }
+
+  pool_release(GPOINTER_TO_INT(opaque), ptr);
+}
+
+static JSValue make_iterator_result(JSContext *ctx, JSValue value, bool done) {
+  JSValue result = JS_NewObject(ctx);
+
+  JS_DefinePropertyValueStr(ctx, result, "value", value, JS_PROP_C_W_E);
+  JS_DefinePropertyValueStr(ctx, result, "done", JS_NewBool(ctx, done), JS_PROP_C_W_E);
+  return result;
+}
+
+static JSValue resolved_promise(JSContext *ctx, JSValue value) {
+  JSValue resolving_funcs[2];
+  JSValue promise = JS_NewPromiseCapability(ctx, resolving_funcs);
+
+  if (JS_IsException(promise)) {
+    JS_FreeValue(ctx, value);
+    return promise;
+  }
+
+  JS_SettlePromise(ctx, resolving_funcs, false, value);
+  return promise;
+}
+
+/*
+ * GInputStream
+ */
+
+static JSClassID js_input_stream_iterator_classid;
+
+struct PendingRead {
+  JSValue resolving_funcs[2];
+};
+
+/**
+ * At most one read is in flight; next() calls made meanwhile wait in pending,
+ * in order. The iterator holds a reference to itself while a read is in flight.
+ * If the context goes away meanwhile, the read is cancelled and ctx cleared;
+ * whichever of read_ready and the finalizer comes last frees the iterator.
+ */
+struct InputStreamIterator {
+  JSContext *   ctx;
+  GInputStream *stream;
+  int           size_class;
+
+  GArray *      pending;
+  void *        buffer;
+  JSValue       self;
+  GCancellable *cancellable;
+  bool          reading;
+  bool          done;
+  bool          finalized;
+};
+
+static void start_read(InputStreamIterator *iter);
+
+static void input_stream_iterator_free(gpointer data) {
+  InputStreamIterator *iter = (InputStreamIterator *)data;
+
+  g_array_unref(iter->pending);
+  g_object_unref(iter->cancellable);
+  g_object_unref(iter->stream);
+  delete iter;
+}
+
+static void free_pending_reads(JSRuntime *rt, InputStreamIterator *iter) {
+  for (guint i = 0; i < iter->pending->len; i++) {
+    PendingRead *pending = &g_array_index(iter->pending, PendingRead, i);
+    JS_FreeValueRT(rt, pending->resolving_funcs[0]);
+    JS_FreeValueRT(rt, pending->resolving_funcs[1]);
+  }
+
+  g_array_set_size(iter->pending, 0);
+}
+
+/**
+ * The context is going away with a read in flight
+ */
+static void cancel_read(JSRuntime *rt, gpointer operation) {
+  InputStreamIterator *iter = (InputStreamIterator *)operation;
+  JSValue              self = iter->self;
+
+  free_pending_reads(rt, iter);
+  g_cancellable_cancel(iter->cancellable);
+
+  iter->ctx  = NULL;
+  iter->self = JS_UNDEFINED;
+  JS_FreeValueRT(rt, self);
+}
+
+static void finish_pending_reads(InputStreamIterator *iter) {
+  for (guint i = 0; i < iter->pending->len; i++) {
+    PendingRead *pending = &g_array_index(iter->pending, PendingRead, i);
+    JS_SettlePromise(iter->ctx, pending->resolving_funcs, false, make_iterator_result(iter->ctx, JS_UNDEFINED, true));
+  }
+
+  g_array_set_size(iter->pending, 0);
+}
+
+static void read_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+  InputStreamIterator *iter   = (InputStreamIterator *)user_data;
+  GError *             error  = NULL;
+  gssize               n_read = g_input_stream_read_finish(iter->stream, result, &error);
+  void *               buffer = iter->buffer;
+  JSContext *          ctx    = iter->ctx;
+
+  iter->buffer  = NULL;
+  iter->reading = false;
+
+  // The context went away, there is nobody left to deliver to
+  if (ctx == NULL) {
+    pool_release(iter->size_class, buffer);
+    g_clear_error(&error);
+
+    if (iter->finalized) {
+      input_stream_iterator_free(iter);
+    }
+    return;
+  }
+
+  if (iter->done || iter->pending->len == 0) {
+    // return() was called while reading
+    pool_release(iter->size_class, buffer);
+  } else {
+    PendingRead pending = g_array_index(iter->pending, PendingRead, 0);
+    g_array_remove_index(iter->pending, 0);
+
+    if (n_read > 0) {
+      JSValue chunk = JS_NewArrayBuffer(ctx, (uint8_t *)buffer, n_read, js_pool_buffer_free,
+                                        GINT_TO_POINTER(iter->size_class), FALSE);
+      JS_SettlePromise(ctx, pending.resolving_funcs, false, make_iterator_result(ctx, chunk, false));
+    } else {
+      pool_release(iter->size_class, buffer);
+      iter->done = true;
+
+      if (n_read < 0) {
+        JS_SettlePromise(ctx, pending.resolving_funcs, true, JS_NewGError(ctx, error));
+      } else {
+        JS_SettlePromise(ctx, pending.resolving_funcs, false, make_iterator_result(ctx, JS_UNDEFINED, true));
+      }
+    }
+  }
+
+  g_clear_error(&error);
+
+  if (iter->done) {
+    finish_pending_reads(iter);
+  }
+
+  if (iter->pending->len > 0) {
+    start_read(iter);
+    return;
+  }
+
+  UntrackPendingOperation(ctx, iter);
+
+  // May finalize the iterator
+  JSValue self = iter->self;
+  iter->self = JS_UNDEFINED;
+  JS_FreeValue(ctx, self);
+}
+
+/**
+ * iter->self must be held by the caller
+ */
+static void start_read(InputStreamIterator *iter) {
+  iter->buffer  = pool_acquire(iter->size_class);
+  iter->reading = true;
+
+  g_input_stream_read_async(iter->stream, iter->buffer, get_class_size(iter->size_class),
+                            G_PRIORITY_DEFAULT, iter->cancellable, read_ready, iter);
+}
+
+static void js_input_stream_iterator_finalizer(JSRuntime *rt, JSValue val) {
+  InputStreamIterator *iter = (InputStreamIterator *)JS_GetOpaque(val, js_input_stream_iterator_classid);
+
+  free_pending_reads(rt, iter);
+
+  // Only a read cancelled with the context is still in flight, read_ready frees the iterator
+  if (iter->reading) {
+    iter->finalized = true;
+    return;
+  }
+
+  DeferRelease(rt, input_stream_iterator_free, iter);
+}
+
+static JSValue js_input_stream_iterator_next(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  InputStreamIterator *iter = (InputStreamIterator *)JS_GetOpaque2(ctx, this_val, js_input_stream_iterator_classid);
+
+  if (iter == nullptr) {
+    return JS_EXCEPTION;
+  }
+
+  if (iter->done) {
+    return resolved_promise(ctx, make_iterator_result(ctx, JS_UNDEFINED, true));
+  }
+
+  PendingRead pending;
+  JSValue     promise = JS_NewPromiseCapability(ctx, pending.resolving_funcs);
+
+  if (JS_IsException(promise)) {
+    return promise;
+  }
+
+  g_array_append_val(iter->pending, pending);
+
+  if (!iter->reading) {
+    iter->self = JS_DupValue(ctx, this_val);
+    TrackPendingOperation(ctx, iter, cancel_read);
+    start_read(iter);
+  }
+
+  return promise;
+}
+
+/**
+ * Called when a for await loop exits early; the stream itself is left open
+ */
+static JSValue js_input_stream_iterator_return(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  InputStreamIterator *iter = (InputStreamIterator *)JS_GetOpaque2(ctx, this_val, js_input_stream_iterator_classid);
+
+  if (iter == nullptr) {
+    return JS_EXCEPTION;
+  }
+
+  iter->done = true;
+  finish_pending_reads(iter);
+
+  return resolved_promise(ctx, make_iterator_result(ctx, JS_UNDEFINED, true));
+}
+
+static JSValue js_return_this(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  return JS_DupValue(ctx, this_val);
+}
+
+static JSClassDef js_input_stream_iterator_class = {
+  "InputStreamIterator",
+  .finalizer = js_input_stream_iterator_finalizer,
+};
+
+static const JSCFunctionListEntry js_input_stream_iterator_proto_funcs[] = {
+  JS_CFUNC_DEF("next", 0, js_input_stream_iterator_next),
+  JS_CFUNC_DEF("return", 0, js_input_stream_iterator_return),
+  JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_return_this),
+};
+
+static void js_setup_input_stream_iterator(JSContext *ctx) {
+  JS_NewClassID(&js_input_stream_iterator_classid);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, js_input_stream_iterator_classid)) {
+    JS_NewClass(rt, js_input_stream_iterator_classid, &js_input_stream_iterator_class);
+  }
+
+  JSValue proto = JS_GetClassProto(ctx, js_input_stream_iterator_classid);
+
+  if (JS_IsNull(proto) || JS_IsUndefined(proto)) {
+    proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, proto, js_input_stream_iterator_proto_funcs, countof(js_input_stream_iterator_proto_funcs));
+    JS_SetClassProto(ctx, js_input_stream_iterator_classid, proto);
+  } else {
+    JS_FreeValue(ctx, proto);
+  }
+}
+
+/**
+ * stream.chunks(chunkSize = 65536), also used for stream[Symbol.asyncIterator]()
+ */
+static JSValue js_input_stream_chunks(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  GObject *stream     = JS_GetGObject(this_val);
+  int64_t  chunk_size = DEFAULT_CHUNK_SIZE;
+
+  if (stream == NULL || !g_type_is_a(G_OBJECT_TYPE(stream), G_TYPE_INPUT_STREAM)) {
+    return JS_ThrowTypeError(ctx, "Expected a GInputStream");
+  }
+
+  if (argc > 0 && !JS_IsUndefined(argv[0]) && JS_ToInt64(ctx, &chunk_size, argv[0]) < 0) {
+    return JS_EXCEPTION;
+  }
+
+  js_setup_input_stream_iterator(ctx);
+
+  JSValue obj = JS_NewObjectClass(ctx, js_input_stream_iterator_classid);
+
+  if (JS_IsException(obj)) {
+    return obj;
+  }
+
+  InputStreamIterator *iter = new InputStreamIterator();
+  iter->ctx         = ctx;
+  iter->stream      = G_INPUT_STREAM(g_object_ref(stream));
+  iter->size_class  = get_size_class(chunk_size);
+  iter->pending     = g_array_new(FALSE, FALSE, sizeof(PendingRead));
+  iter->buffer      = NULL;
+  iter->self        = JS_UNDEFINED;
+  iter->cancellable = g_cancellable_new();
+  iter->reading     = false;
+  iter->done        = false;
+  iter->finalized   = false;
+
+  JS_SetOpaque(obj, iter);
+  return obj;
+}
+
+/*
+ * GOutputStream
+ *
+ * write() passes the memory of the given ArrayBuffer or view straight to
+ * g_output_stream_write_all_async, keeping the buffer alive until the write
+ * is done. GIO allows one operation per stream at a time, so writes are
+ * queued per stream; each promise settles when its bytes have been written,
+ * which is what throttles a producer awaiting its writes.
+ *
+ * If the context goes away first, its writes are cancelled and their ctx is
+ * cleared: queued ones are dropped, the one in flight completes unreported.
+ */
+
+struct PendingWrite {
+  JSContext *   ctx;
+  JSValue       resolving_funcs[2];
+  JSValue       buffer;
+  const guint8 *data;
+  gsize         size;
+  GCancellable *cancellable;
+};
+
+struct OutputStreamQueue {
+  GOutputStream *stream;
+  GPtrArray *    pending; // PendingWrite *
+  bool           writing;
+};
+
+static GQuark output_stream_queue_quark() {
+  static GQuark quark = 0;
+
+  if (G_UNLIKELY(quark == 0)) {
+    quark = g_quark_from_static_string("quickjs-gobject-write-queue");
+  }
+
+  return quark;
+}
+
+static void output_stream_queue_free(gpointer data) {
+  OutputStreamQueue *queue = (OutputStreamQueue *)data;
+
+  // Writes keep the stream alive, so the queue is always empty by now
+  g_ptr_array_unref(queue->pending);
+  delete queue;
+}
+
+static void start_write(OutputStreamQueue *queue);
+
+static void pending_write_free(PendingWrite *pending) {
+  g_object_unref(pending->cancellable);
+  delete pending;
+}
+
+static void cancel_write(JSRuntime *rt, gpointer operation) {
+  PendingWrite *pending = (PendingWrite *)operation;
+
+  JS_FreeValueRT(rt, pending->resolving_funcs[0]);
+  JS_FreeValueRT(rt, pending->resolving_funcs[1]);
+  JS_FreeValueRT(rt, pending->buffer);
+  g_cancellable_cancel(pending->cancellable);
+
+  pending->ctx = NULL;
+}
+
+static void write_ready(GObject *source, GAsyncResult *result, gpointer user_data) {
+  OutputStreamQueue *queue         = (OutputStreamQueue *)user_data;
+  GError *           error         = NULL;
+  gsize              bytes_written = 0;
+
+  g_output_stream_write_all_finish(queue->stream, result, &bytes_written, &error);
+
+  PendingWrite *pending = (PendingWrite *)g_ptr_array_remove_index(queue->pending, 0);
+  queue->writing = false;
+
+  if (queue->pending->len > 0) {
+    start_write(queue);
+  }
+
+  if (pending->ctx != NULL) {
+    JSContext *ctx = pending->ctx;
+
+    UntrackPendingOperation(ctx, pending);
+
+    if (error != NULL) {
+      JS_SettlePromise(ctx, pending->resolving_funcs, true, JS_NewGError(ctx, error));
+    } else {
+      JS_SettlePromise(ctx, pending->resolving_funcs, false, JS_NewInt64(ctx, bytes_written));
+    }
+
+    JS_FreeValue(ctx, pending->buffer);
+  }
+
+  pending_write_free(pending);
+  g_clear_error(&error);
+  g_object_unref(source);
+}
+
+static void start_write(OutputStreamQueue *queue) {
+  // Cancelled writes no longer have a buffer to write from
+  while (queue->pending->len > 0 && ((PendingWrite *)g_ptr_array_index(queue->pending, 0))->ctx == NULL) {
+    pending_write_free((PendingWrite *)g_ptr_array_remove_index(queue->pending, 0));
+  }
+
+  if (queue->pending->len == 0) {
+    return;
+  }
+
+  PendingWrite *pending = (PendingWrite *)g_ptr_array_index(queue->pending, 0);
+
+  queue->writing = true;
+
+  g_output_stream_write_all_async((GOutputStream *)g_object_ref(queue->stream), pending->data, pending->size,
+                                  G_PRIORITY_DEFAULT, pending->cancellable, write_ready, queue);
+}
+
+static bool get_buffer_data(JSContext *ctx, JSValueConst value, const guint8 **data, gsize *size) {
+  size_t   buffer_size;
+  uint8_t *buffer_data = JS_GetArrayBuffer(ctx, &buffer_size, value);
+
+  if (buffer_data != NULL) {
+    *data = buffer_data;
+    *size = buffer_size;
+    return true;
+  }
+
+  // Not an ArrayBuffer, try a view
+  JS_FreeValue(ctx, JS_GetException(ctx));
+
+  size_t  offset, byte_length, bytes_per_element;
+  JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byte_length, &bytes_per_element);
+
+  if (JS_IsException(buffer)) {
+    return false;
+  }
+
+  buffer_data = JS_GetArrayBuffer(ctx, &buffer_size, buffer);
+  JS_FreeValue(ctx, buffer);
+
+  if (buffer_data == NULL) {
+    return false;
+  }
+
+  *data = buffer_data + offset;
+  *size = byte_length;
+  return true;
+}
+
+/**
+ * stream.write(arrayBufferOrView) -> Promise<bytesWritten>
+ * The buffer must not be detached or resized until the promise settles.
+ */
+static JSValue js_output_stream_write(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  GObject *stream = JS_GetGObject(this_val);
+
+  if (stream == NULL || !g_type_is_a(G_OBJECT_TYPE(stream), G_TYPE_OUTPUT_STREAM)) {
+    return JS_ThrowTypeError(ctx, "Expected a GOutputStream");
+  }
+
+  const guint8 *data;
+  gsize         size;
+
+  if (!get_buffer_data(ctx, argv[0], &data, &size)) {
+    return JS_ThrowTypeError(ctx, "Expected an ArrayBuffer or a view on one");
+  }
+
+  PendingWrite *pending = new PendingWrite();
+  JSValue       promise = JS_NewPromiseCapability(ctx, pending->resolving_funcs);
+
+  if (JS_IsException(promise)) {
+    delete pending;
+    return promise;
+  }
+
+  pending->ctx         = ctx;
+  pending->buffer      = JS_DupValue(ctx, argv[0]);
+  pending->data        = data;
+  pending->size        = size;
+  pending->cancellable = g_cancellable_new();
+
+  OutputStreamQueue *queue = (OutputStreamQueue *)g_object_get_qdata(stream, output_stream_queue_quark());
+
+  if (queue == nullptr) {
+    queue          = new OutputStreamQueue();
+    queue->stream  = G_OUTPUT_STREAM(stream);
+    queue->pending = g_ptr_array_new();
+    queue->writing = false;
+    g_object_set_qdata_full(stream, output_stream_queue_quark(), queue, output_stream_queue_free);
+  }
+
+  g_ptr_array_add(queue->pending, pending);
+  TrackPendingOperation(ctx, pending, cancel_write);
+
+  if (!queue->writing) {
+    start_write(queue);
+  }
+
+  return promise;
+}
+
+static const JSCFunctionListEntry js_input_stream_proto_funcs[] = {
+  JS_CFUNC_DEF("chunks", 0, js_input_stream_chunks),
+  JS_CFUNC_DEF("[Symbol.asyncIterator]", 0, js_input_stream_chunks),
+};
+
+static const JSCFunctionListEntry js_output_stream_proto_funcs[] = {
+  JS_CFUNC_DEF("write", 1, js_output_stream_write),
+};
+
+void JS_DefineStreamMethods(JSContext *ctx, JSValue proto, GType gtype) {
+  if (gtype == G_TYPE_INPUT_STREAM) {
+    JS_SetPropertyFunctionList(ctx, proto, js_input_stream_proto_funcs, countof(js_input_stream_proto_funcs));
+  } else if (gtype == G_TYPE_OUTPUT_STREAM) {
+    JS_SetPropertyFunctionList(ctx, proto, js_output_stream_proto_funcs, countof(js_output_stream_proto_funcs));
+  }
+}
+
+}
@@ -0,0 +1,225 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/MemoryPressure.hh"
+#include "jsapi/Transfer.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+
+namespace QJSGir {
+
+/*
+ * GI.transfer(value) detaches a struct or an ArrayBuffer from its runtime and
+ * returns a process-wide id; GI.receive(id) in any runtime of the process
+ * wraps the same memory again. Memory the sender owns changes hands in O(1);
+ * only memory it merely borrows, or buffers QuickJS allocated itself, is
+ * copied.
+ */
+
+enum class TransferKind {
+  BOXED, BUFFER
+};
+
+struct Transfer {
+  TransferKind   kind;
+  GIBaseInfo *   info;     // BOXED
+  void *         data;
+  gsize          size;     // BUFFER
+  GDestroyNotify destroy;  // BUFFER
+};
+
+// id -> Transfer *, waiting to be received
+static GHashTable *transfers        = NULL;
+static gint64      next_transfer_id = 1;
+G_LOCK_DEFINE_STATIC(transfers);
+
+/**
+ * Buffers made by JS_NewAdoptedArrayBuffer. QuickJS doesn't let us steal an
+ * ArrayBuffer's memory, so the free function of a stolen one does nothing.
+ */
+struct AdoptedBuffer {
+  void *         data;
+  gsize          size;
+  GDestroyNotify destroy;
+  bool           stolen;
+};
+
+// data -> AdoptedBuffer *
+static GHashTable *adopted_buffers = NULL;
+G_LOCK_DEFINE_STATIC(adopted_buffers);
+
+/**
+ * Detaching calls the free function right away, and the finalizer calls it
+ * again with a NULL pointer; only the first call releases anything.
+ */
+static void js_adopted_buffer_free(JSRuntime *rt, void *opaque, void *ptr) {
+  AdoptedBuffer *buffer = (AdoptedBuffer *)opaque;
+
+  if (ptr == NULL) {
+    return;
+  }
+
+  G_LOCK(adopted_buffers);
+  g_hash_table_remove(adopted_buffers, buffer->data);
+  G_UNLOCK(adopted_buffers);
+
+  // Stolen memory is accounted again by the runtime receiving it
+  RemoveExternalMemory(rt, buffer->size);
+
+  if (!buffer->stolen) {
+    buffer->destroy(buffer->data);
+  }
+
+  g_free(buffer);
+}
+
+JSValue JS_NewAdoptedArrayBuffer(JSContext *ctx, void *data, gsize size, GDestroyNotify destroy) {
+  // Empty buffers have nothing to adopt, and no pointer to tell the calls of the free function apart
+  if (data == NULL) {
+    return JS_NewArrayBufferCopy(ctx, NULL, 0);
+  }
+
+  AdoptedBuffer *buffer = g_new0(AdoptedBuffer, 1);
+  buffer->data    = data;
+  buffer->size    = size;
+  buffer->destroy = destroy;
+
+  G_LOCK(adopted_buffers);
+  if (adopted_buffers == NULL) {
+    adopted_buffers = g_hash_table_new(g_direct_hash, g_direct_equal);
+  }
+  g_hash_table_insert(adopted_buffers, data, buffer);
+  G_UNLOCK(adopted_buffers);
+
+  JSValue array_buffer = JS_NewArrayBuffer(ctx, (uint8_t *)data, size, js_adopted_buffer_free, buffer, FALSE);
+
+  if (!JS_IsException(array_buffer)) {
+    AddExternalMemory(ctx, size);
+  }
+
+  return array_buffer;
+}
+
+/**
+ * Takes the memory of an ArrayBuffer, detaching it
+ * @returns false if value isn't an ArrayBuffer
+ */
+static bool detach_buffer(JSContext *ctx, JSValueConst value, Transfer *transfer) {
+  size_t   size;
+  uint8_t *data = JS_GetArrayBuffer(ctx, &size, value);
+
+  if (data == NULL) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return false;
+  }
+
+  G_LOCK(adopted_buffers);
+  AdoptedBuffer *buffer = adopted_buffers ? (AdoptedBuffer *)g_hash_table_lookup(adopted_buffers, data) : nullptr;
+  if (buffer != nullptr) {
+    buffer->stolen = true;
+  }
+  G_UNLOCK(adopted_buffers);
+
+  transfer->kind = TransferKind::BUFFER;
+  transfer->size = size;
+
+  if (buffer != nullptr) {
+    transfer->data    = data;
+    transfer->destroy = buffer->destroy;
+  } else {
+    transfer->data    = g_memdup2(data, size);
+    transfer->destroy = g_free;
+  }
+
+  JS_DetachArrayBuffer(ctx, value);
+  return true;
+}
+
+/**
+ * GI.transfer(value)
+ * @returns the id to pass to GI.receive() in the receiving runtime
+ */
+JSValue js_gi_transfer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  Transfer transfer = {};
+
+  if (JS_GetOpaque(argv[0], js_boxed_classid) != nullptr) {
+    transfer.kind = TransferKind::BOXED;
+    transfer.data = JS_DetachBoxed(ctx, argv[0], &transfer.info);
+
+    if (transfer.data == nullptr) {
+      return JS_EXCEPTION;
+    }
+  } else if (!detach_buffer(ctx, argv[0], &transfer)) {
+    return JS_ThrowTypeError(ctx, "Only structs and ArrayBuffers can be transferred");
+  }
+
+  G_LOCK(transfers);
+
+  if (transfers == NULL) {
+    transfers = g_hash_table_new_full(g_int64_hash, g_int64_equal, g_free, NULL);
+  }
+
+  gint64 *id = g_new(gint64, 1);
+  *id        = next_transfer_id++;
+  g_hash_table_insert(transfers, id, g_memdup2(&transfer, sizeof(transfer)));
+
+  G_UNLOCK(transfers);
+
+  return JS_NewInt64(ctx, *id);
+}
+
+/**
+ * GI.receive(id)
+ * Wraps transferred memory in this runtime; each id can be received once.
+ */
+JSValue js_gi_receive(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  int64_t id;
+
+  if (JS_ToInt64(ctx, &id, argv[0])) {
+    return JS_EXCEPTION;
+  }
+
+  G_LOCK(transfers);
+
+  Transfer *transfer = transfers ? (Transfer *)g_hash_table_lookup(transfers, &id) : nullptr;
+  if (transfer != nullptr) {
+    g_hash_table_remove(transfers, &id);
+  }
+
+  G_UNLOCK(transfers);
+
+  if (transfer == nullptr) {
+    return JS_ThrowRangeError(ctx, "No pending transfer with id %lld", (long long)id);
+  }
+
+  JSValue result;
+
+  if (transfer->kind == TransferKind::BOXED) {
+    result = JS_MakeOpaqueBoxed(ctx, transfer->info, transfer->data, true);
+    g_base_info_unref(transfer->info);
+  } else {
+    result = JS_NewAdoptedArrayBuffer(ctx, transfer->data, transfer->size, transfer->destroy);
+  }
+
+  g_free(transfer);
+  return result;
+}
+
+}
@@ -0,0 +1,35 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * An ArrayBuffer owning data, released with destroy. Unlike other buffers,
+ * its memory can be handed to another runtime without copying.
+ */
+JSValue JS_NewAdoptedArrayBuffer(JSContext *ctx, void *data, gsize size, GDestroyNotify destroy);
+
+JSValue js_gi_transfer(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+JSValue js_gi_receive(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
@@ -0,0 +1,432 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girffi.h>
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "jsapi/VectorCall.hh"
+#include "jsapi/opaque/FunctionInfo.hh"
+#include "jsapi/opaque/JSFunctionInfo.hh"
+
+namespace QJSGir {
+
+enum class ColumnType {
+  INT8, UINT8, INT16, UINT16, INT32, UINT32, BIG_INT64, BIG_UINT64, FLOAT32, FLOAT64
+};
+
+struct Column {
+  ColumnType type;
+  uint8_t *  data;
+  size_t     length;
+};
+
+union ScalarReturnValue {
+  ffi_arg  v_ffi_arg;
+  ffi_sarg v_ffi_sarg;
+  gfloat   v_float;
+  gdouble  v_double;
+  gint64   v_int64;
+  guint64  v_uint64;
+};
+
+static const struct {
+  const char *name;
+  ColumnType  type;
+  size_t      size;
+} column_types[] = {
+  { "Int8Array",         ColumnType::INT8,       sizeof(gint8)   },
+  { "Uint8Array",        ColumnType::UINT8,      sizeof(guint8)  },
+  { "Uint8ClampedArray", ColumnType::UINT8,      sizeof(guint8)  },
+  { "Int16Array",        ColumnType::INT16,      sizeof(gint16)  },
+  { "Uint16Array",       ColumnType::UINT16,     sizeof(guint16) },
+  { "Int32Array",        ColumnType::INT32,      sizeof(gint32)  },
+  { "Uint32Array",       ColumnType::UINT32,     sizeof(guint32) },
+  { "BigInt64Array",     ColumnType::BIG_INT64,  sizeof(gint64)  },
+  { "BigUint64Array",    ColumnType::BIG_UINT64, sizeof(guint64) },
+  { "Float32Array",      ColumnType::FLOAT32,    sizeof(gfloat)  },
+  { "Float64Array",      ColumnType::FLOAT64,    sizeof(gdouble) },
+};
+
+static bool is_scalar_tag(GITypeTag tag) {
+  return (tag >= GI_TYPE_TAG_BOOLEAN && tag <= GI_TYPE_TAG_DOUBLE) || tag == GI_TYPE_TAG_UNICHAR;
+}
+
+/**
+ * @returns the tag the value is passed as, or GI_TYPE_TAG_VOID if it isn't a scalar
+ */
+static GITypeTag get_scalar_tag(GITypeInfo *type_info) {
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  if (g_type_info_is_pointer(type_info)) {
+    return GI_TYPE_TAG_VOID;
+  }
+
+  if (is_scalar_tag(tag)) {
+    return tag;
+  }
+
+  if (tag == GI_TYPE_TAG_INTERFACE) {
+    GIBaseInfo *interface_info = g_type_info_get_interface(type_info);
+    GIInfoType  interface_type = g_base_info_get_type(interface_info);
+
+    if (interface_type == GI_INFO_TYPE_ENUM || interface_type == GI_INFO_TYPE_FLAGS) {
+      tag = g_enum_info_get_storage_type(interface_info);
+    }
+
+    g_base_info_unref(interface_info);
+    return is_scalar_tag(tag) ? tag : GI_TYPE_TAG_VOID;
+  }
+
+  return GI_TYPE_TAG_VOID;
+}
+
+/**
+ * @returns the TypedArray type holding values of tag, false if there is none
+ */
+static bool get_typed_array_type(GITypeTag tag, JSTypedArrayEnum *type) {
+  switch (tag) {
+  case GI_TYPE_TAG_INT8:    *type = JS_TYPED_ARRAY_INT8;       return true;
+  case GI_TYPE_TAG_BOOLEAN:
+  case GI_TYPE_TAG_UINT8:   *type = JS_TYPED_ARRAY_UINT8;      return true;
+  case GI_TYPE_TAG_INT16:   *type = JS_TYPED_ARRAY_INT16;      return true;
+  case GI_TYPE_TAG_UINT16:  *type = JS_TYPED_ARRAY_UINT16;     return true;
+  case GI_TYPE_TAG_INT32:   *type = JS_TYPED_ARRAY_INT32;      return true;
+  case GI_TYPE_TAG_UINT32:
+  case GI_TYPE_TAG_UNICHAR: *type = JS_TYPED_ARRAY_UINT32;     return true;
+  case GI_TYPE_TAG_INT64:   *type = JS_TYPED_ARRAY_BIG_INT64;  return true;
+  case GI_TYPE_TAG_UINT64:  *type = JS_TYPED_ARRAY_BIG_UINT64; return true;
+  case GI_TYPE_TAG_FLOAT:   *type = JS_TYPED_ARRAY_FLOAT32;    return true;
+  case GI_TYPE_TAG_DOUBLE:  *type = JS_TYPED_ARRAY_FLOAT64;    return true;
+  default:                  return false;
+  }
+}
+
+static bool get_column(JSContext *ctx, JSValueConst value, Column *column) {
+  size_t offset, byte_length, bytes_per_element;
+  size_t buffer_size;
+
+  JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byte_length, &bytes_per_element);
+
+  if (JS_IsException(buffer)) {
+    return false;
+  }
+
+  uint8_t *data = JS_GetArrayBuffer(ctx, &buffer_size, buffer);
+  JS_FreeValue(ctx, buffer);
+
+  if (data == NULL) {
+    return false;
+  }
+
+  JSValue     ctor      = JS_GetPropertyStr(ctx, value, "constructor");
+  JSValue     ctor_name = JS_GetPropertyStr(ctx, ctor, "name");
+  const char *name      = JS_ToCString(ctx, ctor_name);
+  bool        found     = false;
+
+  // The constructor is writable from JS, so the element size must agree with the buffer
+  for (size_t i = 0; name != NULL && i < G_N_ELEMENTS(column_types); i++) {
+    if (strcmp(name, column_types[i].name) == 0 && column_types[i].size == bytes_per_element) {
+      column->type = column_types[i].type;
+      found        = true;
+      break;
+    }
+  }
+
+  JS_FreeCString(ctx, name);
+  JS_FreeValue(ctx, ctor_name);
+  JS_FreeValue(ctx, ctor);
+
+  if (!found) {
+    JS_ThrowTypeError(ctx, "Unsupported TypedArray column");
+    return false;
+  }
+
+  column->data   = data + offset;
+  column->length = byte_length / bytes_per_element;
+  return true;
+}
+
+static inline double column_double(const Column& column, size_t i) {
+  switch (column.type) {
+  case ColumnType::INT8:       return ((gint8 *)column.data)[i];
+  case ColumnType::UINT8:      return ((guint8 *)column.data)[i];
+  case ColumnType::INT16:      return ((gint16 *)column.data)[i];
+  case ColumnType::UINT16:     return ((guint16 *)column.data)[i];
+  case ColumnType::INT32:      return ((gint32 *)column.data)[i];
+  case ColumnType::UINT32:     return ((guint32 *)column.data)[i];
+  case ColumnType::BIG_INT64:  return (double)((gint64 *)column.data)[i];
+  case ColumnType::BIG_UINT64: return (double)((guint64 *)column.data)[i];
+  case ColumnType::FLOAT32:    return ((gfloat *)column.data)[i];
+  case ColumnType::FLOAT64:
+  default:                     return ((gdouble *)column.data)[i];
+  }
+}
+
+static inline gint64 column_int64(const Column& column, size_t i) {
+  switch (column.type) {
+  case ColumnType::INT8:       return ((gint8 *)column.data)[i];
+  case ColumnType::UINT8:      return ((guint8 *)column.data)[i];
+  case ColumnType::INT16:      return ((gint16 *)column.data)[i];
+  case ColumnType::UINT16:     return ((guint16 *)column.data)[i];
+  case ColumnType::INT32:      return ((gint32 *)column.data)[i];
+  case ColumnType::UINT32:     return ((guint32 *)column.data)[i];
+  case ColumnType::BIG_INT64:  return ((gint64 *)column.data)[i];
+  case ColumnType::BIG_UINT64: return (gint64)((guint64 *)column.data)[i];
+  case ColumnType::FLOAT32:    return (gint64)((gfloat *)column.data)[i];
+  case ColumnType::FLOAT64:
+  default:                     return (gint64)((gdouble *)column.data)[i];
+  }
+}
+
+static inline void load_argument(const Column& column, size_t i, GITypeTag tag, GIArgument *arg) {
+  switch (tag) {
+  case GI_TYPE_TAG_FLOAT:
+    arg->v_float = (gfloat)column_double(column, i);
+    break;
+
+  case GI_TYPE_TAG_DOUBLE:
+    arg->v_double = column_double(column, i);
+    break;
+
+  case GI_TYPE_TAG_BOOLEAN:
+    arg->v_boolean = column_int64(column, i) != 0;
+    break;
+
+  case GI_TYPE_TAG_INT8:
+    arg->v_int8 = (gint8)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_UINT8:
+    arg->v_uint8 = (guint8)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_INT16:
+    arg->v_int16 = (gint16)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_UINT16:
+    arg->v_uint16 = (guint16)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_INT32:
+    arg->v_int32 = (gint32)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_UINT32:
+  case GI_TYPE_TAG_UNICHAR:
+    arg->v_uint32 = (guint32)column_int64(column, i);
+    break;
+
+  case GI_TYPE_TAG_INT64:
+  case GI_TYPE_TAG_UINT64:
+  default:
+    arg->v_int64 = column_int64(column, i);
+    break;
+  }
+}
+
+/**
+ * libffi widens integer returns to ffi_arg, so they are read from there
+ */
+static inline void store_result(uint8_t *out, size_t i, GITypeTag tag, ScalarReturnValue *ret) {
+  switch (tag) {
+  case GI_TYPE_TAG_BOOLEAN:
+    ((guint8 *)out)[i] = ret->v_ffi_sarg != 0;
+    break;
+
+  case GI_TYPE_TAG_INT8:
+    ((gint8 *)out)[i] = (gint8)ret->v_ffi_sarg;
+    break;
+
+  case GI_TYPE_TAG_UINT8:
+    ((guint8 *)out)[i] = (guint8)ret->v_ffi_arg;
+    break;
+
+  case GI_TYPE_TAG_INT16:
+    ((gint16 *)out)[i] = (gint16)ret->v_ffi_sarg;
+    break;
+
+  case GI_TYPE_TAG_UINT16:
+    ((guint16 *)out)[i] = (guint16)ret->v_ffi_arg;
+    break;
+
+  case GI_TYPE_TAG_INT32:
+    ((gint32 *)out)[i] = (gint32)ret->v_ffi_sarg;
+    break;
+
+  case GI_TYPE_TAG_UINT32:
+  case GI_TYPE_TAG_UNICHAR:
+    ((guint32 *)out)[i] = (guint32)ret->v_ffi_arg;
+    break;
+
+  case GI_TYPE_TAG_INT64:
+    ((gint64 *)out)[i] = ret->v_int64;
+    break;
+
+  case GI_TYPE_TAG_UINT64:
+    ((guint64 *)out)[i] = ret->v_uint64;
+    break;
+
+  case GI_TYPE_TAG_FLOAT:
+    ((gfloat *)out)[i] = ret->v_float;
+    break;
+
+  case GI_TYPE_TAG_DOUBLE:
+    ((gdouble *)out)[i] = ret->v_double;
+    break;
+
+  default:
+    break;
+  }
+}
+
+static JSValue new_typed_array(JSContext *ctx, JSTypedArrayEnum type, size_t length) {
+  JSValue arg   = JS_NewInt64(ctx, length);
+  JSValue array = JS_NewTypedArray(ctx, 1, &arg, type);
+
+  JS_FreeValue(ctx, arg);
+  return array;
+}
+
+/**
+ * GI.map(fn, ...columns)
+ * Calls a function with only scalar IN parameters once per row of the given
+ * TypedArrays, in C, and returns the results as a TypedArray (or undefined for
+ * void functions). No JSValue is created per element.
+ */
+JSValue js_gi_map(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  FunctionInfo *func = JS_GetFunctionInfo(argv[0]);
+
+  if (func == nullptr) {
+    return JS_ThrowTypeError(ctx, "GI.map expects a GI function");
+  }
+
+  if (!func->Init(ctx)) {
+    return JS_EXCEPTION;
+  }
+
+  int n_columns = argc - 1;
+
+  if (func->is_method || func->can_throw || n_columns != func->n_callable_args) {
+    return JS_ThrowTypeError(ctx, "%s is not a scalar function of %d arguments",
+                             g_base_info_get_name(func->info), n_columns);
+  }
+
+  GITypeTag *tags = g_newa(GITypeTag, n_columns + 1);
+
+  for (int i = 0; i < n_columns; i++) {
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(func->info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    tags[i] = get_scalar_tag(&type_info);
+
+    if (func->call_parameters[i].direction != GI_DIRECTION_IN || tags[i] == GI_TYPE_TAG_VOID) {
+      return JS_ThrowTypeError(ctx, "Parameter %s of %s is not a scalar",
+                               g_base_info_get_name(&arg_info), g_base_info_get_name(func->info));
+    }
+  }
+
+  GITypeInfo return_type;
+  g_callable_info_load_return_type(func->info, &return_type);
+
+  GITypeTag        return_tag   = get_scalar_tag(&return_type);
+  JSTypedArrayEnum return_array;
+  bool             has_return   = get_typed_array_type(return_tag, &return_array);
+
+  if (!has_return && g_type_info_get_tag(&return_type) != GI_TYPE_TAG_VOID) {
+    return JS_ThrowTypeError(ctx, "%s does not return a scalar", g_base_info_get_name(func->info));
+  }
+
+  Column *columns = g_newa(Column, n_columns + 1);
+  size_t  length  = 0;
+
+  for (int i = 0; i < n_columns; i++) {
+    if (!get_column(ctx, argv[i + 1], &columns[i])) {
+      return JS_EXCEPTION;
+    }
+
+    if (i > 0 && columns[i].length != length) {
+      return JS_ThrowRangeError(ctx, "GI.map columns must have the same length");
+    }
+
+    length = columns[i].length;
+  }
+
+  JSValue  result = JS_UNDEFINED;
+  uint8_t *out    = NULL;
+
+  if (has_return) {
+    size_t  out_offset, out_length, out_bytes_per_element, out_size;
+
+    result = new_typed_array(ctx, return_array, length);
+
+    if (JS_IsException(result)) {
+      return result;
+    }
+
+    JSValue buffer = JS_GetTypedArrayBuffer(ctx, result, &out_offset, &out_length, &out_bytes_per_element);
+
+    if (JS_IsException(buffer)) {
+      JS_FreeValue(ctx, result);
+      return buffer;
+    }
+
+    out = JS_GetArrayBuffer(ctx, &out_size, buffer);
+    JS_FreeValue(ctx, buffer);
+
+    if (out == NULL) {
+      JS_FreeValue(ctx, result);
+      return JS_EXCEPTION;
+    }
+
+    out += out_offset;
+  }
+
+  /*
+   * The loop itself only touches C memory: the argument slots and the ffi
+   * argument pointers are set up once and refilled for every row.
+   */
+
+  GIArgument *        args     = g_newa(GIArgument, n_columns + 1);
+  void **             ffi_args = g_newa(void *, n_columns + 1);
+  ScalarReturnValue   ret;
+  GIFunctionInvoker * invoker  = &func->invoker;
+
+  for (int j = 0; j < n_columns; j++) {
+    ffi_args[j] = &args[j];
+  }
+
+  for (size_t i = 0; i < length; i++) {
+    for (int j = 0; j < n_columns; j++) {
+      load_argument(columns[j], i, tags[j], &args[j]);
+    }
+
+    ffi_call(&invoker->cif, FFI_FN(invoker->native_address), &ret, ffi_args);
+
+    if (out != NULL) {
+      store_result(out, i, return_tag, &ret);
+    }
+  }
+
+  return result;
+}
+
+}
@@ -0,0 +1,606 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/value.hh"
+#include "utils/macros.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/opaque/ContainerView.hh"
+
+namespace QJSGir {
+
+static JSClassID js_list_view_classid;
+static JSClassID js_hash_view_classid;
+static JSClassID js_container_view_iterator_classid;
+
+bool ContainerViewsEnabled(JSContext *ctx) {
+  ContextData *context_data = GetContextData(ctx);
+
+  return context_data != nullptr && context_data->container_views;
+}
+
+void SetContainerViewsEnabled(JSContext *ctx, bool enabled) {
+  ContextData *context_data = GetContextData(ctx);
+
+  if (context_data != nullptr) {
+    context_data->container_views = enabled;
+  }
+}
+
+/**
+ * Views only borrow their elements, so transfer-full returns still go through
+ * the eager conversion where every element is copied and freed. A view must
+ * also own its container: tables returned with transfer none are ref'd, but a
+ * list spine the callee keeps can change or go away at any time, so those
+ * lists are converted eagerly as well.
+ */
+bool CanMakeContainerView(GITypeInfo *type_info, GITransfer transfer) {
+  if (transfer == GI_TRANSFER_EVERYTHING) {
+    return false;
+  }
+
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  if (tag == GI_TYPE_TAG_GLIST || tag == GI_TYPE_TAG_GSLIST) {
+    return transfer == GI_TRANSFER_CONTAINER;
+  }
+
+  return tag == GI_TYPE_TAG_GHASH;
+}
+
+/**
+ * Takes ownership of the type_info ref. Tables returned with transfer none
+ * are ref'd so they outlive the call.
+ */
+ContainerView::ContainerView(GITypeInfo *gi_type_info, gpointer gi_container, GITransfer gi_transfer) {
+  type_info    = gi_type_info;
+  tag          = g_type_info_get_tag(type_info);
+  container    = gi_container;
+  transfer     = gi_transfer;
+  cursor_node  = nullptr;
+  cursor_index = 0;
+
+  if (tag == GI_TYPE_TAG_GHASH) {
+    key_type   = g_type_info_get_param_type(type_info, 0);
+    value_type = g_type_info_get_param_type(type_info, 1);
+
+    if (container != nullptr && transfer == GI_TRANSFER_NOTHING) {
+      g_hash_table_ref((GHashTable *)container);
+    }
+  } else {
+    key_type   = nullptr;
+    value_type = g_type_info_get_param_type(type_info, 0);
+  }
+}
+
+ContainerView::~ContainerView() {
+  ReleaseContainer();
+
+  if (key_type != nullptr) {
+    g_base_info_unref(key_type);
+  }
+
+  g_base_info_unref(value_type);
+  g_base_info_unref(type_info);
+}
+
+/**
+ * Drops the container early, leaving an empty view
+ */
+void ContainerView::ReleaseContainer() {
+  switch (tag) {
+  case GI_TYPE_TAG_GLIST:
+    if (transfer == GI_TRANSFER_CONTAINER) {
+      g_list_free((GList *)container);
+    }
+    break;
+
+  case GI_TYPE_TAG_GSLIST:
+    if (transfer == GI_TRANSFER_CONTAINER) {
+      g_slist_free((GSList *)container);
+    }
+    break;
+
+  case GI_TYPE_TAG_GHASH:
+    if (container != nullptr) {
+      g_hash_table_unref((GHashTable *)container);
+    }
+    break;
+
+  default:
+    break;
+  }
+
+  container   = nullptr;
+  cursor_node = nullptr;
+}
+
+static JSValue jsvalue_from_hash_pointer(JSContext *ctx, GITypeInfo *type_info, gpointer pointer) {
+  GIArgument arg;
+
+  g_type_info_argument_from_hash_pointer(type_info, pointer, &arg);
+  return jsvalue_from_giargument(ctx, type_info, &arg);
+}
+
+/*
+ * GList and GSList both start with the data/next pair, so lists of either kind
+ * are walked as GSList.
+ */
+
+static GSList *list_view_nth(ContainerView *view, guint index) {
+  GSList *node = (GSList *)view->container;
+  guint   i    = 0;
+
+  if (view->cursor_node != nullptr && view->cursor_index <= index) {
+    node = view->cursor_node;
+    i    = view->cursor_index;
+  }
+
+  for (; node != nullptr && i < index; i++) {
+    node = node->next;
+  }
+
+  if (node != nullptr) {
+    view->cursor_node  = node;
+    view->cursor_index = index;
+  }
+
+  return node;
+}
+
+/*
+ * Iterator
+ */
+
+enum class IteratorKind {
+  KEYS, VALUES, ENTRIES
+};
+
+struct ContainerViewIterator {
+  JSValue        view;
+  ContainerView *native;
+  IteratorKind   kind;
+  GSList *       node;
+  GHashTableIter hash_iter;
+};
+
+static void js_container_view_iterator_finalizer(JSRuntime *rt, JSValue val) {
+  auto it = (ContainerViewIterator *)JS_GetOpaque(val, js_container_view_iterator_classid);
+
+  JS_FreeValueRT(rt, it->view);
+  delete it;
+}
+
+static void js_container_view_iterator_mark(JSRuntime *rt, JSValueConst val, JS_MarkFunc *mark_func) {
+  auto it = (ContainerViewIterator *)JS_GetOpaque(val, js_container_view_iterator_classid);
+
+  JS_MarkValue(rt, it->view, mark_func);
+}
+
+static JSValue js_container_view_iterator_next(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int *pdone, int magic) {
+  auto it = (ContainerViewIterator *)JS_GetOpaque2(ctx, this_val, js_container_view_iterator_classid);
+
+  if (!it) {
+    return JS_EXCEPTION;
+  }
+
+  ContainerView *view = it->native;
+
+  if (view->tag != GI_TYPE_TAG_GHASH) {
+    if (view->container == nullptr || it->node == nullptr) {
+      *pdone = TRUE;
+      return JS_UNDEFINED;
+    }
+
+    gpointer data = it->node->data;
+    it->node = it->node->next;
+
+    *pdone = FALSE;
+    return jsvalue_from_hash_pointer(ctx, view->value_type, data);
+  }
+
+  gpointer key, value;
+
+  if (view->container == nullptr || !g_hash_table_iter_next(&it->hash_iter, &key, &value)) {
+    *pdone = TRUE;
+    return JS_UNDEFINED;
+  }
+
+  *pdone = FALSE;
+
+  switch (it->kind) {
+  case IteratorKind::KEYS:
+    return jsvalue_from_hash_pointer(ctx, view->key_type, key);
+
+  case IteratorKind::VALUES:
+    return jsvalue_from_hash_pointer(ctx, view->value_type, value);
+
+  case IteratorKind::ENTRIES:
+  default: {
+    JSValue entry = JS_NewArray(ctx);
+    JS_DefinePropertyValueUint32(ctx, entry, 0, jsvalue_from_hash_pointer(ctx, view->key_type, key), JS_PROP_C_W_E);
+    JS_DefinePropertyValueUint32(ctx, entry, 1, jsvalue_from_hash_pointer(ctx, view->value_type, value), JS_PROP_C_W_E);
+    return entry;
+  }
+  }
+}
+
+static JSValue js_container_view_iterator_self(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  return JS_DupValue(ctx, this_val);
+}
+
+static JSValue js_make_container_view_iterator(JSContext *ctx, JSValueConst view_obj, ContainerView *view, IteratorKind kind) {
+  JSValue it_obj = JS_NewObjectClass(ctx, js_container_view_iterator_classid);
+
+  if (JS_IsException(it_obj)) {
+    return it_obj;
+  }
+
+  auto it = new ContainerViewIterator();
+  it->view   = JS_DupValue(ctx, view_obj);
+  it->native = view;
+  it->kind   = kind;
+  it->node   = nullptr;
+
+  if (view->tag == GI_TYPE_TAG_GHASH) {
+    if (view->container != nullptr) {
+      g_hash_table_iter_init(&it->hash_iter, (GHashTable *)view->container);
+    }
+  } else {
+    it->node = (GSList *)view->container;
+  }
+
+  JS_SetOpaque(it_obj, it);
+  return it_obj;
+}
+
+/*
+ * ListView
+ */
+
+static ContainerView *get_view(JSContext *ctx, JSValueConst this_val, JSClassID class_id) {
+  return (ContainerView *)JS_GetOpaque2(ctx, this_val, class_id);
+}
+
+static JSValue js_list_view_get_length(JSContext *ctx, JSValueConst this_val) {
+  ContainerView *view = get_view(ctx, this_val, js_list_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  return JS_NewUint32(ctx, g_slist_length((GSList *)view->container));
+}
+
+static JSValue js_list_view_at(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_list_view_classid);
+  int32_t        index;
+
+  if (!view || JS_ToInt32(ctx, &index, argv[0])) {
+    return JS_EXCEPTION;
+  }
+
+  if (index < 0) {
+    index += g_slist_length((GSList *)view->container);
+
+    if (index < 0) {
+      return JS_UNDEFINED;
+    }
+  }
+
+  GSList *node = list_view_nth(view, index);
+
+  if (node == nullptr) {
+    return JS_UNDEFINED;
+  }
+
+  return jsvalue_from_hash_pointer(ctx, view->value_type, node->data);
+}
+
+static JSValue js_list_view_to_array(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_list_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  JSValue  array = JS_NewArray(ctx);
+  uint32_t i     = 0;
+
+  for (GSList *node = (GSList *)view->container; node != nullptr; node = node->next) {
+    JS_DefinePropertyValueUint32(ctx, array, i++, jsvalue_from_hash_pointer(ctx, view->value_type, node->data), JS_PROP_C_W_E);
+  }
+
+  return array;
+}
+
+static JSValue js_list_view_values(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_list_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  return js_make_container_view_iterator(ctx, this_val, view, IteratorKind::VALUES);
+}
+
+/*
+ * HashView
+ */
+
+static bool hash_view_lookup(JSContext *ctx, ContainerView *view, JSValueConst key, gpointer *value, bool *found) {
+  GIArgument key_arg;
+
+  if (!jsvalue_to_giargument(ctx, view->key_type, &key_arg, key)) {
+    return false;
+  }
+
+  *found = view->container != nullptr &&
+           g_hash_table_lookup_extended(
+    (GHashTable *)view->container,
+    g_type_info_hash_pointer_from_argument(view->key_type, &key_arg),
+    NULL,
+    value);
+
+  free_giargument(view->key_type, &key_arg, GI_TRANSFER_NOTHING, GI_DIRECTION_IN);
+  return true;
+}
+
+static JSValue js_hash_view_get_size(JSContext *ctx, JSValueConst this_val) {
+  ContainerView *view = get_view(ctx, this_val, js_hash_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  return JS_NewUint32(ctx, view->container ? g_hash_table_size((GHashTable *)view->container) : 0);
+}
+
+static JSValue js_hash_view_get(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_hash_view_classid);
+  gpointer       value;
+  bool           found;
+
+  if (!view || !hash_view_lookup(ctx, view, argv[0], &value, &found)) {
+    return JS_EXCEPTION;
+  }
+
+  return found ? jsvalue_from_hash_pointer(ctx, view->value_type, value) : JS_UNDEFINED;
+}
+
+static JSValue js_hash_view_has(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_hash_view_classid);
+  gpointer       value;
+  bool           found;
+
+  if (!view || !hash_view_lookup(ctx, view, argv[0], &value, &found)) {
+    return JS_EXCEPTION;
+  }
+
+  return JS_NewBool(ctx, found);
+}
+
+static JSValue js_hash_view_iterator(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic) {
+  ContainerView *view = get_view(ctx, this_val, js_hash_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  return js_make_container_view_iterator(ctx, this_val, view, (IteratorKind)magic);
+}
+
+static JSValue js_hash_view_for_each(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  ContainerView *view = get_view(ctx, this_val, js_hash_view_classid);
+
+  if (!view) {
+    return JS_EXCEPTION;
+  }
+
+  if (!JS_IsFunction(ctx, argv[0])) {
+    return JS_ThrowTypeError(ctx, "forEach callback is not a function");
+  }
+
+  if (view->container == nullptr) {
+    return JS_UNDEFINED;
+  }
+
+  GHashTableIter iter;
+  gpointer       key, value;
+
+  g_hash_table_iter_init(&iter, (GHashTable *)view->container);
+
+  while (g_hash_table_iter_next(&iter, &key, &value)) {
+    JSValue args[3] = {
+      jsvalue_from_hash_pointer(ctx, view->value_type, value),
+      jsvalue_from_hash_pointer(ctx, view->key_type, key),
+      this_val,
+    };
+
+    JSValue ret = JS_Call(ctx, argv[0], JS_UNDEFINED, 3, args);
+
+    JS_FreeValue(ctx, args[0]);
+    JS_FreeValue(ctx, args[1]);
+
+    if (JS_IsException(ret)) {
+      return ret;
+    }
+
+    JS_FreeValue(ctx, ret);
+  }
+
+  return JS_UNDEFINED;
+}
+
+/*
+ * Classes
+ */
+
+static void release_container_view(gpointer data) {
+  delete (ContainerView *)data;
+}
+
+static void js_container_view_finalizer(JSRuntime *rt, JSValue val) {
+  JSClassID      class_id = JS_GetOpaque(val, js_list_view_classid) ? js_list_view_classid : js_hash_view_classid;
+  ContainerView *view     = (ContainerView *)JS_GetOpaque(val, class_id);
+
+  // Unreffing a hash table may run its destroy functions, freeing a list spine runs nothing
+  if (view->container != nullptr && view->tag == GI_TYPE_TAG_GHASH) {
+    DeferRelease(rt, release_container_view, view);
+  } else {
+    release_container_view(view);
+  }
+}
+
+static JSClassDef js_list_view_class = {
+  "ListView",
+  .finalizer = js_container_view_finalizer,
+};
+
+static JSClassDef js_hash_view_class = {
+  "HashView",
+  .finalizer = js_container_view_finalizer,
+};
+
+static JSClassDef js_container_view_iterator_class = {
+  "ContainerViewIterator",
+  .finalizer = js_container_view_iterator_finalizer,
+  .gc_mark   = js_container_view_iterator_mark,
+};
+
+static const JSCFunctionListEntry js_list_view_proto_funcs[] = {
+  JS_CGETSET_DEF("length", js_list_view_get_length, NULL),
+  JS_CFUNC_DEF("at", 1, js_list_view_at),
+  JS_CFUNC_DEF("toArray", 0, js_list_view_to_array),
+  JS_CFUNC_DEF("values", 0, js_list_view_values),
+  JS_CFUNC_DEF("[Symbol.iterator]", 0, js_list_view_values),
+  JS_PROP_STRING_DEF("[Symbol.toStringTag]", "ListView", JS_PROP_CONFIGURABLE),
+};
+
+static const JSCFunctionListEntry js_hash_view_proto_funcs[] = {
+  JS_CGETSET_DEF("size", js_hash_view_get_size, NULL),
+  JS_CFUNC_DEF("get", 1, js_hash_view_get),
+  JS_CFUNC_DEF("has", 1, js_hash_view_has),
+  JS_CFUNC_DEF("forEach", 1, js_hash_view_for_each),
+  JS_CFUNC_MAGIC_DEF("keys", 0, js_hash_view_iterator, (int)IteratorKind::KEYS),
+  JS_CFUNC_MAGIC_DEF("values", 0, js_hash_view_iterator, (int)IteratorKind::VALUES),
+  JS_CFUNC_MAGIC_DEF("entries", 0, js_hash_view_iterator, (int)IteratorKind::ENTRIES),
+  JS_CFUNC_MAGIC_DEF("[Symbol.iterator]", 0, js_hash_view_iterator, (int)IteratorKind::ENTRIES),
+  JS_PROP_STRING_DEF("[Symbol.toStringTag]", "HashView", JS_PROP_CONFIGURABLE),
+};
+
+static const JSCFunctionListEntry js_container_view_iterator_proto_funcs[] = {
+  JS_ITERATOR_NEXT_DEF("next", 0, js_container_view_iterator_next, 0),
+  JS_CFUNC_DEF("[Symbol.iterator]", 0, js_container_view_iterator_self),
+};
+
+static void setup_class(
+  JSContext *ctx,
+  JSClassID *class_id,
+  JSClassDef *class_def,
+  const JSCFunctionListEntry *proto_funcs,
+  int n_proto_funcs) {
+  JS_NewClassID(class_id);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, *class_id)) {
+    JS_NewClass(rt, *class_id, class_def);
+  }
+
+  JSValue proto = JS_GetClassProto(ctx, *class_id);
+
+  if (!JS_IsObject(proto)) {
+    JS_FreeValue(ctx, proto);
+    proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, proto, proto_funcs, n_proto_funcs);
+    JS_SetClassProto(ctx, *class_id, proto);
+    return;
+  }
+
+  JS_FreeValue(ctx, proto);
+}
+
+bool js_setup_container_view(JSContext *ctx) {
+  setup_class(ctx, &js_list_view_classid, &js_list_view_class,
+              js_list_view_proto_funcs, countof(js_list_view_proto_funcs));
+  setup_class(ctx, &js_hash_view_classid, &js_hash_view_class,
+              js_hash_view_proto_funcs, countof(js_hash_view_proto_funcs));
+  setup_class(ctx, &js_container_view_iterator_classid, &js_container_view_iterator_class,
+              js_container_view_iterator_proto_funcs, countof(js_container_view_iterator_proto_funcs));
+
+  return true;
+}
+
+/**
+ * Wraps a container returned from a GI call. Takes ownership of type_info.
+ * A NULL GHashTable is returned as null, like the eager conversion does.
+ */
+JSValue JS_MakeContainerView(JSContext *ctx, GITypeInfo *type_info, gpointer container, GITransfer transfer) {
+  GITypeTag tag = g_type_info_get_tag(type_info);
+
+  if (tag == GI_TYPE_TAG_GHASH && container == nullptr) {
+    g_base_info_unref(type_info);
+    return JS_NULL;
+  }
+
+  js_setup_container_view(ctx);
+
+  JSClassID class_id = tag == GI_TYPE_TAG_GHASH ? js_hash_view_classid : js_list_view_classid;
+  JSValue   view_obj = JS_NewObjectClass(ctx, class_id);
+
+  if (JS_IsException(view_obj)) {
+    g_base_info_unref(type_info);
+    return view_obj;
+  }
+
+  JS_SetOpaque(view_obj, new ContainerView(type_info, container, transfer));
+  return view_obj;
+}
+
+/**
+ * Releases the container of a view that owns it
+ * @returns false if value isn't such a view
+ */
+bool JS_ReleaseContainerView(JSValueConst value) {
+  ContainerView *view = (ContainerView *)JS_GetOpaque(value, js_list_view_classid);
+
+  if (view == nullptr) {
+    view = (ContainerView *)JS_GetOpaque(value, js_hash_view_classid);
+  }
+
+  if (view == nullptr || view->container == nullptr || view->transfer == GI_TRANSFER_NOTHING) {
+    return false;
+  }
+
+  view->ReleaseContainer();
+  return true;
+}
+
+/**
+ * GI.setLazyContainers(enabled)
+ * Only affects calls made from this context.
+ */
+JSValue js_gi_set_lazy_containers(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  SetContainerViewsEnabled(ctx, JS_ToBool(ctx, argv[0]));
+  return JS_UNDEFINED;
+}
+
+}
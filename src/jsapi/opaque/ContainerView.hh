@@ -0,0 +1,59 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+namespace QJSGir {
+
+/**
+ * Native side of a lazy view over a GList, GSList or GHashTable returned from
+ * a GI call. Elements are only converted to JS values when they are read, and
+ * the container is released when the view is collected.
+ */
+struct ContainerView {
+  GITypeInfo *type_info;
+  GITypeInfo *key_type;
+  GITypeInfo *value_type;
+  GITypeTag   tag;
+  gpointer    container;
+  GITransfer  transfer;
+
+  // Position of the last at() lookup, so that sequential reads stay O(1)
+  GSList *    cursor_node;
+  guint       cursor_index;
+
+  ContainerView(GITypeInfo *type_info, gpointer container, GITransfer transfer);
+  ~ContainerView();
+
+  void ReleaseContainer();
+};
+
+bool ContainerViewsEnabled(JSContext *ctx);
+void SetContainerViewsEnabled(JSContext *ctx, bool enabled);
+bool CanMakeContainerView(GITypeInfo *type_info, GITransfer transfer);
+
+bool js_setup_container_view(JSContext *ctx);
+JSValue JS_MakeContainerView(JSContext *ctx, GITypeInfo *type_info, gpointer container, GITransfer transfer);
+bool JS_ReleaseContainerView(JSValueConst value);
+
+JSValue js_gi_set_lazy_containers(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv);
+
+}
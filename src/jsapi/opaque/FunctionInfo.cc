@@ -19,16 +19,27 @@
 #include <girepository.h>
 #include <quickjs/quickjs.h>
 
+#include "gi/array_kernels.hh"
 #include "gi/boxed.hh"
+#include "gi/enum.hh"
+#include "gi/type.hh"
 #include "gi/value.hh"
 #include "utils/error.hh"
+#include "jsapi/Callback.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/Scope.hh"
 #include "jsapi/opaque/FunctionInfo.hh"
+#include "jsapi/opaque/ContainerView.hh"
+#include "jsapi/opaque/JSGObject.hh"
 
 static inline bool is_pointer_type(GITypeInfo *type_info);
+static inline bool is_object_type(GITypeInfo *type_info);
+static JSValue jsvalue_from_object(JSContext *ctx, GITypeInfo *type_info, GIArgument *arg);
 static bool should_skip_return(GIBaseInfo *info, GITypeInfo *return_type);
 static inline bool is_direction_out(GIDirection direction);
 static inline bool is_direction_in(GIDirection direction);
 static bool check_is_method(GIBaseInfo *info);
+static void set_length_giargument(GITypeInfo *length_type, GIArgument *arg, long length);
 
 namespace QJSGir {
 
@@ -38,32 +49,85 @@ bool IsDestroyNotify(GIBaseInfo *info) {
 }
 
 /**
- * The constructor just stores the GIBaseInFfo ref. The rest of the
- * initialization is done in FunctionInfo::Init, lazily.
+ * The constructor just stores the GIBaseInfo ref and looks up the heap stats
+ * groups. The rest of the initialization is done in FunctionInfo::Init, lazily.
+ * Functions are grouped by the type they belong to, or by namespace.
  */
 FunctionInfo::FunctionInfo(GIBaseInfo *gi_info) {
   info            = g_base_info_ref(gi_info);
+  ref_count       = 1;
   call_parameters = nullptr;
+  g_mutex_init(&init_mutex);
+
+  GIBaseInfo *container = g_base_info_get_container(info);
+  const char *ns        = g_base_info_get_namespace(info);
+  const char *name      = container ? g_base_info_get_name(container) : NULL;
+  const char *key       = HeapStatsGroupKey(ns, name);
+
+  function_group = HeapStatsGetGroup(HeapKind::FUNCTION, key, name, ns);
+  plan_group     = HeapStatsGetGroup(HeapKind::CALL_PLAN, key, name, ns);
 }
 
 FunctionInfo::~FunctionInfo() {
   g_base_info_unref(info);
+  g_mutex_clear(&init_mutex);
 
   if (call_parameters != nullptr) {
+    TrackHeap(HeapKind::CALL_PLAN, -1);
     g_function_invoker_destroy(&invoker);
     delete[] call_parameters;
   }
 }
 
+FunctionInfo *FunctionInfo::Ref() {
+  g_atomic_int_inc(&ref_count);
+  return this;
+}
+
+void FunctionInfo::Unref() {
+  if (g_atomic_int_dec_and_test(&ref_count)) {
+    delete this;
+  }
+}
+
 /**
- * Initializes the parameters metadata (number, directionality, type) and caches it
+ * Call plans are accounted with the parameters and the ffi argument types
+ */
+void FunctionInfo::TrackHeap(HeapKind kind, int sign) {
+  if (kind == HeapKind::CALL_PLAN) {
+    gint64 bytes = sizeof(FunctionInfo) + n_callable_args * sizeof(Parameter) + n_total_args * sizeof(ffi_type *);
+
+    HeapStatsAdd(plan_group, sign, sign * bytes);
+  } else {
+    HeapStatsAdd(function_group, sign, 0);
+  }
+}
+
+/**
+ * Initializes the parameters metadata (number, directionality, type) and caches it.
+ * Plans are shared between contexts and runtimes, so the first caller builds it
+ * under the lock and everyone else only reads it afterwards.
  */
 bool FunctionInfo::Init(JSContext *ctx) {
-  if (call_parameters != nullptr) {
+  if (g_atomic_pointer_get(&call_parameters) != nullptr) {
     return true;
   }
 
-  g_function_info_prep_invoker(info, &invoker, NULL);
+  g_mutex_lock(&init_mutex);
+  bool success = call_parameters != nullptr || InitParameters(ctx);
+  g_mutex_unlock(&init_mutex);
+
+  return success;
+}
+
+bool FunctionInfo::InitParameters(JSContext *ctx) {
+  GError *error = NULL;
+
+  if (!g_function_info_prep_invoker(info, &invoker, &error)) {
+    JS_ThrowInternalError(ctx, "%s", error->message);
+    g_error_free(error);
+    return false;
+  }
 
   is_method = check_is_method(info);
   can_throw = g_callable_info_can_throw_gerror(info);
@@ -81,7 +145,7 @@ bool FunctionInfo::Init(JSContext *ctx) {
     n_total_args++;
   }
 
-  call_parameters = new Parameter[n_callable_args]();
+  Parameter *parameters = new Parameter[n_callable_args]();
 
   /*
    * Examine load parameter types and count arguments
@@ -97,37 +161,52 @@ bool FunctionInfo::Init(JSContext *ctx) {
     GIDirection direction   = g_arg_info_get_direction(&arg_info);
     GITypeTag   tag         = g_type_info_get_tag(&type_info);
 
-    call_parameters[i].direction = direction;
+    parameters[i].direction = direction;
 
-    if (call_parameters[i].type == ParameterType::SKIP) {
+    if (parameters[i].type == ParameterType::SKIP) {
       continue;
     }
 
     // If there is an array length, this is an array
     int length_i = g_type_info_get_array_length(&type_info);
     if (tag == GI_TYPE_TAG_ARRAY && length_i >= 0) {
-      call_parameters[i].type        = ParameterType::ARRAY;
-      call_parameters[length_i].type = ParameterType::SKIP;
+      parameters[i].type         = ParameterType::ARRAY;
+      parameters[i].array_kernel = GetArrayKernelTag(&type_info);
+      parameters[length_i].type  = ParameterType::SKIP;
 
       // If array length came before, we need to remove it from args count
 
-      if (is_direction_in(call_parameters[length_i].direction) && length_i < i) {
+      if (is_direction_in(parameters[length_i].direction) && length_i < i) {
         n_in_args--;
       }
 
-      if (is_direction_out(call_parameters[length_i].direction) && length_i < i) {
+      if (is_direction_out(parameters[length_i].direction) && length_i < i) {
         n_out_args--;
       }
     } else if (tag == GI_TYPE_TAG_INTERFACE) {
       GIBaseInfo *interface_info = g_type_info_get_interface(&type_info);
       GIInfoType  interface_type = g_base_info_get_type(interface_info);
 
-      if (interface_type == GI_INFO_TYPE_CALLBACK) {
+      if (interface_type == GI_INFO_TYPE_ENUM || interface_type == GI_INFO_TYPE_FLAGS) {
+        if (direction == GI_DIRECTION_IN) {
+          parameters[i].enum_storage = g_enum_info_get_storage_type(interface_info);
+        }
+      } else if ((interface_type == GI_INFO_TYPE_OBJECT || interface_type == GI_INFO_TYPE_INTERFACE) &&
+                 direction == GI_DIRECTION_IN) {
+        GType gtype = g_registered_type_info_get_g_type(interface_info);
+
+        if (g_type_is_a(gtype, G_TYPE_OBJECT) || G_TYPE_IS_INTERFACE(gtype)) {
+          parameters[i].instance_gtype = gtype;
+          parameters[i].instance_depth = GetTargetDepth(gtype);
+        }
+      } else if (interface_type == GI_INFO_TYPE_OBJECT || interface_type == GI_INFO_TYPE_INTERFACE) {
+        parameters[i].is_object = !g_arg_info_is_caller_allocates(&arg_info);
+      } else if (interface_type == GI_INFO_TYPE_CALLBACK) {
         if (IsDestroyNotify(interface_info)) {
           /* Skip GDestroyNotify if they appear before the respective callback */
-          call_parameters[i].type = ParameterType::SKIP;
+          parameters[i].type = ParameterType::SKIP;
         } else {
-          call_parameters[i].type = ParameterType::CALLBACK;
+          parameters[i].type = ParameterType::CALLBACK;
 
           int destroy_i = g_arg_info_get_destroy(&arg_info);
           int closure_i = g_arg_info_get_closure(&arg_info);
@@ -135,31 +214,33 @@ bool FunctionInfo::Init(JSContext *ctx) {
           if (destroy_i >= 0 && closure_i < 0) {
             Throw::UnsupportedCallback(ctx, info);
             g_base_info_unref(interface_info);
+            g_function_invoker_destroy(&invoker);
+            delete[] parameters;
             return false;
           }
 
           if (destroy_i >= 0 && destroy_i < n_callable_args) {
-            call_parameters[destroy_i].type = ParameterType::SKIP;
+            parameters[destroy_i].type = ParameterType::SKIP;
           }
 
           if (closure_i >= 0 && closure_i < n_callable_args) {
-            call_parameters[closure_i].type = ParameterType::SKIP;
+            parameters[closure_i].type = ParameterType::SKIP;
           }
 
           if (destroy_i < i) {
-            if (is_direction_in(call_parameters[destroy_i].direction)) {
+            if (is_direction_in(parameters[destroy_i].direction)) {
               n_in_args--;
             }
-            if (is_direction_out(call_parameters[destroy_i].direction)) {
+            if (is_direction_out(parameters[destroy_i].direction)) {
               n_out_args--;
             }
           }
 
           if (closure_i < i) {
-            if (is_direction_in(call_parameters[closure_i].direction)) {
+            if (is_direction_in(parameters[closure_i].direction)) {
               n_in_args--;
             }
-            if (is_direction_out(call_parameters[closure_i].direction)) {
+            if (is_direction_out(parameters[closure_i].direction)) {
               n_out_args--;
             }
           }
@@ -167,13 +248,15 @@ bool FunctionInfo::Init(JSContext *ctx) {
       }
 
       g_base_info_unref(interface_info);
+    } else if (direction == GI_DIRECTION_IN) {
+      parameters[i].to_number = GetNumberToArgument(&type_info);
     }
 
-    if (is_direction_in(call_parameters[i].direction) && !may_be_null) {
+    if (is_direction_in(parameters[i].direction) && !may_be_null) {
       n_in_args++;
     }
 
-    if (is_direction_out(call_parameters[i].direction)) {
+    if (is_direction_out(parameters[i].direction)) {
       n_out_args++;
     }
   }
@@ -194,6 +277,28 @@ bool FunctionInfo::Init(JSContext *ctx) {
     n_out_args++;
   }
 
+  return_number       = GetNumberFromArgument(&return_type);
+  return_array_kernel = GI_TYPE_TAG_VOID;
+  return_is_object    = is_object_type(&return_type);
+
+  if (g_type_info_get_tag(&return_type) == GI_TYPE_TAG_ARRAY && return_length_i >= 0) {
+    return_array_kernel = GetArrayKernelTag(&return_type);
+  }
+
+  /*
+   * Count the JS-visible IN arguments, now that every SKIP is known
+   */
+
+  n_js_args = 0;
+
+  for (int i = 0; i < n_callable_args; i++) {
+    if (parameters[i].type != ParameterType::SKIP && is_direction_in(parameters[i].direction)) {
+      n_js_args++;
+    }
+  }
+
+  g_atomic_pointer_set(&call_parameters, parameters);
+  TrackHeap(HeapKind::CALL_PLAN, 1);
   return true;
 }
 
@@ -216,31 +321,326 @@ bool FunctionInfo::TypeCheck(
    */
 
   for (int in_arg = 0, i = 0; i < n_callable_args; i++) {
-    Parameter&param = call_parameters[i];
+    const Parameter& param = call_parameters[i];
+
+    // OUT parameters have no JS argument, so argv may end before them
+    if (param.type == ParameterType::SKIP || !is_direction_in(param.direction)) {
+      continue;
+    }
+
+    // Enums and numbers accept any JS number as is, number kernels check the range and take BigInts too
+    int tag = JS_VALUE_GET_TAG(argv[in_arg]);
+    bool is_number = tag == JS_TAG_INT || tag == JS_TAG_FLOAT64 || tag == JS_TAG_BIG_INT;
+
+    if ((param.enum_storage != GI_TYPE_TAG_VOID && tag == JS_TAG_INT) || (param.to_number != nullptr && is_number)) {
+      in_arg++;
+      continue;
+    }
+
+    // Functions are wrapped when converted, which checks the callback type
+    if (param.type == ParameterType::CALLBACK &&
+        (JS_IsFunction(ctx, argv[in_arg]) || JS_IsNull(argv[in_arg]) || JS_IsUndefined(argv[in_arg]))) {
+      in_arg++;
+      continue;
+    }
+
+    // Wrappers of the expected class, a subclass or an implementation pass as is
+    if (param.instance_gtype != G_TYPE_INVALID) {
+      const TypeAncestry *ancestry = JS_GetGObjectAncestry(argv[in_arg]);
+
+      if (ancestry != nullptr && TypeAncestryIsA(ancestry, param.instance_gtype, param.instance_depth)) {
+        in_arg++;
+        continue;
+      }
+    }
+
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+    bool may_be_null = g_arg_info_may_be_null(&arg_info);
+
+    // Wrappers emptied by GI.scope have nothing left to pass
+    if (!may_be_null && IsReleasedWrapper(argv[in_arg])) {
+      JS_ThrowTypeError(ctx, "Argument %s was released by GI.scope", g_base_info_get_name(&arg_info));
+      return false;
+    }
+
+    if (!can_convert_jsvalue_to_giargument(ctx, &type_info, argv[in_arg], may_be_null)) {
+      Throw::InvalidType(ctx, &arg_info, &type_info, argv[in_arg]);
+      return false;
+    }
+
+    in_arg++;
+  }
+
+  return true;
+}
+
+/**
+ * Converts the JS arguments, invokes the function and converts the results.
+ * Init and TypeCheck must have succeeded before. All per-call state lives on
+ * the stack, the plan itself is only read.
+ */
+JSValue FunctionInfo::Call(
+  JSContext *ctx,
+  JSValue self,
+  int argc,
+  JSValue *argv
+  ) {
+  GIArgument *total_arg_values = g_newa(GIArgument, n_total_args);
+  void **     ffi_args         = g_newa(void *, n_total_args);
+  GIArgument *out_storage      = g_newa(GIArgument, n_callable_args + 1);
+  long *      lengths          = g_newa(long, n_callable_args + 1);
+  void **     allocated        = g_newa(void *, n_callable_args + 1);
+  Callback ** callbacks        = g_newa(Callback *, n_callable_args + 1);
+  GError *    error            = NULL;
+
+  GIArgument *callable_arg_values = is_method ? &total_arg_values[1] : &total_arg_values[0];
+
+  // A call is a safe point for releases queued by finalizers
+  if (HasPendingReleases()) {
+    DrainReleases(JS_GetRuntime(ctx), 0);
+  }
+
+  if (is_method) {
+    total_arg_values[0].v_pointer = pointer_from_wrapper(self);
+
+    if (total_arg_values[0].v_pointer == nullptr) {
+      return JS_ThrowTypeError(ctx, "%s called on an instance that was released or transferred",
+                               g_base_info_get_name(info));
+    }
+  }
+
+  if (can_throw) {
+    total_arg_values[n_total_args - 1].v_pointer = &error;
+  }
+
+  /*
+   * Out arguments point to their storage; everything else starts zeroed,
+   * lengths included, since they are filled in when their array is converted.
+   */
+
+  for (int i = 0; i < n_callable_args; i++) {
+    out_storage[i].v_uint64 = 0;
+    lengths[i]              = -1;
+    allocated[i]            = nullptr;
+    callbacks[i]            = nullptr;
+
+    if (is_direction_out(call_parameters[i].direction)) {
+      callable_arg_values[i].v_pointer = &out_storage[i];
+    } else {
+      callable_arg_values[i].v_uint64 = 0;
+    }
+  }
+
+  int  in_arg    = 0;
+  int  converted = 0;
+  bool success   = true;
+
+  for (int i = 0; i < n_callable_args && success; i++, converted = i) {
+    const Parameter& param = call_parameters[i];
 
     if (param.type == ParameterType::SKIP) {
       continue;
     }
 
-    GIArgInfo arg_info;
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
     g_callable_info_load_arg(info, i, &arg_info);
-    GIDirection direction = g_arg_info_get_direction(&arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
 
-    if (direction == GI_DIRECTION_IN || direction == GI_DIRECTION_INOUT) {
-      GITypeInfo type_info;
-      g_arg_info_load_type(&arg_info, &type_info);
-      bool may_be_null = g_arg_info_may_be_null(&arg_info);
+    if (param.direction == GI_DIRECTION_OUT) {
+      if (g_arg_info_is_caller_allocates(&arg_info) && is_pointer_type(&type_info)) {
+        GIBaseInfo *interface_info = g_type_info_get_interface(&type_info);
+        allocated[i] = g_malloc0(Boxed::GetSize(interface_info));
+        callable_arg_values[i].v_pointer = allocated[i];
+        g_base_info_unref(interface_info);
+      }
+      continue;
+    }
+
+    JSValue     value  = argv[in_arg++];
+    GIArgument *target = param.direction == GI_DIRECTION_INOUT ? &out_storage[i] : &callable_arg_values[i];
+
+    if (param.type == ParameterType::CALLBACK) {
+      target->v_pointer = NULL;
 
-      if (!can_convert_jsvalue_to_giargument(ctx, &type_info, argv[in_arg], may_be_null)) {
-        Throw::InvalidType(ctx, &arg_info, &type_info, argv[in_arg]);
-        return false;
+      if (JS_IsNull(value) || JS_IsUndefined(value)) {
+        continue;
       }
 
-      in_arg++;
+      callbacks[i] = JS_ToCallback(ctx, &arg_info, &type_info, value);
+      success      = callbacks[i] != nullptr;
+
+      if (success) {
+        int closure_i = g_arg_info_get_closure(&arg_info);
+        int destroy_i = g_arg_info_get_destroy(&arg_info);
+
+        target->v_pointer = callbacks[i]->native_address;
+
+        if (closure_i >= 0 && closure_i < n_callable_args) {
+          callable_arg_values[closure_i].v_pointer = callbacks[i];
+        }
+
+        if (destroy_i >= 0 && destroy_i < n_callable_args) {
+          callable_arg_values[destroy_i].v_pointer = (gpointer)CallbackDestroyNotify;
+        }
+      }
+      continue;
+    }
+
+    if (param.enum_storage != GI_TYPE_TAG_VOID) {
+      success = jsvalue_to_enum_giargument(ctx, param.enum_storage, target, value);
+      continue;
+    }
+
+    if (param.to_number != nullptr) {
+      success = param.to_number(ctx, value, target);
+      continue;
+    }
+
+    // Plain JS Arrays of numbers are converted in bulk, into a buffer of their own
+    bool is_bulk_array = param.array_kernel != GI_TYPE_TAG_VOID && param.direction == GI_DIRECTION_IN &&
+                         JS_IsPlainArray(ctx, value);
+
+    if (!is_bulk_array) {
+      success = jsvalue_to_giargument(ctx, &type_info, target, value, g_arg_info_may_be_null(&arg_info));
+    }
+
+    if (success && param.type == ParameterType::ARRAY) {
+      int     length_i = g_type_info_get_array_length(&type_info);
+      int64_t length   = 0;
+
+      if (is_bulk_array) {
+        JSValue length_value = JS_GetPropertyStr(ctx, value, "length");
+        success = JS_ToInt64(ctx, &length, length_value) == 0;
+        JS_FreeValue(ctx, length_value);
+
+        if (success && (length < 0 || length > ARRAY_KERNEL_MAX_LENGTH)) {
+          JS_ThrowRangeError(ctx, "Array length %lld is out of range", (long long)length);
+          success = false;
+        }
+
+        if (success) {
+          allocated[i]      = g_try_malloc0_n(MAX(length, 1), get_type_tag_size(param.array_kernel));
+          target->v_pointer = allocated[i];
+
+          if (allocated[i] == nullptr) {
+            JS_ThrowRangeError(ctx, "Could not allocate an array of %lld elements", (long long)length);
+            success = false;
+          }
+        }
+
+        if (success) {
+          success = JS_ArrayToNumbers(ctx, param.array_kernel, value, length, allocated[i]);
+        }
+      } else if (!JS_IsNull(value) && !JS_IsUndefined(value)) {
+        JSValue length_value = JS_GetPropertyStr(ctx, value, "length");
+        success = JS_ToInt64(ctx, &length, length_value) == 0;
+        JS_FreeValue(ctx, length_value);
+      }
+
+      GIArgInfo  length_info;
+      GITypeInfo length_type;
+      g_callable_info_load_arg(info, length_i, &length_info);
+      g_arg_info_load_type(&length_info, &length_type);
+
+      lengths[i] = length;
+      set_length_giargument(
+        &length_type,
+        is_direction_out(call_parameters[length_i].direction) ? &out_storage[length_i] : &callable_arg_values[length_i],
+        length);
     }
   }
 
-  return true;
+  JSValue result = JS_EXCEPTION;
+  bool    called = false;
+
+  if (success) {
+    for (int i = 0; i < n_total_args; i++) {
+      ffi_args[i] = &total_arg_values[i];
+    }
+
+    GITypeInfo       return_type;
+    GIFFIReturnValue ffi_return_value;
+    GIArgument       return_value;
+    bool             return_adopted = false;
+
+    g_callable_info_load_return_type(info, &return_type);
+
+    called = true;
+    ffi_call(&invoker.cif, FFI_FN(invoker.native_address), &ffi_return_value, ffi_args);
+    gi_type_info_extract_ffi_return_value(&return_type, &ffi_return_value, &return_value);
+
+    if (error != NULL) {
+      Throw::FromGError(ctx, error);
+      g_error_free(error);
+    } else {
+      result = GetReturnValue(ctx, self, &return_type, &return_value, callable_arg_values, &return_adopted);
+    }
+
+    if (!return_adopted && return_number == nullptr && !should_skip_return(info, &return_type)) {
+      free_giargument(&return_type, &return_value, g_callable_info_get_caller_owns(info), GI_DIRECTION_OUT);
+    }
+  }
+
+  /*
+   * Release what was converted or allocated for the call. Out values are only
+   * released if the call happened, otherwise they were never filled in.
+   */
+
+  for (int i = 0; i < converted; i++) {
+    const Parameter& param = call_parameters[i];
+
+    if (allocated[i] != nullptr) {
+      GIArgInfo arg_info;
+      g_callable_info_load_arg(info, i, &arg_info);
+
+      // Bulk converted arrays belong to the callee once it ran, if it takes them
+      bool taken = called && param.type == ParameterType::ARRAY &&
+                   g_arg_info_get_ownership_transfer(&arg_info) != GI_TRANSFER_NOTHING;
+
+      if (!taken) {
+        g_free(allocated[i]);
+      }
+      continue;
+    }
+
+    if (param.type == ParameterType::CALLBACK) {
+      CallbackCallDone(callbacks[i], called);
+      continue;
+    }
+
+    if (param.type != ParameterType::NORMAL && param.type != ParameterType::ARRAY) {
+      continue;
+    }
+
+    if (param.direction == GI_DIRECTION_OUT && !success) {
+      continue;
+    }
+
+    GIArgInfo  arg_info;
+    GITypeInfo type_info;
+    g_callable_info_load_arg(info, i, &arg_info);
+    g_arg_info_load_type(&arg_info, &type_info);
+
+    GITransfer  transfer = g_arg_info_get_ownership_transfer(&arg_info);
+    GIArgument *value    = is_direction_out(param.direction) ? &out_storage[i] : &callable_arg_values[i];
+    GIDirection free_dir = param.direction == GI_DIRECTION_IN ? GI_DIRECTION_IN : GI_DIRECTION_OUT;
+
+    if (param.enum_storage != GI_TYPE_TAG_VOID || param.to_number != nullptr) {
+      continue;
+    }
+
+    if (param.type == ParameterType::ARRAY) {
+      free_giargument_array(&type_info, value, transfer, free_dir, lengths[i]);
+    } else {
+      free_giargument(&type_info, value, transfer, free_dir);
+    }
+  }
+
+  return result;
 }
 
 /**
@@ -252,10 +652,13 @@ JSValue FunctionInfo::GetReturnValue(
   JSValue self,
   GITypeInfo *return_type,
   GIArgument *return_value,
-  GIArgument *callable_arg_values) {
-  JSValue jsReturnValue;
+  GIArgument *callable_arg_values,
+  bool *return_adopted) {
+  JSValue jsReturnValue = JS_UNDEFINED;
   int     jsReturnIndex = 0;
 
+  *return_adopted = false;
+
   if (n_out_args > 1) {
     jsReturnValue = JS_NewArray(ctx);
   }
@@ -267,7 +670,9 @@ JSValue FunctionInfo::GetReturnValue(
 
   int return_length_i = g_type_info_get_array_length(return_type);
 
-  if (!should_skip_return(info, return_type)) {
+  if (return_number != nullptr && !should_skip_return(info, return_type)) {
+    ADD_RETURN(return_number(ctx, return_value))
+  } else if (!should_skip_return(info, return_type)) {
     long length = -1;
 
     if (return_length_i >= 0) {
@@ -286,7 +691,30 @@ JSValue FunctionInfo::GetReturnValue(
     // When a method returns the instance itself, skip the conversion and just return the
     // existent wrapper
     bool isReturningSelf = is_method && pointer_from_wrapper(self) == return_value->v_pointer;
-    ADD_RETURN(isReturningSelf ? self : jsvalue_from_giargument(ctx, return_type, return_value, length))
+
+    // Lists and hash tables can be handed out as lazy views instead of being converted eagerly
+    GITransfer transfer = g_callable_info_get_caller_owns(info);
+    bool       isView   = !isReturningSelf && CanMakeContainerView(return_type, transfer) && ContainerViewsEnabled(ctx);
+
+    *return_adopted = isView;
+
+    JSValue value;
+
+    if (isView) {
+      value = JS_MakeContainerView(ctx, g_callable_info_get_return_type(info), return_value->v_pointer, transfer);
+    } else if (return_array_kernel != GI_TYPE_TAG_VOID && return_value->v_pointer != nullptr && length >= 0) {
+      value = JS_NewArrayFromNumbers(ctx, return_array_kernel, return_value->v_pointer, length);
+    } else {
+      value = isReturningSelf ? JS_DupValue(ctx, self) :
+              return_is_object ? jsvalue_from_object(ctx, return_type, return_value) :
+              jsvalue_from_giargument(ctx, return_type, return_value, length);
+    }
+
+    if (transfer != GI_TRANSFER_NOTHING && !isReturningSelf) {
+      ScopeTrack(ctx, value);
+    }
+
+    ADD_RETURN(value)
   }
 
   for (int i = 0; i < n_callable_args; i++) {
@@ -297,7 +725,7 @@ JSValue FunctionInfo::GetReturnValue(
     GIArgInfo  arg_info = {};
     GITypeInfo arg_type;
     GIArgument arg_value = callable_arg_values[i];
-    Parameter& param     = call_parameters[i];
+    const Parameter& param = call_parameters[i];
 
     g_callable_info_load_arg(info, i, &arg_info);
     g_arg_info_load_type(&arg_info, &arg_type);
@@ -313,21 +741,38 @@ JSValue FunctionInfo::GetReturnValue(
         g_arg_info_load_type(&length_arg, &length_type);
         GIDirection length_direction = g_arg_info_get_direction(&length_arg);
 
-        param.length =
+        long length =
           giargument_to_length(
             &length_type,
             &callable_arg_values[length_i],
             is_direction_out(length_direction));
 
-        JSValue result = jsvalue_from_array(ctx, &arg_type, *(void **)arg_value.v_pointer, param.length);
+        void *  data   = *(void **)arg_value.v_pointer;
+        JSValue result =
+          param.array_kernel != GI_TYPE_TAG_VOID && data != nullptr && length >= 0 ?
+          JS_NewArrayFromNumbers(ctx, param.array_kernel, data, length) :
+          jsvalue_from_array(ctx, &arg_type, data, length);
 
         ADD_RETURN(result)
       } else if (param.type == ParameterType::NORMAL) {
         if (is_pointer_type(&arg_type) && g_arg_info_is_caller_allocates(&arg_info)) {
-          void *pointer = &arg_value.v_pointer;
-          ADD_RETURN(jsvalue_from_giargument(ctx, &arg_type, (GIArgument *)pointer))
+          // The memory was allocated by Call and is released there, so the wrapper needs its own copy
+          void *  pointer = &arg_value.v_pointer;
+          JSValue value   = jsvalue_from_giargument(ctx, &arg_type, (GIArgument *)pointer, -1, true);
+
+          ScopeTrack(ctx, value);
+          ADD_RETURN(value)
         } else {
-          ADD_RETURN(jsvalue_from_giargument(ctx, &arg_type, (GIArgument *)arg_value.v_pointer))
+          JSValue value =
+            param.is_object ?
+            jsvalue_from_object(ctx, &arg_type, (GIArgument *)arg_value.v_pointer) :
+            jsvalue_from_giargument(ctx, &arg_type, (GIArgument *)arg_value.v_pointer);
+
+          if (g_arg_info_get_ownership_transfer(&arg_info) != GI_TRANSFER_NOTHING) {
+            ScopeTrack(ctx, value);
+          }
+
+          ADD_RETURN(value)
         }
       }
     }
@@ -338,8 +783,79 @@ JSValue FunctionInfo::GetReturnValue(
   return jsReturnValue;
 }
 
+
+/**
+ * Call plans are shared by every context and runtime of the process, keyed by
+ * the typelib entry of the function. The cache keeps its own reference, so a
+ * plan stays warm after the contexts that used it are gone.
+ */
+
+static GHashTable *function_info_cache = NULL;
+G_LOCK_DEFINE_STATIC(function_info_cache);
+
+/**
+ * @returns a new reference to the shared FunctionInfo of info
+ */
+FunctionInfo *GetFunctionInfo(GIBaseInfo *info) {
+  G_LOCK(function_info_cache);
+
+  if (function_info_cache == NULL) {
+    function_info_cache = g_hash_table_new(base_info_hash, base_info_equal);
+  }
+
+  FunctionInfo *func = (FunctionInfo *)g_hash_table_lookup(function_info_cache, info);
+
+  if (func == nullptr) {
+    func = new FunctionInfo(info);
+    g_hash_table_insert(function_info_cache, func->info, func);
+  }
+
+  func->Ref();
+  G_UNLOCK(function_info_cache);
+
+  return func;
+}
+
 }
 
+static void set_length_giargument(GITypeInfo *length_type, GIArgument *arg, long length) {
+  switch (g_type_info_get_tag(length_type)) {
+  case GI_TYPE_TAG_INT8:
+    arg->v_int8 = length;
+    break;
+
+  case GI_TYPE_TAG_UINT8:
+    arg->v_uint8 = length;
+    break;
+
+  case GI_TYPE_TAG_INT16:
+    arg->v_int16 = length;
+    break;
+
+  case GI_TYPE_TAG_UINT16:
+    arg->v_uint16 = length;
+    break;
+
+  case GI_TYPE_TAG_INT32:
+    arg->v_int32 = length;
+    break;
+
+  case GI_TYPE_TAG_UINT32:
+    arg->v_uint32 = length;
+    break;
+
+  case GI_TYPE_TAG_UINT64:
+    arg->v_uint64 = length;
+    break;
+
+  case GI_TYPE_TAG_INT64:
+  default:
+    arg->v_int64 = length;
+    break;
+  }
+}
+
+
 static inline bool is_pointer_type(GITypeInfo *type_info) {
   auto tag = g_type_info_get_tag(type_info);
 
@@ -359,6 +875,38 @@ static inline bool is_pointer_type(GITypeInfo *type_info) {
   return isPointer;
 }
 
+static inline bool is_object_type(GITypeInfo *type_info) {
+  if (g_type_info_get_tag(type_info) != GI_TYPE_TAG_INTERFACE) {
+    return false;
+  }
+
+  auto interface_info = g_type_info_get_interface(type_info);
+  auto interface_type = g_base_info_get_type(interface_info);
+
+  g_base_info_unref(interface_info);
+
+  return interface_type == GI_INFO_TYPE_OBJECT || interface_type == GI_INFO_TYPE_INTERFACE;
+}
+
+/**
+ * Wraps a returned object or interface instance. The wrapper takes its own
+ * (sunk) reference; a transferred one is still dropped by Call's cleanup.
+ * Fundamental types that aren't GObjects take the generic conversion.
+ */
+static JSValue jsvalue_from_object(JSContext *ctx, GITypeInfo *type_info, GIArgument *arg) {
+  gpointer instance = arg->v_pointer;
+
+  if (instance == NULL) {
+    return JS_NULL;
+  }
+
+  if (!g_type_is_a(G_TYPE_FROM_INSTANCE(instance), G_TYPE_OBJECT)) {
+    return QJSGir::jsvalue_from_giargument(ctx, type_info, arg);
+  }
+
+  return QJSGir::JS_MakeOpaqueGObject(ctx, (GObject *)instance, false);
+}
+
 static bool should_skip_return(GIBaseInfo *info, GITypeInfo *return_type) {
   return g_type_info_get_tag(return_type) == GI_TYPE_TAG_VOID ||
          g_callable_info_skip_return(info) == TRUE;
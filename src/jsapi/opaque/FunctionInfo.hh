@@ -21,23 +21,47 @@
 #include <girepository.h>
 #include <quickjs/quickjs.h>
 
+#include "gi/number.hh"
+#include "jsapi/HeapStats.hh"
+
 namespace QJSGir {
 
 enum ParameterType {
   NORMAL, ARRAY, SKIP, CALLBACK
 };
 
+/**
+ * Per-parameter part of the call plan. Plans are shared by every context, so
+ * nothing in here may change once FunctionInfo::Init has run.
+ */
 struct Parameter {
   ParameterType type;
   GIDirection   direction;
-  GIArgument    data;
-  long          length;
+
+  // Storage type of IN enum/flags parameters, GI_TYPE_TAG_VOID otherwise
+  GITypeTag     enum_storage;
+
+  // Kernel for IN parameters that are plain numbers, nullptr otherwise
+  NumberToArgument to_number;
+
+  // Element tag of ARRAY parameters converted by the bulk kernels, GI_TYPE_TAG_VOID otherwise
+  GITypeTag     array_kernel;
+
+  // Class or interface of IN GObject parameters, G_TYPE_INVALID otherwise
+  GType         instance_gtype;
+  guint         instance_depth;
+
+  // Whether OUT values are object or interface instances, wrapped directly
+  bool          is_object;
 };
 
 struct FunctionInfo {
   GIFunctionInfo *  info;
   GIFunctionInvoker invoker;
 
+  gint              ref_count;
+  GMutex            init_mutex;
+
   bool              is_method;
   bool              can_throw;
 
@@ -45,17 +69,40 @@ struct FunctionInfo {
   int               n_total_args;
   int               n_out_args;
   int               n_in_args;
+  int               n_js_args;
 
   Parameter *       call_parameters;
 
+  // Kernel for returns that are plain numbers, nullptr otherwise
+  NumberFromArgument return_number;
+
+  // Element tag of returned arrays converted by the bulk kernels, GI_TYPE_TAG_VOID otherwise
+  GITypeTag         return_array_kernel;
+
+  // Whether returns are object or interface instances, wrapped directly
+  bool              return_is_object;
+
+  // Heap stats groups of the JS functions and of the call plan
+  HeapGroup *       function_group;
+  HeapGroup *       plan_group;
+
   FunctionInfo(GIBaseInfo *info);
   ~FunctionInfo();
 
+  FunctionInfo *Ref();
+  void Unref();
+
+  void TrackHeap(HeapKind kind, int sign);
+
   bool Init(JSContext *ctx);
+  bool InitParameters(JSContext *ctx);
 
   bool TypeCheck(JSContext *ctx, int argc, JSValue *argv);
-  JSValue GetReturnValue(JSContext *ctx, JSValue self, GITypeInfo *return_type, GIArgument *returnvalue, GIArgument *callable_arg_values);
+  JSValue Call(JSContext *ctx, JSValue self, int argc, JSValue *argv);
+  JSValue GetReturnValue(JSContext *ctx, JSValue self, GITypeInfo *return_type, GIArgument *returnvalue, GIArgument *callable_arg_values, bool *return_adopted);
   void FreeReturnValue(GIArgument *info);
 };
 
+FunctionInfo *GetFunctionInfo(GIBaseInfo *info);
+
 }
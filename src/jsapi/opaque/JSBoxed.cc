@@ -0,0 +1,428 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/boxed.hh"
+#include "gi/field.hh"
+#include "gi/function.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/HeapStats.hh"
+#include "jsapi/MemoryPressure.hh"
+#include "jsapi/MemoryView.hh"
+#include "jsapi/opaque/JSBoxed.hh"
+
+namespace QJSGir {
+
+JSClassID js_boxed_classid;
+static JSClassID js_boxed_fields_classid;
+
+/**
+ * Field accessors of one struct/union type, shared by the getters and
+ * setters installed on its prototype.
+ */
+struct BoxedFields {
+  GIBaseInfo *   info;
+  int            n_fields;
+  FieldAccessor *fields;
+
+  BoxedFields(GIBaseInfo *gi_info) {
+    info = g_base_info_ref(gi_info);
+
+    bool is_union = g_base_info_get_type(info) == GI_INFO_TYPE_UNION;
+
+    n_fields = is_union ? g_union_info_get_n_fields(info) : g_struct_info_get_n_fields(info);
+    fields   = new FieldAccessor[n_fields]();
+
+    for (int i = 0; i < n_fields; i++) {
+      GIFieldInfo *field_info = is_union ? g_union_info_get_field(info, i) : g_struct_info_get_field(info, i);
+      fields[i].Init(field_info);
+      g_base_info_unref(field_info);
+    }
+  }
+
+  ~BoxedFields() {
+    delete[] fields;
+    g_base_info_unref(info);
+  }
+};
+
+static HeapGroup *get_heap_group(ContextData *context_data, GIBaseInfo *info, GType gtype) {
+  const char *name = g_base_info_get_name(info);
+  const char *ns   = g_base_info_get_namespace(info);
+
+  // Structs without a GType are grouped by their name
+  gconstpointer key = gtype != G_TYPE_NONE && gtype != G_TYPE_INVALID
+    ? GSIZE_TO_POINTER(gtype)
+    : HeapStatsGroupKey(ns, name);
+
+  return context_data != nullptr
+    ? context_data->GetHeapGroup(HeapKind::BOXED, key, name, ns)
+    : HeapStatsGetGroup(HeapKind::BOXED, key, name, ns);
+}
+
+static void track_boxed(Boxed *boxed, int sign) {
+  gint64 bytes = boxed->owns_memory && boxed->data != nullptr ? boxed->native_size : 0;
+
+  HeapStatsAdd(boxed->heap_group, sign, sign * bytes);
+}
+
+static bool uses_boxed_free(Boxed *boxed) {
+  return !boxed->plain_memory && g_type_is_a(boxed->gtype, G_TYPE_BOXED);
+}
+
+static void free_memory(Boxed *boxed) {
+  if (uses_boxed_free(boxed)) {
+    g_boxed_free(boxed->gtype, boxed->data);
+  } else {
+    g_free(boxed->data);
+  }
+}
+
+static void release_boxed(gpointer data) {
+  Boxed *boxed = (Boxed *)data;
+
+  if (boxed->owns_memory && boxed->data != nullptr) {
+    free_memory(boxed);
+  }
+
+  g_base_info_unref(boxed->info);
+  delete boxed;
+}
+
+static void js_boxed_finalizer(JSRuntime *rt, JSValue val) {
+  Boxed *boxed = (Boxed *)JS_GetOpaque(val, js_boxed_classid);
+
+  track_boxed(boxed, -1);
+
+  if (boxed->owns_memory && boxed->data != nullptr) {
+    RemoveExternalMemory(rt, boxed->native_size);
+  }
+
+  // Only g_boxed_free can run foreign code, plain memory is freed right away
+  if (boxed->owns_memory && boxed->data != nullptr && uses_boxed_free(boxed)) {
+    DeferRelease(rt, release_boxed, boxed);
+  } else {
+    release_boxed(boxed);
+  }
+}
+
+static void js_boxed_fields_finalizer(JSRuntime *rt, JSValue val) {
+  delete (BoxedFields *)JS_GetOpaque(val, js_boxed_fields_classid);
+}
+
+static JSClassDef js_boxed_class = {
+  "Boxed",
+  .finalizer = js_boxed_finalizer,
+};
+
+static JSClassDef js_boxed_fields_class = {
+  "BoxedFields",
+  .finalizer = js_boxed_fields_finalizer,
+};
+
+bool js_setup_boxed(JSContext *ctx) {
+  JS_NewClassID(&js_boxed_classid);
+  JS_NewClassID(&js_boxed_fields_classid);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, js_boxed_classid)) {
+    JS_NewClass(rt, js_boxed_classid, &js_boxed_class);
+  }
+  if (!JS_IsRegisteredClass(rt, js_boxed_fields_classid)) {
+    JS_NewClass(rt, js_boxed_fields_classid, &js_boxed_fields_class);
+  }
+
+  return true;
+}
+
+/**
+ * Resolves the accessor for `this`, checking that the wrapper really is of the
+ * struct type the accessor was compiled for.
+ */
+static FieldAccessor *get_field(JSContext *ctx, JSValueConst this_val, JSValue *func_data, int magic, Boxed **boxed) {
+  BoxedFields *fields = (BoxedFields *)JS_GetOpaque(func_data[0], js_boxed_fields_classid);
+
+  *boxed = (Boxed *)JS_GetOpaque2(ctx, this_val, js_boxed_classid);
+
+  if (*boxed == nullptr) {
+    return nullptr;
+  }
+
+  if ((*boxed)->data == nullptr) {
+    JS_ThrowTypeError(ctx, "%s.%s was transferred away",
+                      g_base_info_get_namespace(fields->info),
+                      g_base_info_get_name(fields->info));
+    return nullptr;
+  }
+
+  if ((*boxed)->info != fields->info && !g_base_info_equal((*boxed)->info, fields->info)) {
+    JS_ThrowTypeError(ctx, "Expected an instance of %s.%s",
+                      g_base_info_get_namespace(fields->info),
+                      g_base_info_get_name(fields->info));
+    return nullptr;
+  }
+
+  return &fields->fields[magic];
+}
+
+static JSValue js_boxed_field_get(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic, JSValue *func_data) {
+  Boxed *        boxed;
+  FieldAccessor *field = get_field(ctx, this_val, func_data, magic, &boxed);
+
+  if (field == nullptr) {
+    return JS_EXCEPTION;
+  }
+
+  if (!field->readable) {
+    return JS_ThrowTypeError(ctx, "Field %s is not readable", g_base_info_get_name(field->info));
+  }
+
+  return field->get(ctx, field, boxed->data);
+}
+
+static JSValue js_boxed_field_set(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv, int magic, JSValue *func_data) {
+  Boxed *        boxed;
+  FieldAccessor *field = get_field(ctx, this_val, func_data, magic, &boxed);
+
+  if (field == nullptr) {
+    return JS_EXCEPTION;
+  }
+
+  if (!field->writable) {
+    return JS_ThrowTypeError(ctx, "Field %s is not writable", g_base_info_get_name(field->info));
+  }
+
+  if (!field->set(ctx, field, boxed->data, argv[0])) {
+    return JS_EXCEPTION;
+  }
+
+  return JS_UNDEFINED;
+}
+
+/**
+ * Builds the prototype of a struct/union, with one accessor property per field
+ */
+static JSValue make_boxed_prototype(JSContext *ctx, JSValue fields_obj) {
+  BoxedFields *fields = (BoxedFields *)JS_GetOpaque(fields_obj, js_boxed_fields_classid);
+  JSValue      proto  = JS_NewObject(ctx);
+
+  for (int i = 0; i < fields->n_fields; i++) {
+    JSAtom  name   = JS_NewAtom(ctx, g_base_info_get_name(fields->fields[i].info));
+    JSValue getter = JS_NewCFunctionData(ctx, js_boxed_field_get, 0, i, 1, &fields_obj);
+    JSValue setter = JS_NewCFunctionData(ctx, js_boxed_field_set, 1, i, 1, &fields_obj);
+
+    JS_DefinePropertyGetSet(ctx, proto, name, getter, setter, JS_PROP_CONFIGURABLE | JS_PROP_ENUMERABLE);
+    JS_FreeAtom(ctx, name);
+  }
+
+  return proto;
+}
+
+JSValue JS_MakeOpaqueBoxed(JSContext *ctx, GIBaseInfo *info, void *data, bool owns_memory) {
+  js_setup_boxed(ctx);
+
+  ContextData *context_data = GetContextData(ctx);
+  JSValue      proto        = context_data ? context_data->GetPrototype(info) : JS_UNDEFINED;
+  JSValue      boxed_obj    = JS_IsUndefined(proto)
+    ? JS_NewObjectClass(ctx, js_boxed_classid)
+    : JS_NewObjectProtoClass(ctx, proto, js_boxed_classid);
+
+  JS_FreeValue(ctx, proto);
+
+  if (JS_IsException(boxed_obj)) {
+    return boxed_obj;
+  }
+
+  Boxed *boxed = new Boxed();
+  boxed->data         = data;
+  boxed->info         = g_base_info_ref(info);
+  boxed->gtype        = g_registered_type_info_get_g_type(info);
+  boxed->size         = Boxed::GetSize(info);
+  boxed->owns_memory  = owns_memory;
+  boxed->plain_memory = false;
+  boxed->persistent   = nullptr;
+  boxed->native_size  = owns_memory && data != nullptr ? Boxed::GetNativeSize(info, boxed->gtype, data) : 0;
+  boxed->heap_group   = get_heap_group(context_data, info, boxed->gtype);
+
+  JS_SetOpaque(boxed_obj, boxed);
+  track_boxed(boxed, 1);
+
+  if (owns_memory && data != nullptr) {
+    AddExternalMemory(ctx, boxed->native_size);
+  }
+
+  return boxed_obj;
+}
+
+/**
+ * Takes the memory of a boxed wrapper for another runtime. Owned memory is
+ * moved, leaving the wrapper empty; borrowed memory can't be, so it is
+ * copied and the wrapper keeps working.
+ * @returns memory owned by the caller, freed like JS_MakeOpaqueBoxed's, or nullptr after throwing
+ */
+void *JS_DetachBoxed(JSContext *ctx, JSValueConst value, GIBaseInfo **info) {
+  Boxed *boxed = (Boxed *)JS_GetOpaque(value, js_boxed_classid);
+  void * data  = nullptr;
+
+  if (boxed == nullptr || boxed->data == nullptr) {
+    JS_ThrowTypeError(ctx, "Expected a struct that wasn't transferred yet");
+    return nullptr;
+  }
+
+  // Plain memory of a boxed type can't be moved, receivers free it with g_boxed_free
+  if (boxed->owns_memory && !(boxed->plain_memory && g_type_is_a(boxed->gtype, G_TYPE_BOXED))) {
+    DetachMemoryViews(ctx, boxed);
+    track_boxed(boxed, -1);
+    RemoveExternalMemory(JS_GetRuntime(ctx), boxed->native_size);
+
+    data               = boxed->data;
+    boxed->data        = nullptr;
+    boxed->owns_memory = false;
+
+    track_boxed(boxed, 1);
+  } else if (g_type_is_a(boxed->gtype, G_TYPE_BOXED)) {
+    data = g_boxed_copy(boxed->gtype, boxed->data);
+
+    if (data == nullptr) {
+      JS_ThrowTypeError(ctx, "%s.%s could not be copied",
+                        g_base_info_get_namespace(boxed->info), g_base_info_get_name(boxed->info));
+      return nullptr;
+    }
+  } else if (boxed->size > 0) {
+    data = g_memdup2(boxed->data, boxed->size);
+  } else {
+    JS_ThrowTypeError(ctx, "%s.%s cannot be copied",
+                      g_base_info_get_namespace(boxed->info), g_base_info_get_name(boxed->info));
+    return nullptr;
+  }
+
+  *info = g_base_info_ref(boxed->info);
+  return data;
+}
+
+/**
+ * Frees the memory of a boxed wrapper that owns it, leaving the wrapper empty
+ * @returns false if value isn't such a wrapper
+ */
+bool JS_ReleaseBoxed(JSContext *ctx, JSValueConst value) {
+  Boxed *boxed = (Boxed *)JS_GetOpaque(value, js_boxed_classid);
+
+  if (boxed == nullptr || !boxed->owns_memory || boxed->data == nullptr) {
+    return false;
+  }
+
+  DetachMemoryViews(ctx, boxed);
+  track_boxed(boxed, -1);
+  RemoveExternalMemory(JS_GetRuntime(ctx), boxed->native_size);
+
+  free_memory(boxed);
+
+  boxed->data        = nullptr;
+  boxed->owns_memory = false;
+
+  track_boxed(boxed, 1);
+  return true;
+}
+
+/**
+ * new Namespace.Struct([fields])
+ * Allocates zeroed memory for the struct, optionally initializing fields from
+ * the properties of the given object.
+ */
+static JSValue js_boxed_constructor(JSContext *ctx, JSValueConst new_target, int argc, JSValueConst *argv, int magic, JSValue *func_data) {
+  BoxedFields *fields = (BoxedFields *)JS_GetOpaque(func_data[0], js_boxed_fields_classid);
+  GIBaseInfo * info   = fields->info;
+  size_t       size   = Boxed::GetSize(info);
+
+  if (size == 0) {
+    return JS_ThrowTypeError(ctx, "%s.%s cannot be constructed",
+                             g_base_info_get_namespace(info), g_base_info_get_name(info));
+  }
+
+  // Copy functions may not cope with zeroed memory, so boxed types are left
+  // to g_free as well rather than passed through g_boxed_copy
+  void *  data      = g_malloc0(size);
+  JSValue boxed_obj = JS_MakeOpaqueBoxed(ctx, info, data, true);
+
+  if (JS_IsException(boxed_obj)) {
+    g_free(data);
+    return boxed_obj;
+  }
+
+  ((Boxed *)JS_GetOpaque(boxed_obj, js_boxed_classid))->plain_memory = true;
+
+  if (argc < 1 || !JS_IsObject(argv[0])) {
+    return boxed_obj;
+  }
+
+  for (int i = 0; i < fields->n_fields; i++) {
+    FieldAccessor *field = &fields->fields[i];
+    JSValue        value = JS_GetPropertyStr(ctx, argv[0], g_base_info_get_name(field->info));
+
+    if (JS_IsUndefined(value)) {
+      continue;
+    }
+
+    bool success = !JS_IsException(value) && field->writable && field->set(ctx, field, data, value);
+    JS_FreeValue(ctx, value);
+
+    if (!success) {
+      if (!field->writable) {
+        JS_ThrowTypeError(ctx, "Field %s is not writable", g_base_info_get_name(field->info));
+      }
+      JS_FreeValue(ctx, boxed_obj);
+      return JS_EXCEPTION;
+    }
+  }
+
+  return boxed_obj;
+}
+
+/**
+ * Creates the constructor of a struct/union type and registers its prototype
+ * for the current context, so every wrapper of that type gets the field
+ * accessors and instance methods. Static functions go on the constructor.
+ */
+JSValue JS_MakeBoxedConstructor(JSContext *ctx, GIBaseInfo *info) {
+  js_setup_boxed(ctx);
+
+  JSValue fields_obj = JS_NewObjectClass(ctx, js_boxed_fields_classid);
+  JS_SetOpaque(fields_obj, new BoxedFields(info));
+
+  JSValue proto = make_boxed_prototype(ctx, fields_obj);
+  JSValue ctor  = JS_NewCFunctionData(ctx, js_boxed_constructor, 1, 0, 1, &fields_obj);
+
+  JS_SetConstructorBit(ctx, ctor, TRUE);
+  JS_SetConstructor(ctx, ctor, proto);
+  DefineMethods(ctx, info, proto, ctor);
+
+  ContextData *context_data = GetContextData(ctx);
+  if (context_data != nullptr) {
+    context_data->SetPrototype(info, proto);
+  } else {
+    JS_FreeValue(ctx, proto);
+  }
+
+  JS_FreeValue(ctx, fields_obj);
+  return ctor;
+}
+
+}
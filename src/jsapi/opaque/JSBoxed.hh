@@ -0,0 +1,35 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+#include "gi/boxed.hh"
+
+namespace QJSGir {
+
+extern JSClassID js_boxed_classid;
+
+bool js_setup_boxed(JSContext *ctx);
+JSValue JS_MakeOpaqueBoxed(JSContext *ctx, GIBaseInfo *info, void *data, bool owns_memory);
+JSValue JS_MakeBoxedConstructor(JSContext *ctx, GIBaseInfo *info);
+void *JS_DetachBoxed(JSContext *ctx, JSValueConst value, GIBaseInfo **info);
+bool JS_ReleaseBoxed(JSContext *ctx, JSValueConst value);
+
+}
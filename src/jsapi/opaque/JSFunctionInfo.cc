@@ -21,32 +21,98 @@
 
 namespace QJSGir {
 
+JSClassID js_function_info_classid;
+
 static void js_function_info_finalizer(JSRuntime *rt, JSValue val) {
   FunctionInfo *func = (FunctionInfo *)JS_GetOpaque(val, js_function_info_classid);
 
-  delete func;
+  func->TrackHeap(HeapKind::FUNCTION, -1);
+  func->Unref();
+}
+
+/**
+ * FunctionInfo objects are directly callable, so the JS function of a GI
+ * function is a single object holding a reference to its shared call plan.
+ */
+static JSValue js_function_info_call(JSContext *ctx, JSValueConst func_obj, JSValueConst this_val, int argc, JSValueConst *argv, int flags) {
+  FunctionInfo *func = (FunctionInfo *)JS_GetOpaque(func_obj, js_function_info_classid);
+
+  if (!func->Init(ctx)) {
+    return JS_EXCEPTION;
+  }
+
+  // Optional arguments may be left out, pad them with undefined
+  if (argc < func->n_js_args) {
+    JSValue *padded = g_newa(JSValue, func->n_js_args);
+
+    for (int i = 0; i < func->n_js_args; i++) {
+      padded[i] = i < argc ? argv[i] : JS_UNDEFINED;
+    }
+
+    argc = func->n_js_args;
+    argv = padded;
+  }
+
+  if (!func->TypeCheck(ctx, argc, argv)) {
+    return JS_EXCEPTION;
+  }
+
+  return func->Call(ctx, this_val, argc, argv);
 }
 
 static JSClassDef js_function_info_class = {
   "FunctionInfo",
   .finalizer = js_function_info_finalizer,
+  .call      = js_function_info_call,
 };
 
+/**
+ * Registers the class for the runtime and its prototype for the context.
+ * Called once per context, by BootstrapGI.
+ */
 bool js_setup_function_info(JSContext *ctx) {
   JS_NewClassID(&js_function_info_classid);
 
   JSRuntime *rt = JS_GetRuntime(ctx);
-  if (!JS_IsRegisteredClass(JS_GetRuntime(ctx), js_function_info_classid)) {
-    JS_NewClass(rt, js_function_info_classid, &js_function_info_class);
+  if (!JS_IsRegisteredClass(rt, js_function_info_classid) &&
+      JS_NewClass(rt, js_function_info_classid, &js_function_info_class) < 0) {
+    JS_ThrowOutOfMemory(ctx);
+    return false;
+  }
+
+  // Inherit from Function.prototype, so call/apply/bind work as usual
+  JSValue global         = JS_GetGlobalObject(ctx);
+  JSValue function_ctor  = JS_GetPropertyStr(ctx, global, "Function");
+  JSValue function_proto = JS_GetPropertyStr(ctx, function_ctor, "prototype");
+
+  JS_FreeValue(ctx, function_ctor);
+  JS_FreeValue(ctx, global);
+
+  if (JS_IsException(function_proto)) {
+    return false;
   }
 
+  JS_SetClassProto(ctx, js_function_info_classid, function_proto);
   return true;
 }
 
+FunctionInfo *JS_GetFunctionInfo(JSValueConst value) {
+  return (FunctionInfo *)JS_GetOpaque(value, js_function_info_classid);
+}
+
+/**
+ * Takes ownership of one reference to func, dropped if this throws
+ */
 JSValue JS_MakeOpaqueFunctionInfo(JSContext *ctx, FunctionInfo *func) {
-  js_setup_function_info(ctx);
   JSValue opaque_func_obj = JS_NewObjectClass(ctx, js_function_info_classid);
+
+  if (JS_IsException(opaque_func_obj)) {
+    func->Unref();
+    return opaque_func_obj;
+  }
+
   JS_SetOpaque(opaque_func_obj, func);
+  func->TrackHeap(HeapKind::FUNCTION, 1);
   return opaque_func_obj;
 }
 
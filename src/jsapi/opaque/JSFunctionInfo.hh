@@ -22,9 +22,10 @@
 
 namespace QJSGir {
 
-JSClassID js_function_info_classid;
+extern JSClassID js_function_info_classid;
 
 bool js_setup_function_info(JSContext *ctx);
 JSValue JS_MakeOpaqueFunctionInfo(JSContext *ctx, FunctionInfo *func);
+FunctionInfo *JS_GetFunctionInfo(JSValueConst value);
 
 }
@@ -0,0 +1,295 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+#include <string.h>
+
+#include "gi/function.hh"
+#include "jsapi/ContextData.hh"
+#include "jsapi/DeferredRelease.hh"
+#include "jsapi/HeapStats.hh"
+#include "jsapi/MemoryPressure.hh"
+#include "jsapi/MemoryView.hh"
+#include "jsapi/Stream.hh"
+#include "jsapi/opaque/JSGObject.hh"
+#include "utils/macros.hh"
+
+namespace QJSGir {
+
+JSClassID js_gobject_classid;
+static JSClassID js_gobject_class_classid;
+
+static void release_wrapper(gpointer data) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)data;
+
+  if (wrapper->gobject != NULL) {
+    g_object_unref(wrapper->gobject);
+  }
+
+  if (wrapper->info != NULL) {
+    g_base_info_unref(wrapper->info);
+  }
+
+  delete wrapper;
+}
+
+static void track_wrapper(GObjectWrapper *wrapper, int sign) {
+  HeapStatsAdd(wrapper->heap_group, sign, sign * (gint64)wrapper->size);
+}
+
+/**
+ * The instance size, plus the pixels of a GdkPixbuf, which are most of what it
+ * retains. Pixbufs are found by name, so there is no need to link gdk-pixbuf.
+ */
+static gsize get_native_size(GObject *gobject, const TypeAncestry *ancestry) {
+  GTypeQuery query;
+  g_type_query(ancestry->gtype, &query);
+
+  gsize size = query.instance_size;
+
+  if (ancestry->depth >= 2 && strcmp(g_type_name(ancestry->ancestors[1]), "GdkPixbuf") == 0) {
+    int rowstride = 0;
+    int height    = 0;
+
+    g_object_get(gobject, "rowstride", &rowstride, "height", &height, NULL);
+    size += (gsize)rowstride * height;
+  }
+
+  return size;
+}
+
+static void js_gobject_finalizer(JSRuntime *rt, JSValue val) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)JS_GetOpaque(val, js_gobject_classid);
+
+  if (wrapper->gobject != NULL) {
+    track_wrapper(wrapper, -1);
+    RemoveExternalMemory(rt, wrapper->size);
+  }
+
+  // The unref may run dispose handlers, which must not happen inside the GC
+  if (wrapper->gobject != NULL) {
+    DeferRelease(rt, release_wrapper, wrapper);
+  } else {
+    release_wrapper(wrapper);
+  }
+}
+
+static JSClassDef js_gobject_class = {
+  "GObject",
+  .finalizer = js_gobject_finalizer,
+};
+
+/*
+ * Namespace.Class objects. The opaque is the GType itself; `instanceof` is
+ * answered from the ancestry of the instance's class, without walking either
+ * the GType hierarchy or the prototype chain.
+ */
+static JSClassDef js_gobject_class_class = {
+  "GObjectClass",
+};
+
+static JSValue js_gobject_class_has_instance(JSContext *ctx, JSValueConst this_val, int argc, JSValueConst *argv) {
+  GType               gtype    = GPOINTER_TO_SIZE(JS_GetOpaque2(ctx, this_val, js_gobject_class_classid));
+  const TypeAncestry *ancestry = JS_GetGObjectAncestry(argv[0]);
+
+  if (gtype == G_TYPE_INVALID) {
+    return JS_EXCEPTION;
+  }
+
+  return JS_NewBool(ctx, ancestry != nullptr && TypeAncestryIsA(ancestry, gtype, GetTargetDepth(gtype)));
+}
+
+static const JSCFunctionListEntry js_gobject_class_proto_funcs[] = {
+  JS_CFUNC_DEF("[Symbol.hasInstance]", 1, js_gobject_class_has_instance),
+};
+
+bool js_setup_gobject(JSContext *ctx) {
+  JS_NewClassID(&js_gobject_classid);
+  JS_NewClassID(&js_gobject_class_classid);
+
+  JSRuntime *rt = JS_GetRuntime(ctx);
+  if (!JS_IsRegisteredClass(rt, js_gobject_classid)) {
+    JS_NewClass(rt, js_gobject_classid, &js_gobject_class);
+  }
+  if (!JS_IsRegisteredClass(rt, js_gobject_class_classid)) {
+    JS_NewClass(rt, js_gobject_class_classid, &js_gobject_class_class);
+  }
+
+  JSValue proto = JS_GetClassProto(ctx, js_gobject_class_classid);
+
+  if (!JS_IsObject(proto)) {
+    JSValue class_proto = JS_NewObject(ctx);
+    JS_SetPropertyFunctionList(ctx, class_proto, js_gobject_class_proto_funcs, countof(js_gobject_class_proto_funcs));
+    JS_SetClassProto(ctx, js_gobject_class_classid, class_proto);
+  }
+
+  JS_FreeValue(ctx, proto);
+  return true;
+}
+
+/**
+ * Instances of private subclasses are described by their closest introspected ancestor
+ */
+static GIBaseInfo *find_object_info(GType gtype) {
+  GIRepository *repo = g_irepository_get_default();
+
+  for (; gtype != G_TYPE_INVALID; gtype = g_type_parent(gtype)) {
+    GIBaseInfo *info = g_irepository_find_by_gtype(repo, gtype);
+
+    if (info != NULL) {
+      return info;
+    }
+  }
+
+  return NULL;
+}
+
+/**
+ * Builds the prototype of an object type: it inherits from the prototype of the
+ * parent type and holds the instance methods of the type and of the interfaces
+ * it adds, so each method is defined once per context however many
+ * subclasses there are. Cached per context; returns a new reference.
+ */
+JSValue JS_GetObjectPrototype(JSContext *ctx, GIBaseInfo *info) {
+  ContextData *context_data = GetContextData(ctx);
+
+  if (context_data == nullptr || info == NULL) {
+    return JS_NewObject(ctx);
+  }
+
+  JSValue proto = context_data->GetPrototype(info);
+
+  if (!JS_IsUndefined(proto)) {
+    return proto;
+  }
+
+  GIObjectInfo *parent = g_object_info_get_parent(info);
+
+  if (parent != NULL) {
+    JSValue parent_proto = JS_GetObjectPrototype(ctx, parent);
+    proto = JS_NewObjectProto(ctx, parent_proto);
+    JS_FreeValue(ctx, parent_proto);
+    g_base_info_unref(parent);
+  } else {
+    proto = JS_NewObject(ctx);
+  }
+
+  // Own methods go last, so they win over interface methods of the same name
+  for (int i = 0; i < g_object_info_get_n_interfaces(info); i++) {
+    GIInterfaceInfo *interface_info = g_object_info_get_interface(info, i);
+    DefineMethods(ctx, interface_info, proto, JS_UNDEFINED);
+    g_base_info_unref(interface_info);
+  }
+
+  DefineMethods(ctx, info, proto, JS_UNDEFINED);
+  JS_DefineStreamMethods(ctx, proto, g_registered_type_info_get_g_type(info));
+
+  context_data->SetPrototype(info, JS_DupValue(ctx, proto));
+  return proto;
+}
+
+/**
+ * Creates Namespace.Class, with the class's prototype as its prototype property
+ */
+JSValue JS_MakeObjectClass(JSContext *ctx, GIBaseInfo *info) {
+  js_setup_gobject(ctx);
+
+  JSValue class_obj = JS_NewObjectClass(ctx, js_gobject_class_classid);
+  JSValue proto     = JS_GetObjectPrototype(ctx, info);
+
+  JS_SetOpaque(class_obj, GSIZE_TO_POINTER(g_registered_type_info_get_g_type(info)));
+  JS_SetConstructor(ctx, class_obj, proto);
+  JS_FreeValue(ctx, proto);
+
+  return class_obj;
+}
+
+/**
+ * Wraps gobject, taking over the caller's reference if transfer_ref is set.
+ * Otherwise a floating reference is sunk into the wrapper.
+ */
+JSValue JS_MakeOpaqueGObject(JSContext *ctx, GObject *gobject, bool transfer_ref) {
+  js_setup_gobject(ctx);
+
+  GIBaseInfo *info   = find_object_info(G_OBJECT_TYPE(gobject));
+  JSValue     proto  = JS_GetObjectPrototype(ctx, info);
+  JSValue     object = JS_NewObjectProtoClass(ctx, proto, js_gobject_classid);
+
+  JS_FreeValue(ctx, proto);
+
+  if (JS_IsException(object)) {
+    if (info != NULL) {
+      g_base_info_unref(info);
+    }
+    return object;
+  }
+
+  GType gtype = G_OBJECT_TYPE(gobject);
+
+  GObjectWrapper *wrapper = new GObjectWrapper();
+  wrapper->gobject  = transfer_ref ? gobject : (GObject *)g_object_ref_sink(gobject);
+  wrapper->info     = info;
+  wrapper->ancestry = GetTypeAncestry(gtype);
+  wrapper->size     = get_native_size(gobject, wrapper->ancestry);
+
+  ContextData *context_data = GetContextData(ctx);
+  const char * ns           = info != NULL ? g_base_info_get_namespace(info) : NULL;
+
+  wrapper->heap_group = context_data != nullptr
+    ? context_data->GetHeapGroup(HeapKind::OBJECT, GSIZE_TO_POINTER(gtype), g_type_name(gtype), ns)
+    : HeapStatsGetGroup(HeapKind::OBJECT, GSIZE_TO_POINTER(gtype), g_type_name(gtype), ns);
+
+  JS_SetOpaque(object, wrapper);
+  track_wrapper(wrapper, 1);
+  AddExternalMemory(ctx, wrapper->size);
+
+  return object;
+}
+
+/**
+ * @returns the wrapped instance, borrowed, or NULL if value isn't a GObject wrapper
+ */
+GObject *JS_GetGObject(JSValueConst value) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)JS_GetOpaque(value, js_gobject_classid);
+
+  return wrapper != nullptr ? wrapper->gobject : NULL;
+}
+
+/**
+ * Drops the wrapper's reference now rather than when it is collected. The
+ * wrapper stays around, but no longer wraps anything.
+ * @returns false if value isn't a GObject wrapper holding a reference
+ */
+bool JS_ReleaseGObject(JSContext *ctx, JSValueConst value) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)JS_GetOpaque(value, js_gobject_classid);
+
+  if (wrapper == nullptr || wrapper->gobject == NULL) {
+    return false;
+  }
+
+  DetachMemoryViews(ctx, wrapper);
+  track_wrapper(wrapper, -1);
+  RemoveExternalMemory(JS_GetRuntime(ctx), wrapper->size);
+  g_object_unref(wrapper->gobject);
+  wrapper->gobject = NULL;
+
+  return true;
+}
+
+}
@@ -0,0 +1,68 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+#include <quickjs/quickjs.h>
+
+#include "gi/ancestry.hh"
+#include "jsapi/HeapStats.hh"
+
+namespace QJSGir {
+
+/**
+ * JS wrapper of a GObject instance, holding a strong reference
+ */
+struct GObjectWrapper {
+  // NULL once the reference was released by a scope
+  GObject *   gobject;
+
+  // Closest introspected type, NULL if there is none
+  GIBaseInfo *info;
+
+  // Native memory retained through the reference, as accounted
+  gsize       size;
+
+  // Shared by all instances of the class, for instance checks
+  const TypeAncestry *ancestry;
+
+  // Heap stats group of the class
+  HeapGroup * heap_group;
+};
+
+extern JSClassID js_gobject_classid;
+
+bool js_setup_gobject(JSContext *ctx);
+JSValue JS_MakeOpaqueGObject(JSContext *ctx, GObject *gobject, bool transfer_ref);
+GObject *JS_GetGObject(JSValueConst value);
+bool JS_ReleaseGObject(JSContext *ctx, JSValueConst value);
+JSValue JS_GetObjectPrototype(JSContext *ctx, GIBaseInfo *info);
+JSValue JS_MakeObjectClass(JSContext *ctx, GIBaseInfo *info);
+
+/**
+ * @returns the ancestry of the wrapped instance's class, or nullptr if value
+ * isn't a GObject wrapper or no longer wraps anything
+ */
+static inline const TypeAncestry *JS_GetGObjectAncestry(JSValueConst value) {
+  GObjectWrapper *wrapper = (GObjectWrapper *)JS_GetOpaque(value, js_gobject_classid);
+
+  return wrapper != nullptr && wrapper->gobject != NULL ? wrapper->ancestry : nullptr;
+}
+
+}
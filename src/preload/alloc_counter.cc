@@ -0,0 +1,111 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * LD_PRELOAD library counting malloc()/free() per thread, so the allocations
+ * done by a single bound call (QuickJS, GLib and the callee) can be measured
+ * with GI.countAllocations(). Built with -Dalloc_counter=true.
+ */
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdlib.h>
+
+#include "preload/alloc_counter.hh"
+
+extern "C" {
+
+void *__libc_malloc(size_t size);
+void *__libc_calloc(size_t n, size_t size);
+void *__libc_realloc(void *ptr, size_t size);
+void *__libc_memalign(size_t alignment, size_t size);
+void  __libc_free(void *ptr);
+
+static __thread QJSGirAllocCounters counters;
+
+__attribute__((visibility("default")))
+QJSGirAllocCounters *qjs_gir_alloc_counters(void) {
+  return &counters;
+}
+
+__attribute__((visibility("default")))
+void *malloc(size_t size) {
+  counters.mallocs++;
+  counters.bytes += size;
+  return __libc_malloc(size);
+}
+
+__attribute__((visibility("default")))
+void *calloc(size_t n, size_t size) {
+  counters.mallocs++;
+  counters.bytes += n * size;
+  return __libc_calloc(n, size);
+}
+
+__attribute__((visibility("default")))
+void *realloc(void *ptr, size_t size) {
+  counters.mallocs += ptr == NULL;
+  counters.frees   += ptr != NULL && size == 0;
+  counters.bytes   += size;
+  return __libc_realloc(ptr, size);
+}
+
+static void *counted_memalign(size_t alignment, size_t size) {
+  void *ptr = __libc_memalign(alignment, size);
+
+  if (ptr != NULL) {
+    counters.mallocs++;
+    counters.bytes += size;
+  }
+
+  return ptr;
+}
+
+__attribute__((visibility("default")))
+int posix_memalign(void **out, size_t alignment, size_t size) {
+  if (alignment % sizeof(void *) != 0 || (alignment & (alignment - 1)) != 0) {
+    return EINVAL;
+  }
+
+  void *ptr = counted_memalign(alignment, size);
+
+  if (ptr == NULL) {
+    return ENOMEM;
+  }
+
+  *out = ptr;
+  return 0;
+}
+
+__attribute__((visibility("default")))
+void *aligned_alloc(size_t alignment, size_t size) {
+  return counted_memalign(alignment, size);
+}
+
+__attribute__((visibility("default")))
+void *memalign(size_t alignment, size_t size) {
+  return counted_memalign(alignment, size);
+}
+
+__attribute__((visibility("default")))
+void free(void *ptr) {
+  counters.frees += ptr != NULL;
+  __libc_free(ptr);
+}
+
+}
@@ -0,0 +1,35 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * Counters kept by the allocation counter preload library, per thread.
+ * The module looks the accessor up at runtime, see GetAllocCounters().
+ */
+struct QJSGirAllocCounters {
+  uint64_t mallocs;
+  uint64_t frees;
+  uint64_t bytes;
+};
+
+#define QJS_GIR_ALLOC_COUNTERS_SYMBOL "qjs_gir_alloc_counters"
+
+typedef QJSGirAllocCounters *(*QJSGirAllocCountersFunc)(void);
@@ -0,0 +1,224 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-alloc-check
+ *
+ * Runs bound call shapes that are expected to be allocation free (scalar
+ * arguments, borrowed strings) and fails if one of them allocates. The
+ * runtime is created with counting JSMallocFunctions, so every engine
+ * allocation is seen. With the allocation counter library preloaded, the
+ * allocations done by GLib and the callee are counted too.
+ *
+ * Exits with 77 (skipped) if the GLib typelib isn't available.
+ */
+
+#include <dlfcn.h>
+#include <glib.h>
+#include <malloc.h>
+#include <quickjs/quickjs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "jsapi/BootstrapGI.hh"
+#include "jsapi/NamespaceLoader.hh"
+#include "preload/alloc_counter.hh"
+
+#define WARMUP_CALLS   16
+#define MEASURED_CALLS 256
+
+struct CallShape {
+  const char *name;
+  const char *call;
+};
+
+static const CallShape zero_alloc_shapes[] = {
+  { "scalar int args", "GLib.random_int_range(0, 10)" },
+  { "scalar char arg", "GLib.ascii_digit_value(48)" },
+  { "scalar unichar arg", "GLib.unichar_isalpha(65)" },
+  { "borrowed strings", "GLib.str_has_prefix('quickjs', 'quick')" },
+};
+
+static QJSGirAllocCounters js_counters;
+
+static void *counting_malloc(JSMallocState *s, size_t size) {
+  void *ptr = malloc(size);
+
+  if (ptr != NULL) {
+    js_counters.mallocs++;
+    js_counters.bytes += size;
+    s->malloc_count++;
+    s->malloc_size += malloc_usable_size(ptr);
+  }
+
+  return ptr;
+}
+
+static void counting_free(JSMallocState *s, void *ptr) {
+  if (ptr == NULL) {
+    return;
+  }
+
+  js_counters.frees++;
+  s->malloc_count--;
+  s->malloc_size -= malloc_usable_size(ptr);
+  free(ptr);
+}
+
+static void *counting_realloc(JSMallocState *s, void *ptr, size_t size) {
+  if (ptr == NULL) {
+    return size == 0 ? NULL : counting_malloc(s, size);
+  }
+
+  if (size == 0) {
+    counting_free(s, ptr);
+    return NULL;
+  }
+
+  size_t old_size = malloc_usable_size(ptr);
+  void * new_ptr  = realloc(ptr, size);
+
+  if (new_ptr != NULL) {
+    js_counters.mallocs++;
+    js_counters.frees++;
+    js_counters.bytes += size;
+    s->malloc_size    += malloc_usable_size(new_ptr) - old_size;
+  }
+
+  return new_ptr;
+}
+
+static size_t counting_usable_size(const void *ptr) {
+  return malloc_usable_size((void *)ptr);
+}
+
+static const JSMallocFunctions counting_malloc_functions = {
+  counting_malloc,
+  counting_free,
+  counting_realloc,
+  counting_usable_size,
+};
+
+static QJSGirAllocCounters *get_libc_counters() {
+  auto counters_func = (QJSGirAllocCountersFunc)dlsym(RTLD_DEFAULT, QJS_GIR_ALLOC_COUNTERS_SYMBOL);
+
+  return counters_func ? counters_func() : nullptr;
+}
+
+static JSValue compile_shape(JSContext *ctx, const CallShape *shape, int n_calls) {
+  char *source = g_strdup_printf("(() => { for (let i = 0; i < %d; i++) %s; })", n_calls, shape->call);
+  JSValue fn   = JS_Eval(ctx, source, strlen(source), shape->name, JS_EVAL_TYPE_GLOBAL);
+
+  g_free(source);
+  return fn;
+}
+
+static bool run_shape(JSContext *ctx, JSValue fn) {
+  JSValue result = JS_Call(ctx, fn, JS_UNDEFINED, 0, NULL);
+  bool    failed = JS_IsException(result);
+
+  if (failed) {
+    JSValue     exception = JS_GetException(ctx);
+    const char *message   = JS_ToCString(ctx, exception);
+
+    fprintf(stderr, "  %s\n", message);
+    JS_FreeCString(ctx, message);
+    JS_FreeValue(ctx, exception);
+  }
+
+  JS_FreeValue(ctx, result);
+  return !failed;
+}
+
+/**
+ * Warms the shape up (call plan, shapes, atoms) and then checks that the
+ * measured calls neither allocate nor free anything.
+ */
+static bool check_shape(JSContext *ctx, const CallShape *shape, QJSGirAllocCounters *libc_counters) {
+  JSValue warmup   = compile_shape(ctx, shape, WARMUP_CALLS);
+  JSValue measured = compile_shape(ctx, shape, MEASURED_CALLS);
+  bool    success  = !JS_IsException(warmup) && !JS_IsException(measured) && run_shape(ctx, warmup);
+
+  if (success) {
+    QJSGirAllocCounters js_before   = js_counters;
+    QJSGirAllocCounters libc_before = libc_counters ? *libc_counters : QJSGirAllocCounters {};
+
+    success = run_shape(ctx, measured);
+
+    QJSGirAllocCounters js_after   = js_counters;
+    QJSGirAllocCounters libc_after = libc_counters ? *libc_counters : QJSGirAllocCounters {};
+
+    uint64_t js_mallocs   = js_after.mallocs - js_before.mallocs;
+    uint64_t libc_mallocs = libc_after.mallocs - libc_before.mallocs;
+
+    printf("%-20s js: %llu mallocs, %llu frees, %llu bytes",
+           shape->name,
+           (unsigned long long)js_mallocs,
+           (unsigned long long)(js_after.frees - js_before.frees),
+           (unsigned long long)(js_after.bytes - js_before.bytes));
+
+    if (libc_counters != nullptr) {
+      printf("; libc: %llu mallocs, %llu frees, %llu bytes",
+             (unsigned long long)libc_mallocs,
+             (unsigned long long)(libc_after.frees - libc_before.frees),
+             (unsigned long long)(libc_after.bytes - libc_before.bytes));
+    }
+
+    printf(" (%d calls)\n", MEASURED_CALLS);
+
+    success = success && js_mallocs == 0 && libc_mallocs == 0;
+  }
+
+  if (!success) {
+    fprintf(stderr, "FAIL: %s (%s)\n", shape->name, shape->call);
+  }
+
+  JS_FreeValue(ctx, warmup);
+  JS_FreeValue(ctx, measured);
+  return success;
+}
+
+int main() {
+  GError *error = NULL;
+
+  if (QJSGir::RequireNamespace("GLib", "2.0", &error) == NULL) {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 77;
+  }
+
+  JSRuntime *rt  = JS_NewRuntime2(&counting_malloc_functions, NULL);
+  JSContext *ctx = JS_NewContext(rt);
+
+  JSValue global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "GI", QJSGir::BootstrapGI(ctx));
+  JS_SetPropertyStr(ctx, global, "GLib", QJSGir::MakeNamespace(ctx, "GLib"));
+  JS_FreeValue(ctx, global);
+
+  QJSGirAllocCounters *libc_counters = get_libc_counters();
+  bool                 success       = true;
+
+  for (const CallShape& shape : zero_alloc_shapes) {
+    success = check_shape(ctx, &shape, libc_counters) && success;
+  }
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+
+  return success ? 0 : 1;
+}
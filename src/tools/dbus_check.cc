@@ -0,0 +1,178 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-dbus-check
+ *
+ * Exports a small object on the session bus and calls its methods through
+ * GI.dbusProxy(), checking that arguments and replies make the round-trip.
+ * Meant to run under dbus-run-session, so it gets a private bus.
+ *
+ * Exits with 77 (skipped) if there is no session bus.
+ */
+
+#include <gio/gio.h>
+#include <quickjs/quickjs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "jsapi/BootstrapGI.hh"
+#include "jsapi/opaque/JSGObject.hh"
+
+#define TIMEOUT_SECONDS 10
+
+static const char *interface_xml =
+  "<node>"
+  "  <interface name='org.quickjs.gobject.Check'>"
+  "    <method name='Echo'>"
+  "      <arg type='s' direction='in'/>"
+  "      <arg type='s' direction='out'/>"
+  "    </method>"
+  "    <method name='Add'>"
+  "      <arg type='i' direction='in'/>"
+  "      <arg type='i' direction='in'/>"
+  "      <arg type='i' direction='out'/>"
+  "    </method>"
+  "    <method name='Fail'/>"
+  "  </interface>"
+  "</node>";
+
+static const char *check_source =
+  "const proxy = GI.dbusProxy(connection, busName, '/org/quickjs/gobject/Check', interfaceXml);\n"
+  "(async () => {\n"
+  "  const echoed = await proxy.Echo('hello');\n"
+  "  const sum = await proxy.Add(2, 3);\n"
+  "  let failed = 'no error';\n"
+  "  try { await proxy.Fail(); } catch (e) { failed = e.message; }\n"
+  "  return `${echoed} ${sum} ${failed}`;\n"
+  "})().then(value => { result = value; }, e => { result = `error: ${e}`; });\n";
+
+static const char *expected_result = "hello 5 Check failed";
+
+static void handle_method_call(GDBusConnection *connection, const char *sender, const char *object_path,
+                               const char *interface_name, const char *method_name, GVariant *parameters,
+                               GDBusMethodInvocation *invocation, gpointer user_data) {
+  if (strcmp(method_name, "Echo") == 0) {
+    const char *text;
+
+    g_variant_get(parameters, "(&s)", &text);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(s)", text));
+  } else if (strcmp(method_name, "Add") == 0) {
+    gint32 a, b;
+
+    g_variant_get(parameters, "(ii)", &a, &b);
+    g_dbus_method_invocation_return_value(invocation, g_variant_new("(i)", a + b));
+  } else {
+    g_dbus_method_invocation_return_error(invocation, G_IO_ERROR, G_IO_ERROR_FAILED, "Check failed");
+  }
+}
+
+static const GDBusInterfaceVTable interface_vtable = { handle_method_call };
+
+static gboolean on_timeout(gpointer user_data) {
+  *(bool *)user_data = true;
+  return G_SOURCE_REMOVE;
+}
+
+/**
+ * @returns the string in the global "result", or NULL while there is none
+ */
+static char *get_result(JSContext *ctx) {
+  JSValue global = JS_GetGlobalObject(ctx);
+  JSValue value  = JS_GetPropertyStr(ctx, global, "result");
+  char *  result = NULL;
+
+  if (!JS_IsNull(value) && !JS_IsUndefined(value)) {
+    const char *str = JS_ToCString(ctx, value);
+    result = g_strdup(str);
+    JS_FreeCString(ctx, str);
+  }
+
+  JS_FreeValue(ctx, value);
+  JS_FreeValue(ctx, global);
+  return result;
+}
+
+int main() {
+  GError *         error      = NULL;
+  GDBusConnection *connection = g_bus_get_sync(G_BUS_TYPE_SESSION, NULL, &error);
+
+  if (connection == NULL) {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 77;
+  }
+
+  GDBusNodeInfo *node = g_dbus_node_info_new_for_xml(interface_xml, NULL);
+  guint          id   = g_dbus_connection_register_object(connection, "/org/quickjs/gobject/Check",
+                                                            node->interfaces[0], &interface_vtable,
+                                                            NULL, NULL, &error);
+
+  if (id == 0) {
+    fprintf(stderr, "%s\n", error->message);
+    return 1;
+  }
+
+  JSRuntime *rt  = JS_NewRuntime();
+  JSContext *ctx = JS_NewContext(rt);
+
+  JSValue global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "GI", QJSGir::BootstrapGI(ctx));
+  JS_SetPropertyStr(ctx, global, "connection", QJSGir::JS_MakeOpaqueGObject(ctx, G_OBJECT(connection), false));
+  JS_SetPropertyStr(ctx, global, "busName", JS_NewString(ctx, g_dbus_connection_get_unique_name(connection)));
+  JS_SetPropertyStr(ctx, global, "interfaceXml", JS_NewString(ctx, interface_xml));
+  JS_SetPropertyStr(ctx, global, "result", JS_NULL);
+  JS_FreeValue(ctx, global);
+
+  JSValue ret = JS_Eval(ctx, check_source, strlen(check_source), "dbus_check", JS_EVAL_TYPE_GLOBAL);
+  bool    timed_out = false;
+  char *  result    = NULL;
+
+  if (JS_IsException(ret)) {
+    result = g_strdup("error: the check script threw");
+  }
+
+  JS_FreeValue(ctx, ret);
+  g_timeout_add_seconds(TIMEOUT_SECONDS, on_timeout, &timed_out);
+
+  while (result == NULL && !timed_out) {
+    JSContext *job_ctx;
+
+    g_main_context_iteration(NULL, TRUE);
+    while (JS_ExecutePendingJob(rt, &job_ctx) > 0) {
+    }
+
+    result = get_result(ctx);
+  }
+
+  bool success = result != NULL && strcmp(result, expected_result) == 0;
+
+  if (!success) {
+    fprintf(stderr, "FAIL: expected \"%s\", got \"%s\"\n", expected_result, result ? result : "timeout");
+  }
+
+  g_free(result);
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+
+  g_dbus_connection_unregister_object(connection, id);
+  g_dbus_node_info_unref(node);
+  g_object_unref(connection);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,85 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-memory-pressure-check
+ *
+ * Makes GBytes of 64 KiB, each only reachable through a reference cycle, so
+ * nothing but a GC can free them. The JS heap barely grows meanwhile; the
+ * check fails unless the accounted native memory forces collections and
+ * keeps the retained bytes bounded.
+ *
+ * Exits with 77 (skipped) if the GLib typelib isn't available.
+ */
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "jsapi/BootstrapGI.hh"
+#include "jsapi/NamespaceLoader.hh"
+
+static const char *check_source =
+  "GI.setMemoryPressure({ heapRatio: 0, minThreshold: 1024 * 1024 });\n"
+  "const data = new Array(64 * 1024).fill(120);\n"
+  "let peak = 0;\n"
+  "for (let i = 0; i < 256; i++) {\n"
+  "  const cycle = { bytes: GLib.Bytes.new(data) };\n"
+  "  cycle.self = cycle;\n"
+  "  peak = Math.max(peak, GI.memoryStats().externalBytes);\n"
+  "}\n"
+  "const stats = GI.memoryStats();\n"
+  "`${stats.gcCount > 0 ? 'collected' : 'never collected'} ${peak < 4 * 1024 * 1024 ? 'bounded' : `peak ${peak}`}`;\n";
+
+static const char *expected_result = "collected bounded";
+
+int main() {
+  GError *error = NULL;
+
+  if (QJSGir::RequireNamespace("GLib", "2.0", &error) == NULL) {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 77;
+  }
+
+  JSRuntime *rt  = JS_NewRuntime();
+  JSContext *ctx = JS_NewContext(rt);
+
+  JSValue global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "GI", QJSGir::BootstrapGI(ctx));
+  JS_SetPropertyStr(ctx, global, "GLib", QJSGir::MakeNamespace(ctx, "GLib"));
+  JS_FreeValue(ctx, global);
+
+  JSValue     ret    = JS_Eval(ctx, check_source, strlen(check_source), "memory_pressure_check", JS_EVAL_TYPE_GLOBAL);
+  JSValue     value  = JS_IsException(ret) ? JS_GetException(ctx) : JS_DupValue(ctx, ret);
+  const char *result = JS_ToCString(ctx, value);
+  bool        success = !JS_IsException(ret) && result != NULL && strcmp(result, expected_result) == 0;
+
+  if (!success) {
+    fprintf(stderr, "FAIL: expected \"%s\", got \"%s\"\n", expected_result, result ? result : "nothing");
+  }
+
+  JS_FreeCString(ctx, result);
+  JS_FreeValue(ctx, value);
+  JS_FreeValue(ctx, ret);
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+
+  return success ? 0 : 1;
+}
@@ -0,0 +1,170 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-number-range-check
+ *
+ * Converts integers at and past the edges of each C integer type, through
+ * the generic call path (GLib.Variant constructors) and through the
+ * conversion helpers of the ahead-of-time stubs. Both must accept the edges
+ * and throw a RangeError past them, never wrap.
+ *
+ * Exits with 77 (skipped) if the GLib typelib isn't available.
+ */
+
+#include <glib.h>
+#include <quickjs/quickjs.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "aot/aot.hh"
+#include "jsapi/BootstrapGI.hh"
+#include "jsapi/NamespaceLoader.hh"
+
+struct RangeCase {
+  const char *type;
+  const char *constructor;   // GLib.Variant constructor taking the type
+  const char *value;         // JS expression
+  bool        in_range;
+};
+
+static const RangeCase range_cases[] = {
+  { "uint8",  "new_byte",   "255",             true  },
+  { "uint8",  "new_byte",   "256",             false },
+  { "uint8",  "new_byte",   "-1",              false },
+  { "int16",  "new_int16",  "-32768",          true  },
+  { "int16",  "new_int16",  "32768",           false },
+  { "uint16", "new_uint16", "65535",           true  },
+  { "uint16", "new_uint16", "-1",              false },
+  { "int32",  "new_int32",  "2147483647",      true  },
+  { "int32",  "new_int32",  "2147483648",      false },
+  { "int32",  "new_int32",  "-2147483649",     false },
+  { "int32",  "new_int32",  "NaN",             false },
+  { "uint32", "new_uint32", "4294967295",      true  },
+  { "uint32", "new_uint32", "4294967296",      false },
+  { "uint32", "new_uint32", "-1",              false },
+  { "int64",  "new_int64",  "-(2n ** 63n)",    true  },
+  { "int64",  "new_int64",  "2n ** 63n",       false },
+  { "int64",  "new_int64",  "2 ** 63",         false },
+  { "uint64", "new_uint64", "2n ** 64n - 1n",  true  },
+  { "uint64", "new_uint64", "2n ** 64n",       false },
+  { "uint64", "new_uint64", "-1n",             false },
+  { "uint64", "new_uint64", "-1",              false },
+  { "uint64", "new_uint64", "2 ** 64",         false },
+};
+
+/**
+ * @returns true if evaluating source succeeded, false if it threw a
+ * RangeError; anything else is a failure, reported in *failed
+ */
+static bool eval_in_range(JSContext *ctx, const char *source, bool *failed) {
+  JSValue ret       = JS_Eval(ctx, source, strlen(source), "number_range_check", JS_EVAL_TYPE_GLOBAL);
+  bool    succeeded = !JS_IsException(ret);
+
+  if (!succeeded) {
+    JSValue     exception = JS_GetException(ctx);
+    JSValue     name      = JS_GetPropertyStr(ctx, exception, "name");
+    const char *name_str  = JS_ToCString(ctx, name);
+
+    if (name_str == NULL || strcmp(name_str, "RangeError") != 0) {
+      const char *message = JS_ToCString(ctx, exception);
+      fprintf(stderr, "  %s: %s\n", source, message ? message : "?");
+      JS_FreeCString(ctx, message);
+      *failed = true;
+    }
+
+    JS_FreeCString(ctx, name_str);
+    JS_FreeValue(ctx, name);
+    JS_FreeValue(ctx, exception);
+  }
+
+  JS_FreeValue(ctx, ret);
+  return succeeded;
+}
+
+static bool check_generic(JSContext *ctx, const RangeCase *range_case) {
+  char *source = g_strdup_printf("GLib.Variant.%s(%s)", range_case->constructor, range_case->value);
+  bool  failed = false;
+  bool  in_range = eval_in_range(ctx, source, &failed);
+
+  g_free(source);
+  return !failed && in_range == range_case->in_range;
+}
+
+template<typename T>
+static bool aot_accepts(JSContext *ctx, JSValueConst value) {
+  T out;
+  return aot_to_integer<T>(ctx, value, &out, "value");
+}
+
+static bool check_aot(JSContext *ctx, const RangeCase *range_case) {
+  JSValue value = JS_Eval(ctx, range_case->value, strlen(range_case->value), "number_range_check", JS_EVAL_TYPE_GLOBAL);
+  bool    in_range;
+
+  if      (strcmp(range_case->type, "uint8") == 0)  in_range = aot_accepts<guint8>(ctx, value);
+  else if (strcmp(range_case->type, "int16") == 0)  in_range = aot_accepts<gint16>(ctx, value);
+  else if (strcmp(range_case->type, "uint16") == 0) in_range = aot_accepts<guint16>(ctx, value);
+  else if (strcmp(range_case->type, "int32") == 0)  in_range = aot_accepts<gint32>(ctx, value);
+  else if (strcmp(range_case->type, "uint32") == 0) in_range = aot_accepts<guint32>(ctx, value);
+  else if (strcmp(range_case->type, "int64") == 0)  in_range = aot_accepts<gint64>(ctx, value);
+  else                                              in_range = aot_accepts<guint64>(ctx, value);
+
+  if (!in_range) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+  }
+
+  JS_FreeValue(ctx, value);
+  return in_range == range_case->in_range;
+}
+
+int main() {
+  GError *error = NULL;
+
+  if (QJSGir::RequireNamespace("GLib", "2.0", &error) == NULL) {
+    fprintf(stderr, "%s\n", error->message);
+    g_error_free(error);
+    return 77;
+  }
+
+  JSRuntime *rt  = JS_NewRuntime();
+  JSContext *ctx = JS_NewContext(rt);
+
+  JSValue global = JS_GetGlobalObject(ctx);
+  JS_SetPropertyStr(ctx, global, "GI", QJSGir::BootstrapGI(ctx));
+  JS_SetPropertyStr(ctx, global, "GLib", QJSGir::MakeNamespace(ctx, "GLib"));
+  JS_FreeValue(ctx, global);
+
+  bool success = true;
+
+  for (const RangeCase& range_case : range_cases) {
+    bool generic = check_generic(ctx, &range_case);
+    bool aot     = check_aot(ctx, &range_case);
+
+    if (!generic || !aot) {
+      fprintf(stderr, "FAIL: %s %s should %s (generic %s, aot %s)\n",
+              range_case.type, range_case.value, range_case.in_range ? "convert" : "throw a RangeError",
+              generic ? "ok" : "wrong", aot ? "ok" : "wrong");
+      success = false;
+    }
+  }
+
+  JS_FreeContext(ctx);
+  JS_FreeRuntime(rt);
+
+  return success ? 0 : 1;
+}
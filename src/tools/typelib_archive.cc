@@ -0,0 +1,117 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+/*
+ * quickjs-gobject-typelib-archive OUTPUT TYPELIB...
+ *
+ * Packs typelib files into one archive (see gi/typelib_archive.hh), in the
+ * order given. Each typelib is stored under its file name without the
+ * .typelib suffix, e.g. Gtk-4.0.
+ */
+
+#include <glib.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "gi/typelib_archive.hh"
+
+static gsize align_offset(gsize offset) {
+  return (offset + TYPELIB_ARCHIVE_ALIGNMENT - 1) & ~(gsize)(TYPELIB_ARCHIVE_ALIGNMENT - 1);
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "Usage: %s OUTPUT TYPELIB...\n", argv[0]);
+    return 1;
+  }
+
+  int                  n_entries = argc - 2;
+  TypelibArchiveEntry *entries   = g_new0(TypelibArchiveEntry, n_entries);
+  GMappedFile **       files     = g_new0(GMappedFile *, n_entries);
+  gsize                offset    = align_offset(sizeof(TypelibArchiveHeader) + n_entries * sizeof(TypelibArchiveEntry));
+
+  for (int i = 0; i < n_entries; i++) {
+    const char *path  = argv[i + 2];
+    GError *    error = NULL;
+
+    files[i] = g_mapped_file_new(path, FALSE, &error);
+
+    if (files[i] == NULL) {
+      fprintf(stderr, "%s\n", error->message);
+      return 1;
+    }
+
+    char *basename = g_path_get_basename(path);
+    char *suffix   = g_strrstr(basename, ".typelib");
+
+    if (suffix != NULL) {
+      *suffix = '\0';
+    }
+
+    if (strlen(basename) >= sizeof(entries[i].name)) {
+      fprintf(stderr, "Name too long: %s\n", basename);
+      return 1;
+    }
+
+    strcpy(entries[i].name, basename);
+    entries[i].offset = GUINT64_TO_LE(offset);
+    entries[i].size   = GUINT64_TO_LE(g_mapped_file_get_length(files[i]));
+
+    offset = align_offset(offset + g_mapped_file_get_length(files[i]));
+    g_free(basename);
+  }
+
+  FILE *output = fopen(argv[1], "wb");
+
+  if (output == NULL) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  TypelibArchiveHeader header = {};
+  memcpy(header.magic, TYPELIB_ARCHIVE_MAGIC, sizeof(header.magic));
+  header.n_entries = GUINT32_TO_LE(n_entries);
+
+  static const char padding[TYPELIB_ARCHIVE_ALIGNMENT] = {};
+  gsize             written = 0;
+  bool              ok      = true;
+
+  ok = ok && fwrite(&header, sizeof(header), 1, output) == 1;
+  ok = ok && fwrite(entries, sizeof(TypelibArchiveEntry), n_entries, output) == (size_t)n_entries;
+  written = sizeof(header) + n_entries * sizeof(TypelibArchiveEntry);
+
+  for (int i = 0; i < n_entries && ok; i++) {
+    gsize start = GUINT64_FROM_LE(entries[i].offset);
+    gsize size  = GUINT64_FROM_LE(entries[i].size);
+
+    ok = ok && fwrite(padding, 1, start - written, output) == start - written;
+    ok = ok && fwrite(g_mapped_file_get_contents(files[i]), 1, size, output) == size;
+    written = start + size;
+
+    g_mapped_file_unref(files[i]);
+  }
+
+  if (fclose(output) != 0 || !ok) {
+    perror(argv[1]);
+    return 1;
+  }
+
+  g_free(files);
+  g_free(entries);
+  return 0;
+}
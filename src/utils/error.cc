@@ -20,38 +20,35 @@
 #include <quickjs/quickjs.h>
 
 #include "gi/type.hh"
+#include "jsapi/ErrorDomain.hh"
 
 namespace QJSGir::Throw {
 
 void NotEnoughArguments(JSContext *ctx, int expected, int actual) {
-  char *msg = g_strdup_printf(
-    "Not enough arguments; expected %i, have %i",
-    expected, actual);
-
-  JS_ThrowTypeError(ctx, "%s", msg);
-  g_free(msg);
+  JS_ThrowTypeError(ctx, "Not enough arguments; expected %i, have %i", expected, actual);
 }
 
 void UnsupportedCallback(JSContext *ctx, GIBaseInfo *info) {
-  char *message = g_strdup_printf("Function %s.%s has a GDestroyNotify but no user_data, not supported",
-                                  g_base_info_get_namespace(info),
-                                  g_base_info_get_name(info));
-
-  JS_ThrowTypeError(ctx, "%s", message);
-  g_free(message);
+  JS_ThrowTypeError(ctx, "Function %s.%s has a GDestroyNotify but no user_data, not supported",
+                    g_base_info_get_namespace(info),
+                    g_base_info_get_name(info));
 }
 
 void InvalidType(JSContext *ctx, GIArgInfo *info, GITypeInfo *type_info, JSValue value) {
-  char *expected = get_type_name(type_info);
-  char *msg      = g_strdup_printf(
-    "Expected argument of type %s for parameter %s, got '%s'",
-    expected,
-    g_base_info_get_name(info),
-    JS_ToCString(ctx, value));
-
-  JS_ThrowTypeError(ctx, "%s", msg);
+  char *      expected = get_type_name(type_info);
+  const char *actual   = JS_ToCString(ctx, value);
+
+  JS_ThrowTypeError(ctx, "Expected argument of type %s for parameter %s, got '%s'",
+                    expected,
+                    g_base_info_get_name(info),
+                    actual ? actual : "?");
+
+  JS_FreeCString(ctx, actual);
   g_free(expected);
-  g_free(msg);
+}
+
+void FromGError(JSContext *ctx, GError *error) {
+  JS_Throw(ctx, JS_NewGError(ctx, error));
 }
 
 }
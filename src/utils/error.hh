@@ -25,5 +25,6 @@ namespace QJSGir::Throw {
 void NotEnoughArguments(JSContext *ctx, int expected, int actual);
 void UnsupportedCallback(JSContext *ctx, GIBaseInfo *info);
 void InvalidType(JSContext *ctx, GIArgInfo *info, GITypeInfo *type_info, JSValue value);
+void FromGError(JSContext *ctx, GError *error);
 
 }
@@ -20,12 +20,44 @@
 
 namespace QJSGir {
 
+/**
+ * Only real typed arrays have a buffer; ArrayBuffers, DataViews and objects
+ * with a byteLength property don't
+ */
 bool JS_IsTypedArray(JSContext *ctx, JSValue value) {
-  return !JS_IsUndefined(JS_GetPropertyStr(ctx, value, "byteLength"));
+  size_t offset, byte_length, bytes_per_element;
+
+  if (!JS_IsObject(value)) {
+    return false;
+  }
+
+  JSValue buffer = JS_GetTypedArrayBuffer(ctx, value, &offset, &byte_length, &bytes_per_element);
+
+  if (JS_IsException(buffer)) {
+    JS_FreeValue(ctx, JS_GetException(ctx));
+    return false;
+  }
+
+  JS_FreeValue(ctx, buffer);
+  return true;
 }
 
 bool JS_IsNullOrUndefined(JSValue value) {
   return JS_IsNull(value) || JS_IsUndefined(value);
 }
 
+/**
+ * Settles a promise and releases its resolving functions, which are left
+ * undefined. Takes ownership of value.
+ */
+void JS_SettlePromise(JSContext *ctx, JSValue *resolving_funcs, bool reject, JSValue value) {
+  JSValue ret = JS_Call(ctx, resolving_funcs[reject ? 1 : 0], JS_UNDEFINED, 1, &value);
+
+  JS_FreeValue(ctx, ret);
+  JS_FreeValue(ctx, value);
+  JS_FreeValue(ctx, resolving_funcs[0]);
+  JS_FreeValue(ctx, resolving_funcs[1]);
+  resolving_funcs[0] = resolving_funcs[1] = JS_UNDEFINED;
+}
+
 }
@@ -22,5 +22,6 @@ namespace QJSGir {
 
 bool JS_IsTypedArray(JSContext *ctx, JSValue value);
 bool JS_IsNullOrUndefined(JSValue value);
+void JS_SettlePromise(JSContext *ctx, JSValue *resolving_funcs, bool reject, JSValue value);
 
 }
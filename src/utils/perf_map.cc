@@ -0,0 +1,81 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <glib.h>
+#include <girepository.h>
+
+#include "utils/perf_map.hh"
+
+namespace QJSGir {
+
+static FILE *perf_map = NULL;
+G_LOCK_DEFINE_STATIC(perf_map);
+
+/**
+ * Opens the map on first use. It is appended to, since the process may have
+ * other JITs writing their own entries to the same file.
+ */
+static FILE *get_perf_map() {
+  static gsize initialized = 0;
+
+  if (g_once_init_enter(&initialized)) {
+    const char *value = g_getenv("QJS_GIR_PERF_MAP");
+
+    if (value != NULL && *value != '\0' && strcmp(value, "0") != 0) {
+      char *path = g_strdup_printf("/tmp/perf-%d.map", (int)getpid());
+
+      perf_map = fopen(path, "a");
+
+      if (perf_map == NULL) {
+        g_warning("Cannot open %s: %s", path, g_strerror(errno));
+      }
+
+      g_free(path);
+    }
+
+    g_once_init_leave(&initialized, 1);
+  }
+
+  return perf_map;
+}
+
+bool PerfMapEnabled() {
+  return get_perf_map() != NULL;
+}
+
+void PerfMapAdd(gconstpointer address, gsize size, GIBaseInfo *info, const char *kind) {
+  FILE *map = get_perf_map();
+
+  if (map == NULL || address == NULL) {
+    return;
+  }
+
+  // Entries are written whole and flushed, so a profiler attaching at any time sees complete lines
+  G_LOCK(perf_map);
+  fprintf(map, "%" G_GSIZE_MODIFIER "x %" G_GSIZE_MODIFIER "x %s.%s %s\n",
+          GPOINTER_TO_SIZE(address), size,
+          g_base_info_get_namespace(info), g_base_info_get_name(info), kind);
+  fflush(map);
+  G_UNLOCK(perf_map);
+}
+
+}
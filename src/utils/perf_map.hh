@@ -0,0 +1,38 @@
+/**
+ * This file is part of quickjs-gobject.
+ *
+ * quickjs-gobject is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * quickjs-gobject is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with quickjs-gobject. If not, see <https://www.gnu.org/licenses/>
+ **/
+
+
+#pragma once
+
+#include <girepository.h>
+
+namespace QJSGir {
+
+/**
+ * Symbol map of the code generated at runtime, in the format perf and other
+ * Linux profilers read from /tmp/perf-<pid>.map. Only written when the
+ * QJS_GIR_PERF_MAP environment variable is set to a non-zero value.
+ */
+bool PerfMapEnabled();
+
+/**
+ * Names the size bytes of code at address after info, as Namespace.Name
+ * followed by kind
+ */
+void PerfMapAdd(gconstpointer address, gsize size, GIBaseInfo *info, const char *kind);
+
+}